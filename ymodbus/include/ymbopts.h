@@ -14,6 +14,12 @@ namespace YModbus {
 const size_t kMaxTcpSessionNum = 256;
 const uint16_t kMaxSerailPort = 2;
 const size_t kMaxMsgLen = (512 + 7);
+const size_t kMaxPipelineWindow = 16; //max outstanding transactions of master
+const size_t kMaxRequestNum = 1024; //max pending requests of master, 2^n
+const size_t kMaxQueryNum = 1024; //max pending querys of master, 2^n
+const size_t kMaxQueryParts = 16; //max querys merged into one read
+const size_t kMaxEndpointNum = 4096; //max endpoints of reactor
+const size_t kMaxReactorRequestNum = 8192; //max pending requests of reactor, 2^n
 
 } //namespace YModbus
 
@@ -21,6 +21,8 @@
 #include <sys/time.h>
 
 #include <iomanip>
+#include <chrono>
+#include <thread>
 
 namespace YModbus {
 
@@ -29,7 +31,8 @@ struct SerConnect::Impl
 	Impl(const std::string &port,
 		uint32_t baudrate, uint8_t databits, char parity, uint8_t stopbits)
 		: fd_(-1)
-		, t35_(1000000 * 12 * 20 / baudrate / 1000)
+		, tchar_(GetSerCharTime(baudrate, databits, parity, stopbits))
+		, t35_(GetSerFrameGap(baudrate, tchar_))
 	{
 
 
@@ -122,7 +125,7 @@ struct SerConnect::Impl
 		tv_.tv_sec = to / 1000;
 		tv_.tv_usec = (to % 1000) * 1000;
 
-        YMB_DEBUG("%s:%d %s timeout = %ld.%06ld\n",
+        YMB_DEBUG0("%s:%d %s timeout = %ld.%06ld\n",
                   __FILE__, __LINE__, __func__, tv_.tv_sec, tv_.tv_usec);
 
 		return true;
@@ -136,9 +139,26 @@ struct SerConnect::Impl
 		}
 	}
 
+	//Frame is sent after the bus is idle
+	void WaitIdle(void)
+	{
+		if (Clock::now() < idle_)
+			std::this_thread::sleep_until(idle_);
+	}
+
+	//len: bytes on the line just now, sent or received
+	void Busy(size_t len)
+	{
+		idle_ = Clock::now() + std::chrono::microseconds(tchar_ * len + t35_);
+	}
+
+	typedef std::chrono::steady_clock Clock;
+
 	int fd_;
 	struct timeval tv_;
-	uint32_t t35_; //ms
+	long tchar_; //us, time of a char
+	long t35_; //us, silence between frames
+	Clock::time_point idle_; //the next frame may be sent
 };
 
 SerConnect::SerConnect(const std::string &com,
@@ -186,6 +206,9 @@ bool SerConnect::Send(uint8_t *buf, size_t len)
 	if (impl_->fd_ != -1) {
 		char *pbuf = reinterpret_cast<char *>(buf);
 		int ret;
+
+		impl_->WaitIdle();
+		impl_->Busy(len);
 		do {
 			ret = write(impl_->fd_, pbuf, len);
 			if (ret > 0) {
@@ -223,6 +246,7 @@ int SerConnect::Recv(uint8_t *buf, size_t len)
                 if (ret > 0) {
                     YMB_HEXDUMP0(buf + recvlen, ret, "%p SerConnect::Recv: ", this);
                     recvlen += ret;
+                    impl_->Busy(0);
                 }
             }
             else {
@@ -230,8 +254,9 @@ int SerConnect::Recv(uint8_t *buf, size_t len)
                           recvlen, ret);
             }
 
-            tv.tv_sec = impl_->t35_ / 1000;
-            tv.tv_usec = impl_->t35_ % 1000 * 1000;
+            //frame is ended by the silence
+            tv.tv_sec = impl_->t35_ / 1000000;
+            tv.tv_usec = impl_->t35_ % 1000000;
 		} while (ret > 0 && recvlen < static_cast<int>(len));
 	}
 
@@ -34,6 +34,7 @@ struct SerListener::Impl : public ISession
 
 	virtual void Purge(void);
 	virtual void Discard(size_t nbytes);
+	virtual Crc16Context &RecvCrc(void) { return crc_; }
 
 	bool Recv(void);
 
@@ -41,6 +42,7 @@ struct SerListener::Impl : public ISession
 	timeval tv_ = { 0, 0 };
 	char recvbuf_[kMaxMsgLen];
 	size_t recvlen_;
+	Crc16Context crc_; //of recvbuf_
 };
 
 std::string SerListener::Impl::PeerName()
@@ -80,6 +82,7 @@ int SerListener::Impl::Read(uint8_t *buf, size_t bufsiz)
 
 	memcpy(buf, recvbuf_, bufsiz);
 	recvlen_ -= bufsiz;
+	crc_.Reset();
 
 	return static_cast<int>(bufsiz);
 }
@@ -93,6 +96,7 @@ size_t SerListener::Impl::Peek(uint8_t **buf)
 void SerListener::Impl::Purge(void)
 {
 	recvlen_ = 0;
+	crc_.Reset();
 
 	if (fd_ != -1)
 		tcflush(fd_, TCIOFLUSH);
@@ -107,12 +111,15 @@ void SerListener::Impl::Discard(size_t nbytes)
 	else {
 		recvlen_ = 0;
 	}
+	crc_.Reset();
 }
 
 bool SerListener::Impl::Recv()
 {
-	if (recvlen_ == sizeof(recvbuf_))
+	if (recvlen_ == sizeof(recvbuf_)) {
 		recvlen_ = 0;
+		crc_.Reset();
+	}
 
 	int len = read(fd_,
 		&recvbuf_[recvlen_], sizeof(recvbuf_) - recvlen_);
@@ -16,6 +16,8 @@ struct SerConnect::Impl
 	Impl(const std::string &com,
 		uint32_t baudrate, uint8_t databits, char parity, uint8_t stopbits)
 		: file_(INVALID_HANDLE_VALUE)
+		, t35_(GetSerFrameGap(baudrate,
+			GetSerCharTime(baudrate, databits, parity, stopbits)))
 	{
 		/* Open the serial device. */
 		file_ = CreateFileA(com.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
@@ -73,7 +75,7 @@ struct SerConnect::Impl
 	bool SetReadTimeout(long to)
 	{
 		COMMTIMEOUTS    cto;
-		cto.ReadIntervalTimeout = 4; //modbus < 3.5ms
+		cto.ReadIntervalTimeout = static_cast<DWORD>((t35_ + 999) / 1000); //ms
 		cto.ReadTotalTimeoutConstant = static_cast<DWORD>(to);
 		cto.ReadTotalTimeoutMultiplier = 0;
 		cto.WriteTotalTimeoutConstant = 0;
@@ -91,6 +93,7 @@ struct SerConnect::Impl
 	}
 
 	HANDLE file_;
+	long t35_; //us, silence between frames
 };
 
 SerConnect::SerConnect(const std::string &com,
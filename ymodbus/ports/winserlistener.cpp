@@ -25,6 +25,7 @@ struct SerListener::Impl : public ISession
 
 	virtual void Purge(void);
 	virtual void Discard(size_t nbytes);
+	virtual Crc16Context &RecvCrc(void) { return crc_; }
 
 	bool Recv(void);
 
@@ -32,6 +33,7 @@ struct SerListener::Impl : public ISession
 	HANDLE file_;
 	char recvbuf_[kMaxMsgLen];
 	size_t recvlen_;
+	Crc16Context crc_; //of recvbuf_
 };
 
 std::string SerListener::Impl::PeerName()
@@ -72,6 +74,7 @@ int SerListener::Impl::Read(uint8_t *buf, size_t bufsiz)
 
 	memcpy(buf, recvbuf_, bufsiz);
 	recvlen_ -= bufsiz;
+	crc_.Reset();
 
 	return static_cast<int>(bufsiz);
 }
@@ -85,6 +88,7 @@ size_t SerListener::Impl::Peek(uint8_t **buf)
 void SerListener::Impl::Purge(void)
 {
 	recvlen_ = 0;
+	crc_.Reset();
 
 	if (file_ != INVALID_HANDLE_VALUE)
 		::PurgeComm(file_, PURGE_RXCLEAR | PURGE_TXCLEAR);
@@ -99,6 +103,7 @@ void SerListener::Impl::Discard(size_t nbytes)
 	else {
 		recvlen_ = 0;
 	}
+	crc_.Reset();
 }
 
 bool SerListener::Impl::Recv()
@@ -106,8 +111,10 @@ bool SerListener::Impl::Recv()
 	if (file_ != INVALID_HANDLE_VALUE) {
 		DWORD dwRead;
 
-		if (recvlen_ == sizeof(recvbuf_))
+		if (recvlen_ == sizeof(recvbuf_)) {
 			recvlen_ = 0;
+			crc_.Reset();
+		}
 		
 		if (ReadFile(file_, recvbuf_ + recvlen_,
 			sizeof(recvbuf_) - recvlen_, &dwRead, NULL)) {
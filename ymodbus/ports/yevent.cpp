@@ -0,0 +1,112 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#include "ymod/ymbevent.h"
+#include "ymblog.h"
+
+#ifdef WIN32
+#include <chrono>
+#else
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cerrno>
+
+namespace YModbus {
+
+#ifdef WIN32
+
+Event::Event()
+	: waiting_(false)
+	, signaled_(false)
+{
+}
+
+Event::~Event()
+{
+}
+
+int Event::Handle(void) const
+{
+	return -1;
+}
+
+void Event::Signal(void)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	signaled_ = true;
+	cond_.notify_one();
+}
+
+void Event::Disarm(void)
+{
+	waiting_.store(false);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	signaled_ = false;
+}
+
+void Event::Wait(long ms)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	cond_.wait_for(lock, std::chrono::milliseconds(ms),
+		[this] { return signaled_; });
+	signaled_ = false;
+}
+
+#else
+
+Event::Event()
+	: waiting_(false)
+	, fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if (fd_ < 0)
+		YMB_ERROR("Event eventfd failed! errno = %d\n", errno);
+}
+
+Event::~Event()
+{
+	if (fd_ >= 0)
+		close(fd_);
+}
+
+int Event::Handle(void) const
+{
+	return fd_;
+}
+
+void Event::Signal(void)
+{
+	uint64_t val = 1;
+	if (write(fd_, &val, sizeof(val)) < 0)
+		YMB_DEBUG("Event signal failed! errno = %d\n", errno);
+}
+
+void Event::Disarm(void)
+{
+	waiting_.store(false);
+
+	uint64_t val;
+	if (read(fd_, &val, sizeof(val)) < 0 && errno != EAGAIN) //clear the counter
+		YMB_DEBUG("Event clear failed! errno = %d\n", errno);
+}
+
+void Event::Wait(long ms)
+{
+	struct pollfd pfd = { fd_, POLLIN, 0 };
+
+	if (poll(&pfd, 1, static_cast<int>(ms)) > 0) {
+		uint64_t val;
+		if (read(fd_, &val, sizeof(val)) < 0) //clear the counter
+			YMB_DEBUG("Event clear failed! errno = %d\n", errno);
+	}
+}
+
+#endif
+
+} //namespace YModbus
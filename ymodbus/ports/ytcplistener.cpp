@@ -59,6 +59,7 @@ struct TcpSession : public ISession
 		closesocket(sock_);
 		sock_ = sock;
 		recvlen_ = 0;
+		crc_.Reset();
 		lrt_ = time(0);
 	}
 
@@ -69,6 +70,7 @@ struct TcpSession : public ISession
 
 	virtual void Purge(void);
 	virtual void Discard(size_t nbytes);
+	virtual Crc16Context &RecvCrc(void) { return crc_; }
 
 	bool Recv(void);
 
@@ -76,6 +78,7 @@ struct TcpSession : public ISession
 	time_t lrt_; //last recv msg time
 	char recvbuf_[kMaxMsgLen];
 	size_t recvlen_;
+	Crc16Context crc_; //of recvbuf_
 };
 
 std::string TcpSession::PeerName()
@@ -126,6 +129,7 @@ int TcpSession::Read(uint8_t *buf, size_t bufsiz)
 
 	memcpy(buf, recvbuf_, bufsiz);
 	recvlen_ -= bufsiz;
+	crc_.Reset();
 
 	return static_cast<int>(bufsiz);
 }
@@ -157,6 +161,7 @@ void TcpSession::Purge(void)
 	} while (ret > 0);
 
 	recvlen_ = 0;
+	crc_.Reset();
 }
 
 void TcpSession::Discard(size_t nbytes)
@@ -168,12 +173,15 @@ void TcpSession::Discard(size_t nbytes)
 	else {
 		recvlen_ = 0;
 	}
+	crc_.Reset();
 }
 
 bool TcpSession::Recv()
 {
-	if (recvlen_ == sizeof(recvbuf_))
+	if (recvlen_ == sizeof(recvbuf_)) {
 		recvlen_ = 0;
+		crc_.Reset();
+	}
 
 	int len = recv(sock_,
 		&recvbuf_[recvlen_], sizeof(recvbuf_) - recvlen_, 0);
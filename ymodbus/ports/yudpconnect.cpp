@@ -17,9 +17,12 @@
 #	include <netinet/in.h>
 #   include <arpa/inet.h>
 #   include <unistd.h>
+#   include <fcntl.h>
 #	define closesocket close
 #endif
 
+#include <cerrno>
+
 namespace YModbus {
 
 namespace {
@@ -32,12 +35,34 @@ namespace {
 	typedef int socklen_t;
 #endif
 
+	//The connect or recv of non-blocking socket can't be completed now
+	bool WouldBlock(void)
+	{
+#ifdef WIN32
+		int err = WSAGetLastError();
+		return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+		return errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+	}
+
+	bool SetSocketNonBlock(SOCKET sock)
+	{
+#ifdef WIN32
+		u_long on = 1;
+		return ioctlsocket(sock, FIONBIO, &on) == 0;
+#else
+		int flags = fcntl(sock, F_GETFL, 0);
+		return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+	}
+
 } //namesapce {
 
 struct UdpConnect::Impl
 {
 	Impl(const std::string &ip, uint16_t port)
-		: ip_(ip), port_(port), sock_(INVALID_SOCKET)
+		: ip_(ip), port_(port), sock_(INVALID_SOCKET), nonblock_(false)
 	{
 	}
 
@@ -58,6 +83,7 @@ struct UdpConnect::Impl
 	uint16_t port_;
 	SOCKET sock_;
 	timeval tv_;
+	bool nonblock_;
 };
 
 UdpConnect::UdpConnect(const std::string &ip, uint16_t port)
@@ -93,12 +119,18 @@ bool UdpConnect::Validate(void)
 		return false;
 	}
 
+	if (impl_->nonblock_ && !SetSocketNonBlock(impl_->sock_)) {
+		impl_->Clear();
+		return false;
+	}
+
 	struct sockaddr_in addr = {0};
 	addr.sin_family = AF_INET;
 	addr.sin_port = htons(impl_->port_);
 	addr.sin_addr.s_addr = inet_addr(impl_->ip_.c_str());
 
-	if (connect(impl_->sock_, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+	if (connect(impl_->sock_, (struct sockaddr *)&addr, sizeof(addr)) != 0
+		&& !(impl_->nonblock_ && WouldBlock())) {
 		impl_->Clear();
 		return false;
 	}
@@ -108,7 +140,16 @@ bool UdpConnect::Validate(void)
 
 void UdpConnect::Purge(void)
 {
-	if (impl_->sock_ != INVALID_SOCKET) {
+	if (impl_->sock_ != INVALID_SOCKET && impl_->nonblock_) {
+		char buf[BUFSIZ];
+		int ret;
+
+		while ((ret = recv(impl_->sock_, buf, sizeof(buf), 0)) > 0)
+			;
+		if (ret == 0 || (ret < 0 && !WouldBlock()))
+			impl_->Clear();
+	}
+	else if (impl_->sock_ != INVALID_SOCKET) {
 		int ret;
 		fd_set fdsets;
 		timeval tv = { 0 };
@@ -158,7 +199,17 @@ int UdpConnect::Recv(uint8_t *buf, size_t len)
 {
 	int ret = -ENOLINK;
 
-	if (impl_->sock_ != INVALID_SOCKET) {
+	if (impl_->sock_ != INVALID_SOCKET && impl_->nonblock_) {
+		//ready by the poller of Handle, select can't take big handle
+		ret = recv(impl_->sock_, reinterpret_cast<char *>(buf), len, 0);
+		if (ret == 0) {
+			impl_->Clear();
+			return -ECONNRESET;
+		}
+		if (ret < 0 && WouldBlock())
+			return 0;
+	}
+	else if (impl_->sock_ != INVALID_SOCKET) {
 	    struct timeval tv = impl_->tv_;
 		fd_set fdsets;
 		FD_ZERO(&fdsets);
@@ -177,4 +228,20 @@ int UdpConnect::Recv(uint8_t *buf, size_t len)
 	return ret;
 }
 
+int UdpConnect::Handle(void) const
+{
+	return static_cast<int>(impl_->sock_);
+}
+
+//Socket opened later is non-blocking
+void UdpConnect::SetNonBlock(bool nonblock)
+{
+	impl_->nonblock_ = nonblock;
+}
+
+void UdpConnect::Close(void)
+{
+	impl_->Clear();
+}
+
 } //namespace YModbus
@@ -50,6 +50,7 @@ struct UdpListener::Impl : public ISession
 
 	virtual void Purge(void);
 	virtual void Discard(size_t nbytes);
+	virtual Crc16Context &RecvCrc(void) { return crc_; }
 
 	bool Recv(void);
 
@@ -58,6 +59,7 @@ struct UdpListener::Impl : public ISession
 	timeval tv_ = { 0, 0 };
 	char recvbuf_[kMaxMsgLen];
 	size_t recvlen_;
+	Crc16Context crc_; //of recvbuf_
 	sockaddr addr_;
 	socklen_t alen_;
 };
@@ -101,6 +103,7 @@ int UdpListener::Impl::Read(uint8_t *buf, size_t bufsiz)
 
 	memcpy(buf, recvbuf_, bufsiz);
 	recvlen_ -= bufsiz;
+	crc_.Reset();
 
 	return static_cast<int>(bufsiz);
 }
@@ -114,6 +117,7 @@ size_t UdpListener::Impl::Peek(uint8_t **buf)
 void UdpListener::Impl::Purge(void)
 {
 	recvlen_ = 0;
+	crc_.Reset();
 }
 
 void UdpListener::Impl::Discard(size_t nbytes)
@@ -125,11 +129,13 @@ void UdpListener::Impl::Discard(size_t nbytes)
 	else {
 		recvlen_ = 0;
 	}
+	crc_.Reset();
 }
 
 bool UdpListener::Impl::Recv()
 {
 	int len = recvfrom(sock_, recvbuf_, sizeof(recvbuf_), 0, &addr_, &alen_);
+	crc_.Reset(); //a datagram is a new buffer
 	if (len > 0) {
 		recvlen_ = len;
 		YMB_HEXDUMP0(recvbuf_, recvlen_,
@@ -0,0 +1,168 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Aggregate reads per second of a bus group as buses are added.
+//Each bus is a pty with kSlaves devices behind it, the line of kBaudrate
+//is emulated like bench_ymbrtu. One scan list of all of slaves is run
+//by a scanner over the group, so reads/s should grow with the buses.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbbus.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp ../ymod/ymbhex.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp ../ports/linuxsercon.cpp -lpthread
+//	../ports/yevent.cpp ../ports/linuxsercon.cpp ../ymod/ymbtask.cpp
+//	../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp -lpthread
+#include "ymod/master/ymaster.h"
+#include "ymod/master/ymbbus.h"
+#include "ymod/master/ymbscanner.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t kBaudrate = 19200;
+const size_t kBusNums[] = { 1, 2, 4, 8 };
+const uint8_t kSlaves = 4; //on each bus
+const uint16_t kRegNum = 10;
+const long kPeriod = 20; //ms, shorter than a round of the bus
+const auto kDuration = std::chrono::seconds(2);
+
+//Reads updated, of all buses
+class CountStore : public IStore
+{
+public:
+	void Set(uint8_t, uint16_t, const uint8_t*, uint16_t) override { count++; }
+	bool Get(uint8_t, uint16_t, uint8_t*, uint16_t) const override { return false; }
+	void Save(uint8_t, uint16_t, const uint8_t*, uint16_t) override {}
+	void Load(uint8_t, uint16_t, const uint8_t*, uint16_t) override {}
+
+	std::atomic<uint64_t> count{ 0 };
+};
+
+//Answer read holding registers of any slave on the line of kBaudrate
+void Serve(int fd)
+{
+	MRtu prot;
+	uint8_t reqbuf[kMaxMsgLen];
+	uint8_t rspbuf[kMaxMsgLen];
+	size_t reqlen = 0;
+	long tchar = GetSerCharTime(kBaudrate, 8, kSerParityNone, kSerStopbits1);
+	long t35 = GetSerFrameGap(kBaudrate, tchar);
+
+	for (;;) {
+		ssize_t ret = read(fd, reqbuf + reqlen, sizeof(reqbuf) - reqlen);
+		if (ret <= 0)
+			break;
+		reqlen += static_cast<size_t>(ret);
+
+		int need = prot.VerifyMasterMsg(reqbuf, reqlen);
+		if (need > 0)
+			continue;
+
+		MsgInf inf;
+		if (need < 0 || prot.ParseMasterMsg(reqbuf, reqlen, inf) != EOK) {
+			reqlen = 0;
+			continue;
+		}
+
+		//the request on the line, then the silence ended it
+		auto due = Clock::now() + std::chrono::microseconds(tchar * reqlen + t35);
+		reqlen = 0;
+
+		size_t roff = prot.GetSlaveDataOffset(inf.fun);
+		memset(rspbuf + roff, 0, inf.rnum * 2);
+		inf.err = 0;
+		inf.datalen = static_cast<uint8_t>(inf.rnum * 2);
+		inf.databuf = nullptr; //The Datas have filled into rspbuf.
+
+		size_t rsplen = prot.MakeSlaveMsg(rspbuf, sizeof(rspbuf), inf);
+		for (size_t i = 0; i < rsplen; i++) {
+			std::this_thread::sleep_until(due);
+			if (write(fd, rspbuf + i, 1) < 0)
+				return;
+			due += std::chrono::microseconds(tchar);
+		}
+	}
+}
+
+//return: reads per second
+double Bench(size_t buses)
+{
+	std::vector<int> ptys;
+	std::vector<std::thread> devices;
+	auto store = std::make_shared<CountStore>();
+	double rps = 0;
+
+	{
+		BusGroup<RtuMaster> group;
+		std::vector<ScanItem> items;
+
+		for (size_t bus = 0; bus < buses; bus++) {
+			int pty = posix_openpt(O_RDWR | O_NOCTTY);
+			if (pty < 0 || grantpt(pty) != 0 || unlockpt(pty) != 0) {
+				printf("pty is not available\n");
+				return 0;
+			}
+			ptys.push_back(pty);
+			devices.emplace_back([pty] { Serve(pty); });
+
+			group.AddBus(std::string(ptsname(pty)), kBaudrate,
+				kSerParityNone, static_cast<uint8_t>(kSerStopbits1), TASK);
+
+			uint8_t first = static_cast<uint8_t>(bus * kSlaves + 1);
+			group.SetRoute(first, static_cast<uint8_t>(first + kSlaves - 1), bus);
+			for (uint8_t sid = first; sid < first + kSlaves; sid++)
+				items.push_back({ sid, kFunReadHoldingRegisters, 0, kRegNum });
+		}
+		group.SetStore(store);
+
+		Scanner<BusGroup<RtuMaster>> scanner(group);
+		for (auto &item : items) //a group of each slave, not to wait others
+			scanner.AddGroup({ item }, kPeriod);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(200)); //warm up
+		uint64_t start = store->count;
+		auto begin = Clock::now();
+		std::this_thread::sleep_for(kDuration);
+		std::chrono::duration<double> d = Clock::now() - begin;
+		rps = (store->count - start) / d.count();
+	}
+
+	for (size_t i = 0; i < ptys.size(); i++) { //device is woken up by the pty closed
+		devices[i].join();
+		close(ptys[i]);
+	}
+
+	return rps;
+}
+
+} //namespace {
+
+int main()
+{
+	Task::LetUsGo();
+
+	printf("%u bps, %u slaves per bus, read %u registers every %ld ms\n",
+		kBaudrate, kSlaves, kRegNum, kPeriod);
+
+	double single = 0;
+	for (size_t buses : kBusNums) {
+		double rps = Bench(buses);
+		if (single == 0)
+			single = rps;
+		printf("buses %zu  %8.1f reads/s  %4.2fx\n", buses, rps,
+			single > 0 ? rps / single : 0.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Throughput of each kernel of Crc16 by message length, from a short
+//rtu request to the longest buffers.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbcrc.cpp ../ymod/ymbcrc.cpp
+#include "ymod/ymbcrc.h"
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t kLens[] = { 6, 8, 16, 32, 64, 128, 256, 4096, 65536 };
+const size_t kBytes = 64 << 20; //crc of each length and kernel
+
+const eCrcKernel kKernels[] = { CRC_BYTE, CRC_SLICE8, CRC_SLICE16, CRC_CLMUL, CRC_AUTO };
+const char *kNames[] = { "byte", "slice8", "slice16", "clmul", "auto" };
+
+volatile uint16_t sink;
+
+//return: MB/s
+double Measure(eCrcKernel kernel, const std::vector<uint8_t> &buf, size_t len)
+{
+	size_t rounds = kBytes / len;
+	uint16_t crc = 0;
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < rounds; i++)
+		crc ^= Crc16(buf.data() + (i & 7), len, kernel);
+	std::chrono::duration<double> d = Clock::now() - start;
+
+	sink = crc;
+	return rounds * len / d.count() / 1e6;
+}
+
+} //namespace {
+
+int main()
+{
+	std::vector<uint8_t> buf(kLens[sizeof(kLens) / sizeof(kLens[0]) - 1] + 8);
+	for (size_t i = 0; i < buf.size(); i++)
+		buf[i] = static_cast<uint8_t>(i * 131 + 7);
+
+	printf("MB/s%6s", "len");
+	for (const char *name : kNames)
+		printf("%10s", name);
+	printf("\n");
+
+	for (size_t len : kLens) {
+		printf("%10zu", len);
+		for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); k++) {
+			if (!Crc16Supported(kKernels[k]))
+				printf("%10s", "-");
+			else
+				printf("%10.0f", Measure(kKernels[k], buf, len));
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
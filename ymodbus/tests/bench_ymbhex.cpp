@@ -0,0 +1,157 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Ascii framing by rtu msg length: making a msg(hex encode and lrc) and
+//parsing one back(hex decode, lrc and check of characters), of the
+//former character per step loops and of HexEncode/HexDecode.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbhex.cpp ../ymod/ymbhex.cpp
+#include "ymod/ymbhex.h"
+#include "ymod/ymbdefs.h"
+
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t kLens[] = { 8, 16, 32, 64, 128, 254 };
+const size_t kBytes = 64 << 20; //rtu bytes of each length and way
+const size_t kRtuBufOff = 513 - 254 - 1;
+
+volatile uint8_t sink;
+
+size_t OldEncode(uint8_t *buf, const uint8_t *prtu, size_t msglen)
+{
+	uint8_t *pbuf = buf;
+	uint8_t lrc = (uint8_t)(~std::accumulate(prtu, prtu + msglen, 0) + 1);
+
+	*pbuf++ = ':'; //start char
+	std::for_each(prtu, prtu + msglen, [&pbuf](uint8_t d) {
+		*pbuf = static_cast<uint8_t>(d >> 4);
+		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
+		pbuf++;
+		*pbuf = static_cast<uint8_t>(d & 0xf);
+		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
+		pbuf++;
+	});
+
+	*pbuf = static_cast<uint8_t>(lrc >> 4);
+	*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
+	pbuf++;
+	*pbuf = static_cast<uint8_t>(lrc & 0xf);
+	*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
+	pbuf++;
+
+	*pbuf++ = '\r';
+	*pbuf++ = '\n';
+
+	return static_cast<size_t>(pbuf - buf);
+}
+
+//return: lrc, 0 is OK
+uint8_t OldDecode(uint8_t *msg, size_t msglen)
+{
+	uint8_t *prtu = msg;
+	size_t i;
+
+	for (i = 1; i < msglen - 4; i += 2) {
+		*prtu = msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA;
+		*prtu <<= 4;
+		*prtu |= msg[i+1] <= '9' ? msg[i+1] - '0' : msg[i+1] - 'A' + 0xA;
+		++prtu;
+	}
+
+	size_t rtulen = static_cast<size_t>(prtu - msg);
+	uint8_t lrc = (uint8_t)(~std::accumulate(msg, msg + rtulen, 0) + 1);
+
+	lrc -= (msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA) << 4;
+	lrc -= msg[i + 1] <= '9' ? msg[i + 1] - '0' : msg[i + 1] - 'A' + 0xA;
+
+	return lrc;
+}
+
+size_t NewEncode(uint8_t *buf, const uint8_t *prtu, size_t rtulen)
+{
+	uint8_t *pbuf = buf;
+
+	*pbuf++ = ':'; //start char
+	uint8_t lrc = static_cast<uint8_t>(-HexEncode(prtu, rtulen, pbuf));
+	pbuf += rtulen * 2;
+
+	HexEncode(&lrc, 1, pbuf);
+	pbuf += 2;
+
+	*pbuf++ = '\r';
+	*pbuf++ = '\n';
+
+	return static_cast<size_t>(pbuf - buf);
+}
+
+uint8_t NewDecode(uint8_t *msg, size_t msglen)
+{
+	uint8_t sum;
+
+	if (HexDecode(msg + 1, (msglen - 5) / 2 + 1, msg, sum) != EOK)
+		return 0xFF;
+
+	return sum;
+}
+
+//return: MB/s of rtu bytes
+template<typename TEncode, typename TDecode>
+void Measure(size_t len, TEncode encode, TDecode decode, double &enc, double &dec)
+{
+	uint8_t buf[600];
+	uint8_t msg[600];
+	size_t rounds = kBytes / len;
+	size_t msglen = 0;
+	uint8_t acc = 0;
+
+	for (size_t i = 0; i < len; i++)
+		buf[kRtuBufOff + i] = static_cast<uint8_t>(i * 131 + 7);
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < rounds; i++) {
+		buf[kRtuBufOff] = static_cast<uint8_t>(i);
+		msglen = encode(buf, buf + kRtuBufOff, len);
+		acc ^= buf[msglen - 3];
+	}
+	std::chrono::duration<double> d = Clock::now() - start;
+	enc = rounds * len / d.count() / 1e6;
+
+	start = Clock::now();
+	for (size_t i = 0; i < rounds; i++) {
+		memcpy(msg, buf, msglen); //decoded in place
+		acc ^= decode(msg, msglen);
+	}
+	d = Clock::now() - start;
+	dec = rounds * len / d.count() / 1e6;
+
+	sink = acc;
+}
+
+} //namespace {
+
+int main()
+{
+	printf("MB/s of rtu bytes, decode includes a copy of the msg\n");
+	printf("%6s %10s %10s %10s %10s\n", "len", "old enc", "new enc", "old dec", "new dec");
+
+	for (size_t len : kLens) {
+		double oenc, odec, nenc, ndec;
+
+		Measure(len, OldEncode, OldDecode, oenc, odec);
+		Measure(len, NewEncode, NewDecode, nenc, ndec);
+		printf("%6zu %10.0f %10.0f %10.0f %10.0f\n", len, oenc, nenc, odec, ndec);
+	}
+
+	return 0;
+}
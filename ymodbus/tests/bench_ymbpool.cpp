@@ -0,0 +1,179 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Scaling benchmark of master pool against a local gateway.
+//The gateway serves each socket in its own thread, and every request
+//takes kDeviceDelay like a serial device behind it, so one connection
+//is limited to 1/kDeviceDelay transactions per second.
+//g++ -std=c++14 -O2 -I.. -I../include bench_ymbpool.cpp ../ymod/ymbprot.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp ../ports/ytcpconnect.cpp -lpthread
+//	../ports/ytcpconnect.cpp ../ymod/ymbtask.cpp ../ymod/ymbprot.cpp -lpthread
+#include "ymod/master/ymaster.h"
+#include "ymod/master/ymbpool.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+const uint16_t kPort = 5512;
+const auto kDeviceDelay = std::chrono::milliseconds(2);
+const auto kDuration = std::chrono::seconds(2);
+const size_t kClients = 32; //application threads
+
+class Gateway
+{
+public:
+	bool Start(uint16_t port)
+	{
+		fd_ = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd_ < 0)
+			return false;
+
+		int on = 1;
+		setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+		if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0
+			|| listen(fd_, 64) < 0)
+			return false;
+
+		std::thread([this] { this->Accept(); }).detach();
+		return true;
+	}
+
+private:
+	void Accept(void)
+	{
+		int fd;
+		while ((fd = accept(fd_, nullptr, nullptr)) >= 0)
+			std::thread([fd] { Serve(fd); }).detach();
+	}
+
+	//One request at a time, only read holding registers
+	static void Serve(int fd)
+	{
+		Net<MNullInterface> prot;
+		uint8_t reqbuf[kMaxMsgLen];
+		uint8_t rspbuf[kMaxMsgLen];
+		size_t reqlen = 0;
+
+		for (;;) {
+			ssize_t ret = recv(fd, reqbuf + reqlen, sizeof(reqbuf) - reqlen, 0);
+			if (ret <= 0)
+				break;
+			reqlen += static_cast<size_t>(ret);
+
+			int need = prot.VerifyMasterMsg(reqbuf, reqlen);
+			if (need > 0)
+				continue;
+
+			MsgInf inf;
+			if (need < 0 || prot.ParseMasterMsg(reqbuf, reqlen, inf) != EOK
+				|| inf.fun != kFunReadHoldingRegisters) {
+				reqlen = 0;
+				continue;
+			}
+			reqlen = 0;
+
+			std::this_thread::sleep_for(kDeviceDelay);
+
+			size_t roff = prot.GetSlaveDataOffset(inf.fun);
+			memset(rspbuf + roff, 0, inf.rnum * 2);
+			inf.err = 0;
+			inf.datalen = static_cast<uint8_t>(inf.rnum * 2);
+			inf.databuf = nullptr; //The Datas have filled into rspbuf.
+
+			size_t rsplen = prot.MakeSlaveMsg(rspbuf, sizeof(rspbuf), inf);
+			if (send(fd, rspbuf, rsplen, 0) < 0)
+				break;
+		}
+
+		close(fd);
+	}
+
+	int fd_ = -1;
+};
+
+//return: transactions per second
+double Bench(size_t conns)
+{
+	MasterPool<TcpMaster> pool(conns, SHARD_LEAST,
+		std::string("127.0.0.1"), kPort, TASK);
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> done(0);
+	std::atomic<uint64_t> errors(0);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100)); //connected
+
+	std::vector<std::thread> clients;
+	for (size_t c = 0; c < kClients; c++) {
+		clients.emplace_back([&pool, &stop, &done, &errors, c] {
+			uint8_t buf[32];
+			uint8_t sid = static_cast<uint8_t>(c + 1);
+			while (!stop) {
+				if (pool.ReadHoldingRegisters(sid, 0, 10, buf, sizeof(buf)) == 20)
+					done++;
+				else
+					errors++;
+			}
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(kDuration);
+	stop = true;
+
+	for (auto &t : clients)
+		t.join();
+
+	std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+	if (errors != 0)
+		printf("%u errors\n", static_cast<unsigned>(errors.load()));
+
+	return done / secs.count();
+}
+
+} //namespace {
+
+int main()
+{
+	Gateway gateway;
+	if (!gateway.Start(kPort)) {
+		printf("gateway start failed!\n");
+		return 1;
+	}
+
+	Task::LetUsGo();
+
+	printf("connections   trans/s   scaling\n");
+
+	double single = 0;
+	for (size_t conns : { 1, 2, 4, 8 }) {
+		double rate = Bench(conns);
+		if (single == 0)
+			single = rate;
+
+		printf("%11u   %7.0f   %6.2fx\n",
+			static_cast<unsigned>(conns), rate, rate / single);
+	}
+
+	return 0;
+}
@@ -0,0 +1,311 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Contention benchmark of master submission queue.
+//std::queue + mutex + condvar(the old master queue) vs MpscQueue + Event,
+//with 1, 4, 16 and 64 producers posting querys to one consumer.
+//dedup: MpscQueue + Event, and the consumer adds the querys into a
+//QueryList as master task does, which absorbs the identical ones.
+//Requests of the master api through TMaster over a slave in memory,
+//ReadHoldingRegistersAsync and ReadHoldingRegisters from 1, 4, 16 and
+//64 threads, each takes a request from RequestPool and puts it back.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbqueue.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp -lpthread
+#include "ymod/ymbqueue.h"
+#include "ymod/master/ymbquery.h"
+#include "ymod/master/ymaster.h"
+#include "ymod/master/yconnect.h"
+#include "ymod/ymbevent.h"
+#include "ymod/ymbprot.h"
+#include "ymod/ymbdefs.h"
+#include "ymbopts.h"
+
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+const size_t kTotalMsgs = 2000000;
+const size_t kBlocks = 8; //of each producer
+const size_t kTotalReqs = 200000;
+
+class LockQueue
+{
+public:
+	bool Post(const MsgInf &inf)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (querys_.size() >= kMaxQueryNum)
+			return false;
+		querys_.push(inf);
+		cond_.notify_all();
+		return true;
+	}
+
+	template<typename F>
+	void Drain(F f)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (querys_.empty())
+			cond_.wait_for(lock, std::chrono::seconds(1));
+
+		while (!querys_.empty()) {
+			MsgInf inf = querys_.front();
+			querys_.pop();
+			lock.unlock();
+			f(inf);
+			lock.lock();
+		}
+	}
+
+private:
+	std::queue<MsgInf> querys_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+};
+
+class RingQueue
+{
+public:
+	bool Post(const MsgInf &inf)
+	{
+		if (!querys_.Push(inf))
+			return false;
+		event_.Notify();
+		return true;
+	}
+
+	template<typename F>
+	void Drain(F f)
+	{
+		event_.WaitFor(1000, [this] { return !querys_.Empty(); });
+
+		MsgInf inf;
+		while (querys_.Pop(inf))
+			f(inf);
+	}
+
+private:
+	MpscQueue<MsgInf, kMaxQueryNum> querys_;
+	Event event_;
+};
+
+class DedupQueue
+{
+public:
+	bool Post(const MsgInf &inf) { return ring_.Post(inf); }
+
+	template<typename F>
+	void Drain(F f)
+	{
+		ring_.Drain([this, &f](const MsgInf &inf) {
+			list_.Add(inf);
+			f(inf);
+		});
+
+		while (!list_.Empty()) //sent
+			list_.Pop();
+	}
+
+private:
+	RingQueue ring_;
+	QueryList list_;
+};
+
+template<typename TQueue>
+double Bench(size_t producers)
+{
+	TQueue queue;
+	size_t each = kTotalMsgs / producers;
+	size_t total = each * producers;
+	size_t count = 0;
+	uint64_t sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&queue, each, p] {
+			for (size_t i = 0; i < each; i++) {
+				MsgInf inf = { static_cast<uint8_t>(p), kFunReadHoldingRegisters,
+					static_cast<uint16_t>(i % kBlocks * 10), 10 }; //polling blocks
+				while (!queue.Post(inf)) //both bounded, consumer is behind
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		});
+	}
+
+	while (count < total) {
+		queue.Drain([&count, &sum](const MsgInf &inf) {
+			sum += inf.rreg;
+			count++;
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+	if (sum == 0) //keep the consumer work
+		printf("bad sum\n");
+
+	return total / secs.count();
+}
+
+//Slave in memory answering each Read Holding Registers(MBAP) at once
+class LoopConnect : public IConnect
+{
+public:
+	LoopConnect(const std::string&, uint16_t) : len_(0), off_(0) {}
+
+	void SetTimeout(long) {}
+	bool Validate(void) { return true; }
+	void Purge(void) { len_ = off_ = 0; }
+
+	bool Send(uint8_t *buf, size_t len)
+	{
+		if (len < 12 || buf[7] != kFunReadHoldingRegisters)
+			return false;
+
+		uint8_t bytes = static_cast<uint8_t>(((buf[10] << 8) | buf[11]) * 2);
+		if (len_ + 9u + bytes > sizeof(rsp_))
+			return false;
+
+		uint8_t *rsp = rsp_ + len_;
+		memcpy(rsp, buf, 4); //tid, protocol
+		rsp[4] = 0;
+		rsp[5] = static_cast<uint8_t>(3 + bytes);
+		rsp[6] = buf[6];
+		rsp[7] = buf[7];
+		rsp[8] = bytes;
+		memset(rsp + 9, 0x5a, bytes);
+		len_ += 9u + bytes;
+
+		return true;
+	}
+
+	int Recv(uint8_t *buf, size_t len)
+	{
+		size_t n = std::min(len, len_ - off_);
+
+		memcpy(buf, rsp_ + off_, n);
+		off_ += n;
+		if (off_ == len_)
+			len_ = off_ = 0;
+
+		return static_cast<int>(n);
+	}
+
+private:
+	uint8_t rsp_[4096];
+	size_t len_;
+	size_t off_;
+};
+
+typedef TMaster<MNet, LoopConnect> LoopMaster;
+
+//return: requests/s
+double BenchAsync(LoopMaster &master, size_t producers)
+{
+	size_t each = kTotalReqs / producers;
+	size_t total = each * producers;
+	std::atomic<size_t> done(0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&master, &done, each, p] {
+			for (size_t i = 0; i < each; i++) {
+				while (master.ReadHoldingRegistersAsync(static_cast<uint8_t>(p + 1),
+					static_cast<uint16_t>(i % kBlocks * 10), 10,
+					[&done](int, const uint8_t*) { done++; }) != EOK)
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+	while (done < total)
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+	std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+	return total / secs.count();
+}
+
+//return: requests/s
+double BenchSync(LoopMaster &master, size_t producers)
+{
+	size_t each = kTotalReqs / producers;
+	size_t total = each * producers;
+	std::atomic<size_t> failed(0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&master, &failed, each, p] {
+			uint8_t buf[20];
+			for (size_t i = 0; i < each; i++) {
+				if (master.ReadHoldingRegisters(static_cast<uint8_t>(p + 1),
+					static_cast<uint16_t>(i % kBlocks * 10), 10, buf, sizeof(buf)) != 20)
+					failed++;
+			}
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+	if (failed != 0)
+		printf("%zu reads failed\n", failed.load());
+
+	return total / secs.count();
+}
+
+} //namespace {
+
+int main()
+{
+	printf("producers   mutex+condvar(msg/s)   mpsc+event(msg/s)   gain"
+		"   mpsc+dedup(msg/s)   gain\n");
+
+	for (size_t producers : { 1, 4, 16, 64 }) {
+		double locked = Bench<LockQueue>(producers);
+		double ring = Bench<RingQueue>(producers);
+		double dedup = Bench<DedupQueue>(producers);
+
+		printf("%9u   %20.0f   %17.0f   %4.2fx   %17.0f   %4.2fx\n",
+			static_cast<unsigned>(producers), locked, ring, ring / locked,
+			dedup, dedup / locked);
+	}
+
+	LoopMaster master("loop", 502, TASK);
+	master.SetWindow(16);
+	Task::LetUsGo();
+
+	printf("\nproducers   ReadHoldingRegistersAsync(req/s)   ReadHoldingRegisters(req/s)\n");
+
+	for (size_t producers : { 1, 4, 16, 64 }) {
+		double async = BenchAsync(master, producers);
+		double sync = BenchSync(master, producers);
+
+		printf("%9u   %32.0f   %27.0f\n",
+			static_cast<unsigned>(producers), async, sync);
+	}
+
+	return 0;
+}
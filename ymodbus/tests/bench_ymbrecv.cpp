@@ -0,0 +1,222 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Response latency of master receive path.
+//rtu: a device on a pty answers after kDeviceDelay, the latency beyond
+//it is the cost of the receive path.
+//trickle: a tcp device sends the response a byte per kTrickleDelay, it
+//must be received within the read timeout.
+//silent: a tcp device never answers, the timeout should be the read
+//timeout.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbrecv.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp ../ports/ytcpconnect.cpp ../ports/linuxsercon.cpp -lpthread
+//	../ports/yevent.cpp ../ports/ytcpconnect.cpp ../ports/linuxsercon.cpp
+//	../ymod/ymbtask.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp -lpthread
+#include "ymod/master/ymaster.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint16_t kPort = 5513;
+const auto kDeviceDelay = std::chrono::milliseconds(1);
+const auto kTrickleDelay = std::chrono::milliseconds(1);
+const long kReadTimeout = 100; //ms
+const int kRounds = 200;
+
+//Answer read holding registers with zeros
+//send: void(const uint8_t *rsp, size_t len)
+template<typename TProtocol>
+void Serve(int fd, std::function<void(const uint8_t*, size_t)> send)
+{
+	TProtocol prot;
+	uint8_t reqbuf[kMaxMsgLen];
+	uint8_t rspbuf[kMaxMsgLen];
+	size_t reqlen = 0;
+
+	for (;;) {
+		ssize_t ret = read(fd, reqbuf + reqlen, sizeof(reqbuf) - reqlen);
+		if (ret <= 0)
+			break;
+		reqlen += static_cast<size_t>(ret);
+
+		int need = prot.VerifyMasterMsg(reqbuf, reqlen);
+		if (need > 0)
+			continue;
+
+		MsgInf inf;
+		if (need < 0 || prot.ParseMasterMsg(reqbuf, reqlen, inf) != EOK) {
+			reqlen = 0;
+			continue;
+		}
+		reqlen = 0;
+
+		size_t roff = prot.GetSlaveDataOffset(inf.fun);
+		memset(rspbuf + roff, 0, inf.rnum * 2);
+		inf.err = 0;
+		inf.datalen = static_cast<uint8_t>(inf.rnum * 2);
+		inf.databuf = nullptr; //The Datas have filled into rspbuf.
+
+		send(rspbuf, prot.MakeSlaveMsg(rspbuf, sizeof(rspbuf), inf));
+	}
+
+	close(fd);
+}
+
+int Listen(uint16_t port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+//return: us of each read, failed reads are not counted
+template<typename TMasterT>
+std::vector<double> Measure(TMasterT &master, int &errors)
+{
+	std::vector<double> us;
+	uint8_t buf[64];
+
+	errors = 0;
+	for (int i = 0; i < kRounds; i++) {
+		auto start = Clock::now();
+		int ret = master.ReadHoldingRegisters(1, 0, 10, buf, sizeof(buf));
+		std::chrono::duration<double, std::micro> d = Clock::now() - start;
+
+		if (ret == 20)
+			us.push_back(d.count());
+		else
+			errors++;
+	}
+
+	return us;
+}
+
+void Report(const char *name, std::vector<double> us, int errors)
+{
+	if (us.empty()) {
+		printf("%-8s  all %d reads failed\n", name, errors);
+		return;
+	}
+
+	std::sort(us.begin(), us.end());
+	printf("%-8s  p50 %8.0f us  p99 %8.0f us  max %8.0f us  errors %d\n", name,
+		us[us.size() / 2], us[us.size() * 99 / 100], us.back(), errors);
+}
+
+void BenchRtu(void)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		printf("rtu       pty is not available\n");
+		return;
+	}
+
+	std::thread([master] {
+		Serve<MRtu>(master, [master](const uint8_t *rsp, size_t len) {
+			std::this_thread::sleep_for(kDeviceDelay);
+			if (write(master, rsp, len) < 0)
+				return;
+		});
+	}).detach();
+
+	RtuMaster rtu(ptsname(master), 9600, kSerParityNone, 1, POLL);
+	rtu.SetReadTimeout(kReadTimeout);
+
+	int errors;
+	std::vector<double> us = Measure(rtu, errors);
+	for (auto &u : us) //only the receive path
+		u -= std::chrono::duration<double, std::micro>(kDeviceDelay).count();
+
+	Report("rtu", us, errors);
+}
+
+void BenchTcp(const char *name, bool silent)
+{
+	int lfd = Listen(kPort);
+	if (lfd < 0) {
+		printf("%-8s  listen failed\n", name);
+		return;
+	}
+
+	std::thread([lfd, silent] {
+		int fd = accept(lfd, nullptr, nullptr);
+		close(lfd);
+		Serve<MNet>(fd, [fd, silent](const uint8_t *rsp, size_t len) {
+			for (size_t i = 0; i < len && !silent; i++) {
+				std::this_thread::sleep_for(kTrickleDelay);
+				if (send(fd, rsp + i, 1, 0) < 0)
+					return;
+			}
+		});
+	}).detach();
+
+	TcpMaster tcp("127.0.0.1", kPort, POLL);
+	tcp.SetReadTimeout(kReadTimeout);
+	tcp.SetRetries(1);
+
+	int errors;
+	std::vector<double> us;
+
+	if (silent) { //the time of timeout
+		uint8_t buf[64];
+		for (int i = 0; i < 10; i++) {
+			auto start = Clock::now();
+			tcp.ReadHoldingRegisters(1, 0, 10, buf, sizeof(buf));
+			us.push_back(std::chrono::duration<double, std::micro>(
+				Clock::now() - start).count());
+		}
+		errors = 0;
+	}
+	else {
+		us = Measure(tcp, errors);
+	}
+
+	Report(name, us, errors);
+}
+
+} //namespace {
+
+int main()
+{
+	printf("read timeout %ld ms, device delay %ld ms, trickle %ld ms/byte\n",
+		kReadTimeout, static_cast<long>(kDeviceDelay.count()),
+		static_cast<long>(kTrickleDelay.count()));
+
+	BenchRtu();
+	BenchTcp("trickle", false);
+	BenchTcp("silent", true);
+
+	return 0;
+}
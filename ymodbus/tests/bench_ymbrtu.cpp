@@ -0,0 +1,159 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Transactions per second of rtu master at the standard baud rates.
+//A device on a pty emulates the line: the request is received after
+//its chars and the silence of 3.5 chars, and the response is written a
+//char per char time. The bound is one request and one response on the
+//line with the silences between them.
+//g++ -std=c++14 -O2 -DNDEBUG -I.. -I../include bench_ymbrtu.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp ../ports/linuxsercon.cpp -lpthread
+//	../ports/yevent.cpp ../ports/linuxsercon.cpp ../ymod/ymbtask.cpp
+//	../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp -lpthread
+#include "ymod/master/ymaster.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t kBaudrates[] = { 9600, 19200, 38400, 57600, 115200 };
+const auto kDuration = std::chrono::seconds(1);
+const uint16_t kRegNum = 10;
+const uint16_t kMaxReg = 100; //exception of illegal address above it
+const long kReadTimeout = 500; //ms
+
+//Answer read holding registers, the line is emulated by the baudrate
+void Serve(int fd, uint32_t baudrate, const std::atomic<bool> &stop)
+{
+	MRtu prot;
+	uint8_t reqbuf[kMaxMsgLen];
+	uint8_t rspbuf[kMaxMsgLen];
+	size_t reqlen = 0;
+	long tchar = GetSerCharTime(baudrate, 8, kSerParityNone, kSerStopbits1);
+	long t35 = GetSerFrameGap(baudrate, tchar);
+
+	while (!stop) {
+		ssize_t ret = read(fd, reqbuf + reqlen, sizeof(reqbuf) - reqlen);
+		if (ret <= 0)
+			break;
+		reqlen += static_cast<size_t>(ret);
+
+		int need = prot.VerifyMasterMsg(reqbuf, reqlen);
+		if (need > 0)
+			continue;
+
+		MsgInf inf;
+		if (need < 0 || prot.ParseMasterMsg(reqbuf, reqlen, inf) != EOK) {
+			reqlen = 0;
+			continue;
+		}
+
+		//the request on the line, then the silence ended it
+		auto due = Clock::now() + std::chrono::microseconds(tchar * reqlen + t35);
+		reqlen = 0;
+
+		size_t roff = prot.GetSlaveDataOffset(inf.fun);
+		if (inf.rreg + inf.rnum > kMaxReg) {
+			inf.err = 0x02; //illegal data address
+		}
+		else {
+			memset(rspbuf + roff, 0, inf.rnum * 2);
+			inf.err = 0;
+			inf.datalen = static_cast<uint8_t>(inf.rnum * 2);
+		}
+		inf.databuf = nullptr; //The Datas have filled into rspbuf.
+
+		size_t rsplen = prot.MakeSlaveMsg(rspbuf, sizeof(rspbuf), inf);
+		for (size_t i = 0; i < rsplen; i++) {
+			std::this_thread::sleep_until(due);
+			if (write(fd, rspbuf + i, 1) < 0)
+				return;
+			due += std::chrono::microseconds(tchar);
+		}
+	}
+}
+
+//reg: start register, above kMaxReg for exception responses
+//return: transactions per second
+double Measure(RtuMaster &rtu, uint16_t reg, int &errors)
+{
+	uint8_t buf[kRegNum * 2];
+	int done = 0;
+
+	errors = 0;
+	auto start = Clock::now();
+	while (Clock::now() - start < kDuration) {
+		int ret = rtu.ReadHoldingRegisters(1, reg, kRegNum, buf, sizeof(buf));
+		if (ret < 0 && ret != -EFAULT) //exception is -EFAULT
+			errors++;
+		done++;
+	}
+
+	std::chrono::duration<double> d = Clock::now() - start;
+	return done / d.count();
+}
+
+void Bench(uint32_t baudrate)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		printf("%6u  pty is not available\n", baudrate);
+		return;
+	}
+
+	std::atomic<bool> stop{ false };
+	std::thread device([master, baudrate, &stop] {
+		Serve(master, baudrate, stop);
+	});
+
+	long tchar = GetSerCharTime(baudrate, 8, kSerParityNone, kSerStopbits1);
+	long t35 = GetSerFrameGap(baudrate, tchar);
+	long reqlen = 8, rsplen = 5 + kRegNum * 2, exclen = 5;
+	double bound = 1e6 / ((reqlen + rsplen) * tchar + 2 * t35);
+	double exbound = 1e6 / ((reqlen + exclen) * tchar + 2 * t35);
+
+	{
+		RtuMaster rtu(ptsname(master), baudrate,
+			kSerParityNone, kSerStopbits1, POLL);
+		rtu.SetReadTimeout(kReadTimeout);
+		rtu.SetRetries(1);
+
+		int errors, exerrors;
+		double tps = Measure(rtu, 0, errors);
+		double extps = Measure(rtu, kMaxReg, exerrors);
+
+		printf("%6u  read %7.1f tps (%3.0f%% of %7.1f)  "
+			"exception %7.1f tps (%3.0f%% of %7.1f)  errors %d\n",
+			baudrate, tps, tps * 100 / bound, bound,
+			extps, extps * 100 / exbound, exbound, errors + exerrors);
+	}
+
+	stop = true; //device is woken up by the pty closed
+	device.join();
+	close(master);
+}
+
+} //namespace {
+
+int main()
+{
+	printf("read %u registers, %.0f s per baudrate\n", kRegNum,
+		std::chrono::duration<double>(kDuration).count());
+
+	for (uint32_t baudrate : kBaudrates)
+		Bench(baudrate);
+
+	return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "ymod/master/ymbmaster.h"
 #include "ymod/master/ymaster.h"
+#include "ymod/master/ymbscanner.h"
 
 #include <iomanip>
 
@@ -60,6 +61,44 @@ int main(int argc, char *argv[])
 
 	udpmaster.WaitAsynReader();
 
+	for (uint16_t i = 0; i < 100; i++)
+	{
+		udpmaster.ReadHoldingRegistersAsync(1, i, 2,
+			[i](int ret, const uint8_t *data) {
+			if (ret == 4)
+				YMB_DEBUG("ReadHoldingRegistersAsync reg %u = %02x%02x %02x%02x\n",
+					i, data[0], data[1], data[2], data[3]);
+			else
+				YMB_DEBUG("ReadHoldingRegistersAsync reg %u failed %d\n", i, ret);
+		});
+	}
+
+	udpmaster.WriteSingleRegisterAsync(1, 1, 0x1234, [](int ret, const uint8_t*) {
+		YMB_DEBUG("WriteSingleRegisterAsync ret = %d\n", ret);
+	});
+
+	//gaps of 2 registers are read too, 10 pulls in one read
+	udpmaster.SetQueryGap(2);
+	for (uint16_t i = 0; i < 10; i++)
+		udpmaster.PullHoldingRegisters(1, i * 10, 8);
+
+	{
+		Scanner<TMaster<MNet, UdpConnect>> scanner(udpmaster);
+		int fast = scanner.AddGroup({ { 1, kFunReadHoldingRegisters, 0, 10 } }, 100);
+		int slow = scanner.AddGroup({ { 1, kFunReadHoldingRegisters, 100, 50 },
+			{ 1, kFunReadCoils, 0, 16 } }, 1000, 50);
+
+		std::this_thread::sleep_for(std::chrono::seconds(3));
+
+		ScanStat stat;
+		for (int id : { fast, slow }) {
+			if (scanner.GetStat(id, stat))
+				YMB_DEBUG("Scan group %d cycles %u late %u missed %u errors %u\n", id,
+					(unsigned)stat.cycles, (unsigned)stat.late,
+					(unsigned)stat.missed, (unsigned)stat.errors);
+		}
+	}
+
 
 	udpmaster.SetByteOrder(BOR_1234);
 	{
@@ -0,0 +1,344 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//GetMasterMsgLen of Net(mbap length), Rtu(function and byte count) and
+//Ascii(ended by '\n'): incomplete, whole and followed by others, bad.
+//Accept loop of TSlave over a session in memory: two requests in one
+//read, a request split across reads with its crc resumed, a bad msg of
+//known length followed by a good one, and a bad mbap header.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbaccept.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp ../ymod/ymbhex.cpp ../ymod/ymbtask.cpp -lpthread
+#include "ymod/slave/yslave.h"
+#include "ymod/slave/ymbsession.h"
+#include "ymod/ymbcrc.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+const size_t kMaxAsciiLen = 513; //of Ascii
+
+//Bytes received by a slave, as the session of a listener keeps them
+class Session : public ISession
+{
+public:
+	std::string PeerName(void) { return "mem"; }
+
+	int Write(uint8_t *msg, size_t msglen)
+	{
+		sent.emplace_back(msg, msg + msglen);
+		return static_cast<int>(msglen);
+	}
+
+	int Read(uint8_t *buf, size_t bufsiz)
+	{
+		size_t len = std::min(bufsiz, recv.size());
+		memcpy(buf, recv.data(), len);
+		Discard(len);
+		return static_cast<int>(len);
+	}
+
+	size_t Peek(uint8_t **buf)
+	{
+		*buf = recv.data();
+		return recv.size();
+	}
+
+	void Purge(void)
+	{
+		recv.clear();
+		crc.Reset();
+		purges++;
+	}
+
+	void Discard(size_t nbytes)
+	{
+		recv.erase(recv.begin(), recv.begin() + std::min(nbytes, recv.size()));
+		crc.Reset();
+	}
+
+	Crc16Context &RecvCrc(void) { return crc; }
+
+	//bytes of the next read, appended as a listener does
+	void Feed(const Bytes &bytes) { recv.insert(recv.end(), bytes.begin(), bytes.end()); }
+
+	Bytes recv;
+	Crc16Context crc;
+	std::vector<Bytes> sent;
+	size_t purges = 0;
+};
+
+//Listener of the session above, it always has bytes
+class Listener
+{
+public:
+	explicit Listener(uint16_t) {}
+
+	std::string GetName(void) { return "mem"; }
+	void SetTimeout(long) {}
+	bool Listen(void) { return true; }
+
+	int Accept(std::vector<SessionPtr> &ses)
+	{
+		ses.assign(1, session);
+		return EOK;
+	}
+
+	static std::shared_ptr<Session> session;
+};
+
+std::shared_ptr<Session> Listener::session;
+
+//Registers read, their address is the value
+class Player : public IPlayer
+{
+public:
+	int ReadCoils(uint8_t, uint16_t, uint16_t, uint8_t*, size_t) { return -EINVAL; }
+	int ReadDiscreteInputs(uint8_t, uint16_t, uint16_t, uint8_t*, size_t) { return -EINVAL; }
+	int ReadInputRegisters(uint8_t, uint16_t, uint16_t, uint8_t*, size_t) { return -EINVAL; }
+
+	int ReadHoldingRegisters(uint8_t, uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz)
+	{
+		if (num * 2u > bufsiz)
+			return -ENOMEM;
+
+		regs.push_back(reg);
+		for (uint16_t i = 0; i < num; i++) {
+			*buf++ = static_cast<uint8_t>((reg + i) >> 8);
+			*buf++ = static_cast<uint8_t>(reg + i);
+		}
+		return num * 2;
+	}
+
+	int WriteSingleCoil(uint8_t, uint16_t, bool) { return -EINVAL; }
+	int WriteCoils(uint8_t, uint16_t, uint16_t, const uint8_t*, uint8_t) { return -EINVAL; }
+	int WriteSingleRegister(uint8_t, uint16_t, uint16_t) { return -EINVAL; }
+	int WriteRegisters(uint8_t, uint16_t, uint16_t, const uint8_t*, uint8_t) { return -EINVAL; }
+	int MaskWriteRegisters(uint8_t, uint16_t, uint16_t, uint16_t) { return -EINVAL; }
+	int WriteReadRegisters(uint8_t, uint16_t, uint16_t, const uint8_t*, uint8_t,
+		uint16_t, uint16_t, uint8_t*, size_t) { return -EINVAL; }
+	int ReportSlaveId(uint8_t, uint8_t*, size_t) { return -EINVAL; }
+
+	std::vector<uint16_t> regs; //of the requests executed
+};
+
+typedef TSlave<SNet, Listener, Player> NetSlave;
+typedef TSlave<SRtu, Listener, Player> RtuSlave;
+
+//Read Holding Registers of reg, 1 register
+Bytes Pdu(uint16_t reg)
+{
+	return { kFunReadHoldingRegisters, static_cast<uint8_t>(reg >> 8),
+		static_cast<uint8_t>(reg), 0x00, 0x01 };
+}
+
+Bytes Mbap(uint16_t tid, uint16_t reg)
+{
+	Bytes pdu = Pdu(reg);
+	Bytes msg = { static_cast<uint8_t>(tid >> 8), static_cast<uint8_t>(tid),
+		0x00, 0x00, 0x00, static_cast<uint8_t>(pdu.size() + 1), 0x01 };
+
+	msg.insert(msg.end(), pdu.begin(), pdu.end());
+	return msg;
+}
+
+Bytes Rtu(uint16_t reg)
+{
+	Bytes msg = Pdu(reg);
+
+	msg.insert(msg.begin(), 0x01);
+	uint16_t crc = Crc16(msg.data(), msg.size());
+	msg.push_back(static_cast<uint8_t>(crc));
+	msg.push_back(static_cast<uint8_t>(crc >> 8));
+	return msg;
+}
+
+Bytes operator + (Bytes a, const Bytes &b)
+{
+	a.insert(a.end(), b.begin(), b.end());
+	return a;
+}
+
+template<typename TProtocol>
+int ExpectLen(const char *name, const Bytes &bytes, int expect)
+{
+	TProtocol prot;
+	Bytes msg = bytes;
+
+	int len = prot.GetMasterMsgLen(msg.data(), msg.size());
+	if (len != expect) {
+		printf("%-8s %s: %d, expected %d\n", "len", name, len, expect);
+		return 1;
+	}
+
+	return 0;
+}
+
+int CheckLen(void)
+{
+	int errors = 0;
+	Bytes net = Mbap(7, 0x10);
+	Bytes rtu = Rtu(0x10);
+
+	//mbap length counts the unit id and the pdu
+	errors += ExpectLen<SNet>("net short", Bytes(net.begin(), net.begin() + 5), 0);
+	errors += ExpectLen<SNet>("net head", Bytes(net.begin(), net.begin() + 6), 12);
+	errors += ExpectLen<SNet>("net two", net + Mbap(8, 0x20), 12);
+	Bytes bad = net;
+	bad[2] = 0x01; //protocol id
+	errors += ExpectLen<SNet>("net proto", bad, -EBADMSG);
+	bad = net;
+	bad[5] = 0x01; //unit id only
+	errors += ExpectLen<SNet>("net 1", bad, -EBADMSG);
+	bad = net;
+	bad[4] = 0xff; //never fits
+	errors += ExpectLen<SNet>("net 65k", bad, -EBADMSG);
+
+	//by the function, and the byte count of writes
+	errors += ExpectLen<SRtu>("rtu fun", Bytes(rtu.begin(), rtu.begin() + 1), 0);
+	errors += ExpectLen<SRtu>("rtu min", Bytes(rtu.begin(), rtu.begin() + 5), 0);
+	errors += ExpectLen<SRtu>("rtu read", Bytes(rtu.begin(), rtu.begin() + 6), 8);
+	errors += ExpectLen<SRtu>("rtu two", rtu + Rtu(0x20), 8);
+	errors += ExpectLen<SRtu>("rtu write", { 0x01, kFunWriteMultiRegisters,
+		0x00, 0x10, 0x00, 0x02, 0x04 }, 7 + 4 + 2);
+	errors += ExpectLen<SRtu>("rtu exc", { 0x01, kFunReadHoldingRegisters | 0x80 }, 5);
+	errors += ExpectLen<SRtu>("rtu fun?", { 0x01, 0x64, 0x00 }, -EBADMSG);
+
+	//ended by '\n'
+	const char line[] = ":010300100001EB\r\n:0103";
+	Bytes ascii(line, line + sizeof(line) - 1);
+	errors += ExpectLen<SAscii>("asc none", {}, 0);
+	errors += ExpectLen<SAscii>("asc part", Bytes(ascii.begin(), ascii.begin() + 16), 0);
+	errors += ExpectLen<SAscii>("asc two", ascii, 17);
+	errors += ExpectLen<SAscii>("asc colon", { '0', '1', '\r', '\n' }, -EBADMSG);
+	ascii = Bytes(kMaxAsciiLen, '0');
+	ascii[0] = ':';
+	errors += ExpectLen<SAscii>("asc long", ascii, -EBADMSG);
+	errors += ExpectLen<SAscii>("asc late", ascii + Bytes(1, '\n'), -EBADMSG);
+
+	printf("%-8s %s\n", "len", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//Requests executed, responses sent and bytes left after one pass
+template<typename TSlaveT>
+int Expect(const char *name, TSlaveT &slave, const std::vector<uint16_t> &regs,
+	size_t left, size_t purges)
+{
+	Session &session = *Listener::session;
+	const std::vector<uint16_t> &done = slave.GetPlayer()->regs;
+
+	slave.Run(0);
+	if (done != regs || session.sent.size() != regs.size()
+		|| session.recv.size() != left || session.purges != purges) {
+		printf("%-8s %s: %zu executed, %zu sent, %zu left, %zu purged\n", "accept",
+			name, done.size(), session.sent.size(), session.recv.size(), session.purges);
+		return 1;
+	}
+
+	return 0;
+}
+
+template<typename TSlaveT>
+std::unique_ptr<TSlaveT> Create(void)
+{
+	Listener::session = std::make_shared<Session>();
+
+	std::unique_ptr<TSlaveT> slave(new TSlaveT(0, POLL));
+	slave->SetPlayer(std::make_shared<Player>());
+	return slave;
+}
+
+int CheckAccept(void)
+{
+	int errors = 0;
+
+	//two requests in one read
+	auto net = Create<NetSlave>();
+	Listener::session->Feed(Mbap(1, 0x10) + Mbap(2, 0x20));
+	errors += Expect("net two", *net, { 0x10, 0x20 }, 0, 0);
+	const Bytes &rsp = Listener::session->sent.back();
+	if (rsp.size() != 11 || rsp[1] != 2 || rsp[9] != 0x00 || rsp[10] != 0x20) {
+		printf("%-8s %s: response is not of tid 2\n", "accept", "net two");
+		errors++;
+	}
+
+	//split, the tail waits for the rest
+	net = Create<NetSlave>();
+	Bytes msg = Mbap(3, 0x30);
+	Listener::session->Feed(Bytes(msg.begin(), msg.begin() + 4));
+	errors += Expect("net head", *net, {}, 4, 0);
+	Listener::session->Feed(Bytes(msg.begin() + 4, msg.end() - 1));
+	errors += Expect("net part", *net, {}, msg.size() - 1, 0);
+	Listener::session->Feed(Bytes(msg.end() - 1, msg.end()) + Mbap(4, 0x40));
+	errors += Expect("net rest", *net, { 0x30, 0x40 }, 0, 0);
+
+	//bad msg of known length, only itself is dropped
+	net = Create<NetSlave>();
+	msg = Mbap(5, 0x50);
+	msg[5] = 3; //unit-fun-1 byte of read
+	msg.resize(9);
+	Listener::session->Feed(msg + Mbap(6, 0x60));
+	errors += Expect("net bad", *net, { 0x60 }, 0, 0);
+
+	//bad mbap header, the end of msg is unknown, all is dropped
+	net = Create<NetSlave>();
+	msg = Mbap(7, 0x70);
+	msg[2] = 0x12;
+	Listener::session->Feed(msg + Mbap(8, 0x80));
+	errors += Expect("net mbap", *net, {}, 0, 1);
+	Listener::session->Feed(Mbap(9, 0x90));
+	errors += Expect("net next", *net, { 0x90 }, 0, 1);
+
+	//rtu, split with the crc resumed
+	auto rtu = Create<RtuSlave>();
+	msg = Rtu(0x11);
+	Listener::session->Feed(Bytes(msg.begin(), msg.begin() + 5));
+	errors += Expect("rtu part", *rtu, {}, 5, 0);
+	if (Listener::session->crc.Length() == 0) {
+		printf("%-8s %s: crc is not kept\n", "accept", "rtu part");
+		errors++;
+	}
+	size_t added = Listener::session->crc.Length();
+	Listener::session->Feed(Bytes(msg.begin() + 5, msg.end() - 1));
+	errors += Expect("rtu crc", *rtu, {}, msg.size() - 1, 0);
+	if (Listener::session->crc.Length() <= added) {
+		printf("%-8s %s: crc is not resumed\n", "accept", "rtu crc");
+		errors++;
+	}
+	Listener::session->Feed(Bytes(msg.end() - 1, msg.end()) + Rtu(0x22));
+	errors += Expect("rtu rest", *rtu, { 0x11, 0x22 }, 0, 0);
+
+	//rtu, bad crc of known length, only itself is dropped
+	rtu = Create<RtuSlave>();
+	msg = Rtu(0x33);
+	msg.back() ^= 0xff;
+	Listener::session->Feed(msg + Rtu(0x44));
+	errors += Expect("rtu bad", *rtu, { 0x44 }, 0, 0);
+
+	printf("%-8s %s\n", "accept", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+int main()
+{
+	int errors = 0;
+
+	errors += CheckLen();
+	errors += CheckAccept();
+
+	return errors == 0 ? 0 : 1;
+}
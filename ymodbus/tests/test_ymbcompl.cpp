@@ -0,0 +1,181 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Completion holds small callables without allocating, through copy and
+//move, and allocates the large ones; the hook of Then is called after
+//the callable, and alone if there is no callable.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbcompl.cpp
+#include "ymod/ymbcompl.h"
+
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace YModbus;
+
+namespace {
+
+struct Probe;
+
+} //namespace {
+
+namespace YModbus {
+
+//Then is kept for the wrappers of the api, in place of them
+template<>
+class MasterPool<Probe>
+{
+public:
+	static void Then(Completion &c, void (*hook)(void *ctx), void *ctx)
+	{
+		c.Then(hook, ctx);
+	}
+};
+
+} //namespace YModbus
+
+namespace {
+
+typedef MasterPool<Probe> Wrapper;
+
+size_t allocs = 0;
+
+struct Large
+{
+	char pad[Completion::kInlineSize + 1];
+	int *sum;
+
+	void operator () (int ret, const uint8_t*) const { *sum += ret; }
+};
+
+void Count(void *ctx)
+{
+	(*static_cast<int*>(ctx))++;
+}
+
+int CheckInline(void)
+{
+	int errors = 0;
+	int sum = 0;
+	auto shared = std::make_shared<int>(0);
+	size_t before = allocs;
+
+	//as the scanner and batch reads, pointers and a shared_ptr
+	Completion c = [&sum, shared](int ret, const uint8_t*) { sum += ret + *shared; };
+	Completion copy = c;
+	Completion moved = std::move(c);
+	copy(1, nullptr);
+	moved(2, nullptr);
+	c = moved;
+	c(4, nullptr);
+	if (allocs != before || sum != 7 || shared.use_count() != 4) {
+		printf("%-8s %zu allocs, sum %d, %ld owners\n", "inline",
+			allocs - before, sum, shared.use_count());
+		errors++;
+	}
+
+	c = nullptr;
+	copy = nullptr;
+	moved = Completion();
+	if (c || copy || moved || shared.use_count() != 1) {
+		printf("%-8s not empty after reset\n", "inline");
+		errors++;
+	}
+
+	printf("%-8s %s\n", "inline", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckAllocated(void)
+{
+	int errors = 0;
+	int sum = 0;
+	Large large;
+	large.sum = &sum;
+	size_t before = allocs;
+
+	{
+		Completion c = large;
+		Completion copy = c;
+		Completion moved = std::move(c);
+		copy(1, nullptr);
+		moved(2, nullptr);
+	}
+	if (allocs != before + 2 || sum != 3) {
+		printf("%-8s %zu allocs, sum %d\n", "alloc", allocs - before, sum);
+		errors++;
+	}
+
+	printf("%-8s %s\n", "alloc", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckThen(void)
+{
+	int errors = 0;
+	int sum = 0;
+	int hooks = 0;
+
+	Completion c = [&sum, &hooks](int ret, const uint8_t*) {
+		if (hooks == 0)
+			sum += ret;
+	};
+	Wrapper::Then(c, &Count, &hooks);
+	Completion moved = std::move(c);
+	moved(1, nullptr);
+	if (sum != 1 || hooks != 1) {
+		printf("%-8s hook is not called after the callable\n", "then");
+		errors++;
+	}
+
+	Completion none;
+	Wrapper::Then(none, &Count, &hooks);
+	if (!none) {
+		printf("%-8s hook alone is empty\n", "then");
+		errors++;
+	}
+	none(0, nullptr);
+	if (hooks != 2) {
+		printf("%-8s hook alone is not called\n", "then");
+		errors++;
+	}
+
+	printf("%-8s %s\n", "then", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+void *operator new(size_t size)
+{
+	allocs++;
+	if (void *p = malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+int main()
+{
+	int errors = 0;
+
+	errors += CheckInline();
+	errors += CheckAllocated();
+	errors += CheckThen();
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Every kernel of Crc16 against the bytewise crc of the tables.
+//All of messages of 1 and 2 bytes, and random messages of every length
+//up to kMaxLen at each alignment up to 16 bytes.
+//Crc16Context of messages arriving in random pieces.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbcrc.cpp ../ymod/ymbcrc.cpp
+#include "ymod/ymbcrc.h"
+
+#include <vector>
+#include <random>
+#include <cstdio>
+
+using namespace YModbus;
+
+namespace {
+
+const size_t kMaxLen = 4096;
+const size_t kAligns = 16;
+
+const eCrcKernel kKernels[] = { CRC_AUTO, CRC_BYTE, CRC_SLICE8, CRC_SLICE16, CRC_CLMUL };
+const char *kNames[] = { "auto", "byte", "slice8", "slice16", "clmul" };
+
+//The original crc, a bit per step of the polynomial 0xA001(reflected)
+uint16_t Reference(const uint8_t *msg, size_t len)
+{
+	uint16_t crc = 0xFFFF;
+
+	while (len--) {
+		crc ^= *(msg++);
+		for (int i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+
+	return crc;
+}
+
+int Check(int k, const uint8_t *msg, size_t len, size_t align)
+{
+	uint16_t expect = Reference(msg, len);
+	uint16_t crc = Crc16(msg, len, kKernels[k]);
+
+	if (crc == expect)
+		return 0;
+
+	printf("%-8s len %zu align %zu: %04x, expected %04x\n",
+		kNames[k], len, align, crc, expect);
+	return 1;
+}
+
+//msg is added in pieces of up to maxpiece bytes
+int CheckContext(const uint8_t *msg, size_t len, size_t maxpiece, std::mt19937 &rng)
+{
+	Crc16Context ctx;
+	uint16_t crc = ctx.Update(msg, 0);
+	size_t arrived = 0;
+
+	while (arrived < len) {
+		arrived += 1 + rng() % maxpiece;
+		if (arrived > len)
+			arrived = len;
+		crc = ctx.Update(msg, arrived);
+	}
+
+	uint16_t expect = Reference(msg, len);
+	if (crc != expect || ctx.Length() != len) {
+		printf("context  len %zu piece %zu: %04x, expected %04x\n",
+			len, maxpiece, crc, expect);
+		return 1;
+	}
+
+	//shorter, as a buffer refilled
+	if (len > 0 && ctx.Update(msg, len - 1) != Reference(msg, len - 1)) {
+		printf("context  len %zu: not started over\n", len);
+		return 1;
+	}
+
+	return 0;
+}
+
+} //namespace {
+
+int main()
+{
+	const uint8_t check[] = "123456789";
+	int errors = 0;
+
+	if (Reference(check, 9) != 0x4B37) {
+		printf("reference: %04x, expected 4b37\n", Reference(check, 9));
+		return 1;
+	}
+
+	std::vector<uint8_t> buf(kMaxLen + kAligns);
+	std::mt19937 rng(20190504);
+	for (auto &b : buf)
+		b = static_cast<uint8_t>(rng());
+
+	for (int k = 0; k < static_cast<int>(sizeof(kKernels) / sizeof(kKernels[0])); k++) {
+		if (!Crc16Supported(kKernels[k])) {
+			printf("%-8s not supported, as auto\n", kNames[k]);
+		}
+
+		int before = errors;
+		uint8_t msg[2];
+		for (int v = 0; v < 0x100; v++) {
+			msg[0] = static_cast<uint8_t>(v);
+			errors += Check(k, msg, 1, 0);
+		}
+		for (int v = 0; v < 0x10000; v++) {
+			msg[0] = static_cast<uint8_t>(v);
+			msg[1] = static_cast<uint8_t>(v >> 8);
+			errors += Check(k, msg, 2, 0);
+		}
+
+		for (size_t align = 0; align < kAligns; align++) {
+			for (size_t len = 0; len <= kMaxLen; len++)
+				errors += Check(k, buf.data() + align, len, align);
+		}
+
+		printf("%-8s %s\n", kNames[k], errors == before ? "ok" : "FAILED");
+	}
+
+	int before = errors;
+	for (size_t maxpiece : { 1, 3, 16, 100 }) {
+		for (size_t len = 0; len <= kMaxLen; len++)
+			errors += CheckContext(buf.data(), len, maxpiece, rng);
+	}
+	printf("%-8s %s\n", "context", errors == before ? "ok" : "FAILED");
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//HexEncode and HexDecode against a character per step reference.
+//Random data of every length up to kMaxLen at each alignment, each of
+//256 characters at each position of a block and of the tail, in place
+//as ascii msgs use them, and ascii msgs with a bad character.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbhex.cpp ../ymod/ymbhex.cpp ../ymod/ymbprot.cpp ../ymod/ymbcrc.cpp
+#include "ymod/ymbhex.h"
+#include "ymod/ymbascii.h"
+
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+using namespace YModbus;
+
+namespace {
+
+struct NullInterface {};
+typedef Ascii<NullInterface> TestAscii;
+
+const size_t kMaxLen = 300;
+const size_t kAligns = 16;
+
+//-1: not a hex character
+int Nibble(uint8_t c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 0xA;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 0xA;
+	return -1;
+}
+
+int CheckEncode(const uint8_t *data, size_t len)
+{
+	static const char kDigits[] = "0123456789ABCDEF";
+	uint8_t hex[kMaxLen * 2];
+	uint8_t sum = 0;
+
+	uint8_t ret = HexEncode(data, len, hex);
+	for (size_t i = 0; i < len; i++) {
+		sum = static_cast<uint8_t>(sum + data[i]);
+		if (hex[i * 2] != kDigits[data[i] >> 4] || hex[i * 2 + 1] != kDigits[data[i] & 0xF]) {
+			printf("encode   len %zu: byte %zu is %.2s\n", len, i, hex + i * 2);
+			return 1;
+		}
+	}
+
+	if (ret != sum) {
+		printf("encode   len %zu: sum %02x, expected %02x\n", len, ret, sum);
+		return 1;
+	}
+
+	return 0;
+}
+
+int CheckDecode(const uint8_t *hex, size_t len)
+{
+	uint8_t data[kMaxLen];
+	uint8_t sum = 0, ret;
+	int expect = EOK;
+
+	int err = HexDecode(hex, len, data, ret);
+	for (size_t i = 0; i < len; i++) {
+		int hi = Nibble(hex[i * 2]);
+		int lo = Nibble(hex[i * 2 + 1]);
+
+		if (hi < 0 || lo < 0) {
+			expect = -EBADMSG;
+			continue;
+		}
+
+		sum = static_cast<uint8_t>(sum + (hi << 4 | lo));
+		if (data[i] != (hi << 4 | lo)) {
+			printf("decode   len %zu: byte %zu of %.2s is %02x\n", len, i, hex + i * 2, data[i]);
+			return 1;
+		}
+	}
+
+	if (err != expect || (err == EOK && ret != sum)) {
+		printf("decode   len %zu: %d sum %02x, expected %d sum %02x\n",
+			len, err, ret, expect, sum);
+		return 1;
+	}
+
+	return 0;
+}
+
+} //namespace {
+
+int main()
+{
+	std::mt19937 rng(20190504);
+	std::vector<uint8_t> data(kMaxLen + kAligns);
+	std::vector<uint8_t> hex(kMaxLen * 2 + kAligns);
+	int errors = 0;
+
+	for (auto &d : data)
+		d = static_cast<uint8_t>(rng());
+
+	//random data, upper and lower case
+	for (size_t align = 0; align < kAligns; align++) {
+		for (size_t len = 0; len <= kMaxLen; len++) {
+			errors += CheckEncode(data.data() + align, len);
+
+			HexEncode(data.data(), len, hex.data() + align);
+			errors += CheckDecode(hex.data() + align, len);
+
+			for (size_t i = 0; i < len * 2; i++) {
+				if (rng() % 2 != 0 && hex[align + i] >= 'A')
+					hex[align + i] = static_cast<uint8_t>(hex[align + i] | 0x20);
+			}
+			errors += CheckDecode(hex.data() + align, len);
+		}
+	}
+	printf("%-8s %s\n", "random", errors == 0 ? "ok" : "FAILED");
+
+	//every character at every position of a block and the tail
+	int before = errors;
+	for (size_t len : { 1, 16, 17, 33 }) {
+		HexEncode(data.data(), len, hex.data());
+		for (size_t pos = 0; pos < len * 2; pos++) {
+			uint8_t save = hex[pos];
+			for (int c = 0; c < 256; c++) {
+				hex[pos] = static_cast<uint8_t>(c);
+				errors += CheckDecode(hex.data(), len);
+			}
+			hex[pos] = save;
+		}
+	}
+	printf("%-8s %s\n", "chars", errors == before ? "ok" : "FAILED");
+
+	//in place, as ascii msgs
+	before = errors;
+	for (size_t len = 0; len <= 254; len++) {
+		uint8_t buf[kMaxLen * 3];
+		uint8_t sum;
+
+		memcpy(buf + 258, data.data(), len);
+		HexEncode(buf + 258, len, buf + 1);
+		if (HexDecode(buf + 1, len, buf, sum) != EOK || memcmp(buf, data.data(), len) != 0) {
+			printf("in place len %zu: not decoded back\n", len);
+			errors++;
+		}
+	}
+
+	//ascii msg with a bad character
+	TestAscii prot;
+	for (uint16_t rnum = 1; rnum <= 125; rnum++) {
+		uint8_t buf[kMaxLen * 2];
+		MsgInf inf;
+		inf.id = 1;
+		inf.fun = kFunReadHoldingRegisters;
+		inf.rnum = rnum;
+		inf.err = 0;
+		inf.datalen = static_cast<uint8_t>(rnum * 2);
+		inf.databuf = data.data();
+
+		size_t msglen = prot.MakeSlaveMsg(buf, sizeof(buf), inf);
+		uint8_t saved[kMaxLen * 2];
+		memcpy(saved, buf, msglen);
+
+		MsgInf out;
+		out.rnum = rnum;
+		if (prot.VerifySlaveMsg(buf, msglen) != EOK
+			|| prot.ParseSlaveMsg(buf, msglen, out) != EOK
+			|| memcmp(out.databuf, data.data(), inf.datalen) != 0) {
+			printf("ascii    rnum %u: not parsed back\n", rnum);
+			errors++;
+		}
+
+		memcpy(buf, saved, msglen);
+		buf[1 + rng() % (msglen - 3)] = 'G';
+		if (prot.ParseSlaveMsg(buf, msglen, out) != -EBADMSG) {
+			printf("ascii    rnum %u: bad character is parsed\n", rnum);
+			errors++;
+		}
+	}
+	printf("%-8s %s\n", "ascii", errors == before ? "ok" : "FAILED");
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//QueryList merges of adjacent, overlapping and gapped querys, the limits
+//of a read and of the parts, and Split of a failed merged read.
+//Querys identical to a pending part are absorbed until it is sent.
+//ForEachQueryPart of registers and of coils against the merged response.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbquery.cpp
+#include "ymod/master/ymbquery.h"
+
+#include <vector>
+#include <cstdio>
+
+using namespace YModbus;
+
+namespace {
+
+struct Range
+{
+	uint8_t id;
+	uint8_t fun;
+	uint16_t reg;
+	uint16_t num;
+	uint8_t nparts;
+};
+
+//Pop all of querys, as the merged reads expected
+int Expect(const char *name, QueryList &list, const std::vector<Range> &reads)
+{
+	int errors = 0;
+	size_t i = 0;
+
+	for (; !list.Empty(); i++, list.Pop()) {
+		const Query &q = list.Front();
+		if (i >= reads.size()) {
+			printf("%-8s read %zu: %u.%u %u+%u not expected\n", name, i,
+				q.inf.id, q.inf.fun, q.inf.rreg, q.inf.rnum);
+			errors++;
+			continue;
+		}
+
+		const Range &r = reads[i];
+		if (q.inf.id != r.id || q.inf.fun != r.fun || q.inf.rreg != r.reg
+			|| q.inf.rnum != r.num || q.nparts != r.nparts) {
+			printf("%-8s read %zu: %u.%u %u+%u parts %u, expected %u.%u %u+%u parts %u\n",
+				name, i, q.inf.id, q.inf.fun, q.inf.rreg, q.inf.rnum, q.nparts,
+				r.id, r.fun, r.reg, r.num, r.nparts);
+			errors++;
+		}
+	}
+
+	if (i < reads.size()) {
+		printf("%-8s %zu reads, expected %zu\n", name, i, reads.size());
+		errors++;
+	}
+
+	return errors;
+}
+
+int CheckMerge(void)
+{
+	int errors = 0;
+	QueryList list;
+
+	//adjacent and overlapping, not other slave or function, no gap
+	list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	list.Add({ 1, kFunReadHoldingRegisters, 10, 5 });
+	list.Add({ 1, kFunReadHoldingRegisters, 12, 8 });
+	list.Add({ 1, kFunReadHoldingRegisters, 21, 4 });
+	list.Add({ 2, kFunReadHoldingRegisters, 0, 10 });
+	list.Add({ 1, kFunReadInputRegisters, 0, 10 });
+	errors += Expect("adjacent", list, {
+		{ 1, kFunReadHoldingRegisters, 0, 20, 3 },
+		{ 1, kFunReadHoldingRegisters, 21, 4, 1 },
+		{ 2, kFunReadHoldingRegisters, 0, 10, 1 },
+		{ 1, kFunReadInputRegisters, 0, 10, 1 },
+	});
+
+	//gap, before and after the merged read
+	list.SetGap(5);
+	list.Add({ 1, kFunReadHoldingRegisters, 20, 10 });
+	list.Add({ 1, kFunReadHoldingRegisters, 35, 5 });
+	list.Add({ 1, kFunReadHoldingRegisters, 10, 5 });
+	list.Add({ 1, kFunReadHoldingRegisters, 0, 4 });
+	errors += Expect("gap", list, {
+		{ 1, kFunReadHoldingRegisters, 10, 30, 3 },
+		{ 1, kFunReadHoldingRegisters, 0, 4, 1 },
+	});
+	list.SetGap(0);
+
+	//not greater than a read
+	list.Add({ 1, kFunReadHoldingRegisters, 0, 100 });
+	list.Add({ 1, kFunReadHoldingRegisters, 100, 26 });
+	list.Add({ 1, kFunReadHoldingRegisters, 100, 25 });
+	list.Add({ 1, kFunReadCoils, 0, 1000 });
+	list.Add({ 1, kFunReadCoils, 1000, 1000 });
+	list.Add({ 1, kFunReadCoils, 2000, 1 });
+	errors += Expect("limit", list, {
+		{ 1, kFunReadHoldingRegisters, 0, 125, 2 },
+		{ 1, kFunReadHoldingRegisters, 100, 26, 1 },
+		{ 1, kFunReadCoils, 0, 2000, 2 },
+		{ 1, kFunReadCoils, 2000, 1, 1 },
+	});
+
+	//not more than kMaxQueryParts
+	for (uint16_t reg = 0; reg <= kMaxQueryParts; reg++)
+		list.Add({ 1, kFunReadHoldingRegisters, reg, 1 });
+	errors += Expect("parts", list, {
+		{ 1, kFunReadHoldingRegisters, 0, kMaxQueryParts, kMaxQueryParts },
+		{ 1, kFunReadHoldingRegisters, kMaxQueryParts, 1, 1 },
+	});
+
+	//split in order before the others, never merged again
+	list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	list.Add({ 1, kFunReadHoldingRegisters, 10, 5 });
+	list.Add({ 2, kFunReadHoldingRegisters, 0, 10 });
+	Query merged = list.Front();
+	list.Pop();
+	list.Split(merged);
+	list.Add({ 1, kFunReadHoldingRegisters, 15, 5 });
+	bool split = list.Front().split;
+	errors += Expect("split", list, {
+		{ 1, kFunReadHoldingRegisters, 0, 10, 1 },
+		{ 1, kFunReadHoldingRegisters, 10, 5, 1 },
+		{ 2, kFunReadHoldingRegisters, 0, 10, 1 },
+		{ 1, kFunReadHoldingRegisters, 15, 5, 1 },
+	});
+	if (!split) {
+		printf("%-8s query is not marked split\n", "split");
+		errors++;
+	}
+
+	printf("%-8s %s\n", "merge", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckAbsorb(void)
+{
+	int errors = 0;
+	QueryList list;
+
+	bool added = list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	added = list.Add({ 1, kFunReadHoldingRegisters, 10, 5 }) && added;
+	added = list.Add({ 2, kFunReadHoldingRegisters, 10, 5 }) && added;
+	added = list.Add({ 1, kFunReadInputRegisters, 10, 5 }) && added;
+	added = list.Add({ 1, kFunReadHoldingRegisters, 10, 4 }) && added;
+	if (!added) {
+		printf("%-8s query not identical is absorbed\n", "absorb");
+		errors++;
+	}
+
+	//identical to a merged part, and to the merged read which isn't a part
+	bool absorbed = !list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	absorbed = !list.Add({ 1, kFunReadHoldingRegisters, 10, 5 }) && absorbed;
+	added = list.Add({ 1, kFunReadHoldingRegisters, 0, 15 });
+	if (!absorbed || !added || list.GetAbsorbed() != 2) {
+		printf("%-8s absorbed %u, expected 2\n", "absorb",
+			static_cast<unsigned>(list.GetAbsorbed()));
+		errors++;
+	}
+	errors += Expect("absorb", list, {
+		{ 1, kFunReadHoldingRegisters, 0, 15, 4 },
+		{ 2, kFunReadHoldingRegisters, 10, 5, 1 },
+		{ 1, kFunReadInputRegisters, 10, 5, 1 },
+	});
+
+	//sent, then queried again; split querys are still pending
+	list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	list.Add({ 1, kFunReadHoldingRegisters, 10, 5 });
+	Query merged = list.Front();
+	list.Pop();
+	added = list.Add({ 1, kFunReadHoldingRegisters, 0, 10 });
+	list.Pop();
+	list.Split(merged);
+	absorbed = !list.Add({ 1, kFunReadHoldingRegisters, 10, 5 });
+	if (!added || !absorbed || list.GetAbsorbed() != 3) {
+		printf("%-8s sent or split querys: added %d absorbed %d\n",
+			"absorb", added, absorbed);
+		errors++;
+	}
+	errors += Expect("absorb", list, {
+		{ 1, kFunReadHoldingRegisters, 0, 10, 1 },
+		{ 1, kFunReadHoldingRegisters, 10, 5, 1 },
+	});
+
+	printf("%-8s %s\n", "absorb", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckRegisterParts(void)
+{
+	int errors = 0;
+	QueryList list;
+
+	list.SetGap(5);
+	list.Add({ 1, kFunReadHoldingRegisters, 10, 4 });
+	list.Add({ 1, kFunReadHoldingRegisters, 17, 3 });
+	list.Add({ 1, kFunReadHoldingRegisters, 12, 6 });
+	const Query &q = list.Front();
+
+	uint8_t data[40];
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = static_cast<uint8_t>(i);
+
+	MsgInf rsp(1, kFunReadHoldingRegisters, q.inf.rreg, q.inf.rnum);
+	rsp.databuf = data;
+	rsp.datalen = static_cast<uint8_t>(q.inf.rnum * 2);
+
+	const uint16_t regs[] = { 10, 17, 12 };
+	const uint16_t nums[] = { 4, 3, 6 };
+	size_t n = 0;
+	ForEachQueryPart(q, rsp, [&](const MsgInf &part) {
+		if (n >= 3 || part.rreg != regs[n] || part.rnum != nums[n]
+			|| part.datalen != nums[n] * 2
+			|| memcmp(part.databuf, data + (regs[n] - 10) * 2, part.datalen) != 0) {
+			printf("%-8s part %zu: %u+%u is not the datas of the read\n",
+				"regs", n, part.rreg, part.rnum);
+			errors++;
+		}
+		n++;
+	});
+	if (n != 3) {
+		printf("%-8s %zu parts, expected 3\n", "regs", n);
+		errors++;
+	}
+
+	//response shorter than the read, nothing is stored
+	n = 0;
+	rsp.datalen = static_cast<uint8_t>(q.inf.rnum * 2 - 2);
+	ForEachQueryPart(q, rsp, [&](const MsgInf &) { n++; });
+	if (n != 0) {
+		printf("%-8s short response is stored\n", "regs");
+		errors++;
+	}
+
+	printf("%-8s %s\n", "regs", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckBitParts(void)
+{
+	int errors = 0;
+	QueryList list;
+
+	list.SetGap(8);
+	list.Add({ 1, kFunReadCoils, 3, 5 });
+	list.Add({ 1, kFunReadCoils, 10, 11 });
+	list.Add({ 1, kFunReadCoils, 29, 16 });
+	const Query &q = list.Front();
+
+	//coil i of the read is on if i % 3 == 0
+	uint8_t data[8] = { 0 };
+	for (uint16_t i = 0; i < q.inf.rnum; i++) {
+		if (i % 3 == 0)
+			data[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+	}
+
+	MsgInf rsp(1, kFunReadCoils, q.inf.rreg, q.inf.rnum);
+	rsp.databuf = data;
+	rsp.datalen = static_cast<uint8_t>((q.inf.rnum + 7) / 8);
+
+	size_t n = 0;
+	ForEachQueryPart(q, rsp, [&](const MsgInf &part) {
+		if (part.datalen != (part.rnum + 7) / 8) {
+			printf("%-8s part %zu: %u bytes of %u coils\n",
+				"bits", n, part.datalen, part.rnum);
+			errors++;
+		}
+
+		for (uint16_t b = 0; b < part.datalen * 8; b++) {
+			bool on = (part.databuf[b / 8] >> (b % 8)) & 0x1;
+			bool expect = b < part.rnum && (part.rreg + b - q.inf.rreg) % 3 == 0;
+			if (on != expect) {
+				printf("%-8s part %zu: coil %u is %d\n", "bits", n, part.rreg + b, on);
+				errors++;
+				break;
+			}
+		}
+		n++;
+	});
+	if (n != 3 || q.inf.rreg != 3 || q.inf.rnum != 42) {
+		printf("%-8s %zu parts of %u+%u, expected 3 of 3+42\n",
+			"bits", n, q.inf.rreg, q.inf.rnum);
+		errors++;
+	}
+
+	printf("%-8s %s\n", "bits", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+int main()
+{
+	int errors = 0;
+
+	errors += CheckMerge();
+	errors += CheckAbsorb();
+	errors += CheckRegisterParts();
+	errors += CheckBitParts();
+
+	return errors == 0 ? 0 : 1;
+}
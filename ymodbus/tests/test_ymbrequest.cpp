@@ -0,0 +1,303 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//CoalesceWrites of the pending single writes contiguous to the one popped,
+//up to any other request to the slave or a second write of an address,
+//and the values of registers and of coils in the merged write.
+//SplitWrites of the result to each write, and of an exception by
+//executing the writes again one by one.
+//RequestPool taken and put back by some threads, a request is never
+//held by two of them, and no more than maxnum are created.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbrequest.cpp
+#include "ymod/master/ymbrequest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+
+using namespace YModbus;
+
+namespace {
+
+uint8_t values[kMaxRequestNum][2];
+size_t nvalues = 0;
+
+Request *Write(RequestQueue &queue, RequestPool &pool,
+	uint8_t sid, uint8_t fun, uint16_t reg, uint16_t value)
+{
+	MsgInf inf(sid, fun, 0, 0, reg, 1);
+	uint8_t *data = values[nvalues++ % kMaxRequestNum];
+
+	data[0] = static_cast<uint8_t>(value >> 8);
+	data[1] = static_cast<uint8_t>(value);
+	inf.databuf = data;
+	inf.datalen = 2;
+
+	Request *req = pool.Get(inf, nullptr);
+	queue.Push(req);
+	return req;
+}
+
+Request *Read(RequestQueue &queue, RequestPool &pool, uint8_t sid, uint16_t reg)
+{
+	Request *req = pool.Get({ sid, kFunReadHoldingRegisters, reg, 1 }, nullptr);
+	queue.Push(req);
+	return req;
+}
+
+//Pop the next one and merge it
+Request *Coalesce(RequestQueue &queue, RequestPool &pool)
+{
+	Request *req = nullptr;
+
+	if (!queue.Pop(PRIO_NORMAL, req))
+		return nullptr;
+	return CoalesceWrites(queue, pool, req);
+}
+
+//The group of carrier, as expected
+int Expect(const char *name, const Request *carrier, const std::vector<Request*> &group)
+{
+	std::vector<Request*> writes;
+
+	for (Request *r = carrier != nullptr ? carrier->group : nullptr; r != nullptr; r = r->next)
+		writes.push_back(r);
+
+	if (writes != group) {
+		printf("%-8s %zu writes merged, expected %zu\n", name, writes.size(), group.size());
+		return 1;
+	}
+
+	return 0;
+}
+
+//Pop the rest, as expected
+int Rest(const char *name, RequestQueue &queue, const std::vector<Request*> &rest)
+{
+	std::vector<Request*> reqs;
+	Request *req;
+
+	while (queue.Pop(PRIO_NORMAL, req))
+		reqs.push_back(req);
+
+	if (reqs != rest) {
+		printf("%-8s %zu requests left, expected %zu\n", name, reqs.size(), rest.size());
+		return 1;
+	}
+
+	return 0;
+}
+
+int CheckCoalesce(void)
+{
+	int errors = 0;
+	RequestQueue queue;
+	RequestPool pool;
+	const uint8_t reg = kFunWriteSingleRegister;
+
+	//other slaves are passed, a read of the slave is not
+	Request *w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	Request *w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	Request *o7 = Write(queue, pool, 2, reg, 7, 0x0707);
+	Request *w4 = Write(queue, pool, 1, reg, 4, 0x0404);
+	Request *r5 = Read(queue, pool, 1, 5);
+	Request *w7 = Write(queue, pool, 1, reg, 7, 0x0707);
+	Request *carrier = Coalesce(queue, pool);
+	errors += Expect("barrier", carrier, { w4, w5, w6 });
+	errors += Rest("barrier", queue, { o7, r5, w7 });
+
+	const uint8_t data[] = { 0x04, 0x04, 0x05, 0x05, 0x06, 0x06 };
+	if (carrier == nullptr || carrier->ask.fun != kFunWriteMultiRegisters
+		|| carrier->ask.wreg != 4 || carrier->ask.wnum != 3
+		|| carrier->ask.datalen != sizeof(data)
+		|| memcmp(carrier->ask.databuf, data, sizeof(data)) != 0) {
+		printf("%-8s merged write is not 4+3 of the values\n", "barrier");
+		errors++;
+	}
+
+	//second write of an address, and a multiple write of the slave
+	w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	Request *w5b = Write(queue, pool, 1, reg, 5, 0x5050);
+	w7 = Write(queue, pool, 1, reg, 7, 0x0707);
+	errors += Expect("again", Coalesce(queue, pool), { w5, w6 });
+	Request *req = Coalesce(queue, pool);
+	if (req != w5b || req->group != nullptr) {
+		printf("%-8s second write of 5 is merged\n", "again");
+		errors++;
+	}
+	errors += Rest("again", queue, { w7 });
+
+	Request *m7 = pool.Get({ 1, kFunWriteMultiRegisters, 0, 0, 7, 1 }, nullptr);
+	m7->ask.databuf = values[0];
+	m7->ask.datalen = 2;
+	w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	queue.Push(m7);
+	w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	req = Coalesce(queue, pool);
+	if (req != w5 || req->group != nullptr) {
+		printf("%-8s merged beyond a multiple write\n", "again");
+		errors++;
+	}
+	errors += Rest("again", queue, { m7, w6 });
+
+	//coils, 0xff00 is on
+	const uint8_t coil = kFunWriteSingleCoil;
+	Request *c0 = Write(queue, pool, 1, coil, 0, 0xff00);
+	Request *c1 = Write(queue, pool, 1, coil, 1, 0x0000);
+	Request *c2 = Write(queue, pool, 1, coil, 2, 0xff00);
+	carrier = Coalesce(queue, pool);
+	errors += Expect("coils", carrier, { c0, c1, c2 });
+	if (carrier == nullptr || carrier->ask.fun != kFunWriteMultiCoils
+		|| carrier->ask.wnum != 3 || carrier->ask.datalen != 1
+		|| carrier->ask.databuf[0] != 0x05) {
+		printf("%-8s merged write is not 0+3 of 101\n", "coils");
+		errors++;
+	}
+
+	printf("%-8s %s\n", "coalesce", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckSplit(void)
+{
+	int errors = 0;
+	RequestQueue queue;
+	RequestPool pool;
+	const uint8_t reg = kFunWriteSingleRegister;
+	std::vector<Request*> done;
+	auto complete = [&done](Request *r) { done.push_back(r); };
+
+	//answered, each write is completed
+	Request *w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	Request *w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	Request *carrier = Coalesce(queue, pool);
+	carrier->err = 0;
+	SplitWrites(queue, *carrier, -EBADF, complete);
+	if (done != std::vector<Request*>{ w5, w6 } || w5->err != EOK || w6->err != EOK
+		|| GetRequestResult(*w5, -EBADF) != EOK || !queue.Empty()) {
+		printf("%-8s answered writes are not completed ok\n", "split");
+		errors++;
+	}
+
+	//failed, each write fails
+	done.clear();
+	w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	carrier = Coalesce(queue, pool);
+	carrier->err = -ETIMEDOUT;
+	SplitWrites(queue, *carrier, -EBADF, complete);
+	if (done != std::vector<Request*>{ w5, w6 } || w5->err != -ETIMEDOUT
+		|| w6->err != -ETIMEDOUT || !queue.Empty()) {
+		printf("%-8s failed writes are not completed with its error\n", "split");
+		errors++;
+	}
+
+	//exception, executed again one by one before the others
+	done.clear();
+	w5 = Write(queue, pool, 1, reg, 5, 0x0505);
+	w6 = Write(queue, pool, 1, reg, 6, 0x0606);
+	Request *w7 = Write(queue, pool, 2, reg, 7, 0x0707);
+	carrier = Coalesce(queue, pool);
+	carrier->err = 0;
+	carrier->inf.err = 0x02;
+	SplitWrites(queue, *carrier, -EBADF, complete);
+	if (!done.empty() || carrier->group != nullptr) {
+		printf("%-8s refused writes are completed\n", "split");
+		errors++;
+	}
+
+	Request *req = Coalesce(queue, pool);
+	if (req != w5 || req->group != nullptr || !w5->split || w5->inf.wreg != 5) {
+		printf("%-8s refused writes are merged again\n", "split");
+		errors++;
+	}
+	errors += Rest("split", queue, { w6, w7 });
+
+	printf("%-8s %s\n", "split", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+int CheckPool(void)
+{
+	const size_t kThreads = 8;
+	const size_t kLoops = 200000;
+	const size_t kMaxNum = 16;
+
+	RequestPool pool(kMaxNum);
+	std::atomic<uint32_t> holders[kMaxNum];
+	std::atomic<size_t> twice(0), bad(0), full(0);
+
+	for (auto &h : holders)
+		h = 0;
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < kThreads; t++) {
+		threads.emplace_back([&] {
+			Request *held[3];
+			for (size_t i = 0; i < kLoops; i++) {
+				size_t n = 0;
+				for (; n < 1 + i % 3; n++) { //more than one at a time
+					held[n] = pool.Get({ 1, kFunReadHoldingRegisters, 0, 1 }, nullptr);
+					if (held[n] == nullptr) {
+						full++;
+						break;
+					}
+					if (held[n]->index >= kMaxNum) {
+						bad++;
+						break;
+					}
+					if (holders[held[n]->index]++ != 0)
+						twice++;
+				}
+				while (n-- > 0) {
+					holders[held[n]->index]--;
+					pool.Put(held[n]);
+				}
+			}
+		});
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	int errors = 0;
+	if (twice != 0 || bad != 0) {
+		printf("%-8s %zu taken twice, %zu beyond maxnum\n", "pool",
+			twice.load(), bad.load());
+		errors++;
+	}
+
+	//all of them are free again, and no more
+	std::vector<Request*> reqs;
+	while (Request *req = pool.Get({ 1, kFunReadHoldingRegisters, 0, 1 }, nullptr))
+		reqs.push_back(req);
+	if (reqs.size() != kMaxNum) {
+		printf("%-8s %zu requests, expected %zu\n", "pool", reqs.size(), kMaxNum);
+		errors++;
+	}
+	for (auto req : reqs)
+		pool.Put(req);
+
+	printf("%-8s %s\n", "pool", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+int main()
+{
+	int errors = 0;
+
+	errors += CheckCoalesce();
+	errors += CheckSplit();
+	errors += CheckPool();
+
+	return errors == 0 ? 0 : 1;
+}
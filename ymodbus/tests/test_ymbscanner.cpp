@@ -0,0 +1,354 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//Scanner over a master in memory, reads are completed in the call or
+//after a delay, and the call may block as a master too busy.
+//Cycles of each period, errors of failed reads, phase of the cycles of
+//a group added later, cycles skipped when the scanner is behind a whole
+//period or the previous cycle is running(overrun), late cycles against
+//the tolerance, and the destructor waiting for the reads outstanding.
+//Periods are some tens of ms, counts are checked within a margin.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbscanner.cpp ../ymod/ymbtask.cpp ../ports/yevent.cpp -lpthread
+#include "ymod/master/ymbscanner.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+
+using namespace YModbus;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//Reads of each slave, as set by Set
+class FakeMaster
+{
+public:
+	FakeMaster() : outstanding_(0) {}
+
+	~FakeMaster()
+	{
+		for (auto &t : threads_)
+			t.join();
+	}
+
+	//block: ms, the call returns after it
+	//delay: ms, complete is called by another thread after it, 0: in the call
+	//ret: result of read, < 0 of the call if submit is set
+	void Set(uint8_t sid, long block, long delay, int ret, bool submit = false)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		slaves_[sid] = { block, delay, ret, submit };
+	}
+
+	int ReadCoilsAsync(uint8_t sid, uint16_t, uint16_t, Completion complete)
+	{
+		return Read(sid, std::move(complete));
+	}
+
+	int ReadDiscreteInputsAsync(uint8_t sid, uint16_t, uint16_t, Completion complete)
+	{
+		return Read(sid, std::move(complete));
+	}
+
+	int ReadHoldingRegistersAsync(uint8_t sid, uint16_t, uint16_t, Completion complete)
+	{
+		return Read(sid, std::move(complete));
+	}
+
+	int ReadInputRegistersAsync(uint8_t sid, uint16_t, uint16_t, Completion complete)
+	{
+		return Read(sid, std::move(complete));
+	}
+
+	std::vector<Clock::time_point> Issued(uint8_t sid)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		return issued_[sid];
+	}
+
+	uint32_t Outstanding(void) const { return outstanding_; }
+
+private:
+	struct Slave
+	{
+		long block;
+		long delay;
+		int ret;
+		bool submit;
+	};
+
+	int Read(uint8_t sid, Completion complete)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		Slave s = slaves_[sid];
+		issued_[sid].push_back(Clock::now());
+		lock.unlock();
+
+		if (s.block > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(s.block));
+
+		if (s.submit)
+			return s.ret;
+
+		if (s.delay == 0) {
+			complete(s.ret, data_);
+			return EOK;
+		}
+
+		outstanding_++;
+		lock.lock();
+		threads_.emplace_back([this, s, complete] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(s.delay));
+			complete(s.ret, data_);
+			outstanding_--;
+		});
+
+		return EOK;
+	}
+
+	std::mutex mutex_;
+	Slave slaves_[256] = {};
+	std::vector<Clock::time_point> issued_[256];
+	std::vector<std::thread> threads_;
+	std::atomic<uint32_t> outstanding_;
+	uint8_t data_[2] = { 0 };
+};
+
+typedef Scanner<FakeMaster> TestScanner;
+
+const ScanItem kItem1 = { 1, kFunReadHoldingRegisters, 0, 1 };
+const ScanItem kItem2 = { 2, kFunReadCoils, 0, 1 };
+const ScanItem kItem3 = { 3, kFunReadInputRegisters, 0, 1 };
+
+void Sleep(long ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+long Ms(Clock::duration d)
+{
+	return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(d).count());
+}
+
+ScanStat Stat(TestScanner &scanner, int id)
+{
+	ScanStat stat;
+	scanner.GetStat(id, stat);
+	return stat;
+}
+
+int Expect(const char *name, bool ok, const ScanStat &stat)
+{
+	if (!ok) {
+		printf("%-8s %s: cycles %llu, errors %llu, late %llu, missed %llu, maxlag %ld, lastdur %ld\n",
+			"scanner", name, (unsigned long long)stat.cycles, (unsigned long long)stat.errors,
+			(unsigned long long)stat.late, (unsigned long long)stat.missed,
+			stat.maxlag, stat.lastdur);
+		return 1;
+	}
+
+	return 0;
+}
+
+//A cycle each period, errors of reads and of the calls
+int CheckCycles(void)
+{
+	int errors = 0;
+	FakeMaster master;
+	master.Set(1, 0, 0, 2);
+	master.Set(2, 0, 0, -EIO);
+	master.Set(3, 0, 0, -EBUSY, true);
+
+	{
+		TestScanner scanner(master);
+		scanner.SetTolerance(100);
+		int ok = scanner.AddGroup({ kItem1 }, 20);
+		int bad = scanner.AddGroup({ kItem1, kItem2 }, 20);
+		int full = scanner.AddGroup({ kItem3, kItem1 }, 20);
+		Sleep(310);
+
+		ScanStat stat = Stat(scanner, ok);
+		errors += Expect("cycles", stat.cycles >= 12 && stat.cycles <= 16
+			&& stat.errors == 0 && stat.missed == 0 && stat.late == 0, stat);
+		stat = Stat(scanner, bad);
+		errors += Expect("failed", stat.cycles >= 12 && stat.errors == stat.cycles, stat);
+		stat = Stat(scanner, full);
+		errors += Expect("refused", stat.cycles >= 12 && stat.errors == stat.cycles, stat);
+
+		ScanStat none;
+		scanner.RemoveGroup(bad);
+		if (scanner.GetStat(bad, none) || scanner.AddGroup({ kItem1 }, 0) != -EINVAL
+			|| scanner.AddGroup({ { 1, kFunWriteSingleRegister, 0, 1 } }, 20) != -EINVAL) {
+			printf("%-8s %s: removed or invalid groups\n", "scanner", "groups");
+			errors++;
+		}
+	}
+
+	printf("%-8s %s\n", "cycles", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//Group added later is issued at the phase of its cycles from the start
+int CheckPhase(void)
+{
+	int errors = 0;
+	FakeMaster master;
+	master.Set(1, 0, 0, 2);
+
+	auto start = Clock::now();
+	{
+		TestScanner scanner(master);
+		Sleep(70);
+		scanner.AddGroup({ kItem1 }, 100, 10);
+		Sleep(330);
+	}
+
+	auto issued = master.Issued(1);
+	for (size_t i = 0; i < issued.size(); i++) {
+		long at = Ms(issued[i] - start) - 110 - static_cast<long>(i) * 100;
+		if (at < -5 || at > 20) { //110 ms of the start, not 70 when added
+			printf("%-8s cycle %zu at %ld ms of its deadline\n", "phase", i, at);
+			errors++;
+		}
+	}
+	if (issued.size() != 3) {
+		printf("%-8s %zu cycles in 400 ms\n", "phase", issued.size());
+		errors++;
+	}
+
+	printf("%-8s %s\n", "phase", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//Behind a whole period, the cycles passed are skipped, not issued late
+int CheckBehind(void)
+{
+	int errors = 0;
+	FakeMaster master;
+	master.Set(1, 50, 0, 2); //the call takes 2.5 periods
+
+	{
+		TestScanner scanner(master);
+		scanner.SetTolerance(100);
+		int id = scanner.AddGroup({ kItem1 }, 20);
+		Sleep(420);
+
+		ScanStat stat = Stat(scanner, id);
+		errors += Expect("behind", stat.cycles >= 5 && stat.cycles <= 10
+			&& stat.missed >= stat.cycles && stat.late == 0 && stat.maxlag < 20, stat);
+	}
+
+	printf("%-8s %s\n", "behind", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//The previous cycle still running, this one is skipped
+int CheckOverrun(void)
+{
+	int errors = 0;
+	FakeMaster master;
+	master.Set(1, 0, 50, 2); //completed in 2.5 periods
+
+	{
+		TestScanner scanner(master);
+		scanner.SetTolerance(100);
+		int id = scanner.AddGroup({ kItem1 }, 20);
+		Sleep(420);
+
+		ScanStat stat = Stat(scanner, id);
+		errors += Expect("overrun", stat.cycles >= 5 && stat.cycles <= 10
+			&& stat.missed >= stat.cycles && stat.errors == 0
+			&& stat.lastdur >= 45 && stat.lastdur < 100, stat);
+	}
+
+	printf("%-8s %s\n", "overrun", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//Issued after the one due at the same time, late beyond the tolerance only
+int CheckLate(void)
+{
+	int errors = 0;
+
+	for (long tolerance : { 5, 50 }) {
+		FakeMaster master;
+		master.Set(1, 20, 0, 2); //the call takes 20ms
+		master.Set(2, 0, 0, 2);
+
+		TestScanner scanner(master);
+		scanner.SetTolerance(tolerance);
+		int first = scanner.AddGroup({ kItem1 }, 60);
+		int second = scanner.AddGroup({ kItem2 }, 60);
+		Sleep(400);
+
+		ScanStat stat = Stat(scanner, second);
+		bool late = tolerance < 20;
+		errors += Expect(late ? "late" : "tolerant", stat.cycles >= 5 && stat.missed == 0
+			&& stat.maxlag >= 18 && stat.maxlag < 60
+			&& stat.late == (late ? stat.cycles : 0), stat);
+
+		stat = Stat(scanner, first);
+		errors += Expect("first", stat.cycles >= 5 && stat.late == 0, stat);
+	}
+
+	printf("%-8s %s\n", "late", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+//Completions refer to the scanner, it's destroyed after the last one
+int CheckDestroy(void)
+{
+	int errors = 0;
+	FakeMaster master;
+	master.Set(1, 0, 150, 2);
+	master.Set(2, 0, 100, 2);
+
+	auto start = Clock::now();
+	{
+		TestScanner scanner(master);
+		scanner.AddGroup({ kItem1, kItem2 }, 20);
+		Sleep(30); //the first cycle issued
+	}
+	long waited = Ms(Clock::now() - start);
+
+	if (master.Issued(1).size() != 1 || master.Outstanding() != 0 || waited < 150) {
+		printf("%-8s %zu cycles, %u reads outstanding, destroyed in %ld ms\n", "destroy",
+			master.Issued(1).size(), master.Outstanding(), waited);
+		errors++;
+	}
+
+	printf("%-8s %s\n", "destroy", errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+int main()
+{
+	int errors = 0;
+
+	Task::LetUsGo();
+
+	errors += CheckCycles();
+	errors += CheckPhase();
+	errors += CheckBehind();
+	errors += CheckOverrun();
+	errors += CheckLate();
+	errors += CheckDestroy();
+
+	return errors == 0 ? 0 : 1;
+}
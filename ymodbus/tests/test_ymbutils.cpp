@@ -0,0 +1,106 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+//YNetToHostArray against YNetToHost on each value, of each byte order,
+//for values of 2, 4 and 8 bytes and every count up to kMaxCount at each
+//alignment, and YHostToNetArray back to the values of the net.
+//Values of the net bytes 01 02 03 04 in each byte order.
+//g++ -std=c++14 -O2 -I.. -I../include test_ymbutils.cpp
+#include "ymod/ymbutils.h"
+
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
+
+using namespace YModbus;
+
+namespace {
+
+const size_t kMaxCount = 70;
+const size_t kAligns = 8;
+
+const eByteOrder kOrders[] = { BOR_1234, BOR_3412, BOR_2143, BOR_4321 };
+const char *kNames[] = { "1234", "3412", "2143", "4321" };
+
+template<typename T>
+int Check(const char *type, const std::vector<uint8_t> &net)
+{
+	int errors = 0;
+	std::vector<uint8_t> buf((kMaxCount + 1) * sizeof(T) + kAligns);
+
+	for (int o = 0; o < static_cast<int>(sizeof(kOrders) / sizeof(kOrders[0])); o++) {
+		for (size_t align = 0; align < kAligns; align++) {
+			for (size_t count = 0; count <= kMaxCount; count++) {
+				size_t len = count * sizeof(T);
+				uint8_t *p = buf.data() + align;
+				memcpy(p, net.data(), len);
+
+				std::vector<T> expect(count);
+				memcpy(expect.data(), net.data(), len);
+				for (auto &v : expect)
+					YNetToHost(v, kOrders[o]);
+
+				//converted in place, not aligned as T
+				YNetToHostArray(reinterpret_cast<T*>(p), count, kOrders[o]);
+				if (memcmp(p, expect.data(), len) != 0) {
+					printf("%-8s %s count %zu align %zu: not as YNetToHost\n",
+						type, kNames[o], count, align);
+					errors++;
+				}
+
+				YHostToNetArray(reinterpret_cast<T*>(p), count, kOrders[o]);
+				if (memcmp(p, net.data(), len) != 0) {
+					printf("%-8s %s count %zu align %zu: not back to net\n",
+						type, kNames[o], count, align);
+					errors++;
+				}
+			}
+		}
+	}
+
+	printf("%-8s %s\n", type, errors == 0 ? "ok" : "FAILED");
+
+	return errors;
+}
+
+} //namespace {
+
+int main()
+{
+	int errors = 0;
+
+	if (IsLittleEndian()) {
+		const uint8_t net[] = { 0x01, 0x02, 0x03, 0x04 };
+		const uint32_t values[] = { 0x01020304, 0x03040102, 0x02010403, 0x04030201 };
+
+		for (int o = 0; o < static_cast<int>(sizeof(kOrders) / sizeof(kOrders[0])); o++) {
+			uint32_t val[4];
+			for (auto &v : val)
+				memcpy(&v, net, sizeof(v));
+
+			YNetToHostArray(val, 4, kOrders[o]);
+			if (val[0] != values[o] || val[3] != values[o]) {
+				printf("value    %s: %08x, expected %08x\n",
+					kNames[o], val[0], values[o]);
+				errors++;
+			}
+		}
+	}
+
+	std::vector<uint8_t> net((kMaxCount + 1) * sizeof(uint64_t));
+	std::mt19937 rng(20190504);
+	for (auto &b : net)
+		b = static_cast<uint8_t>(rng());
+
+	errors += Check<uint16_t>("uint16", net);
+	errors += Check<int16_t>("int16", net);
+	errors += Check<uint32_t>("uint32", net);
+	errors += Check<float>("float", net);
+	errors += Check<uint64_t>("uint64", net);
+	errors += Check<double>("double", net);
+
+	return errors == 0 ? 0 : 1;
+}
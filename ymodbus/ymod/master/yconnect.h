@@ -21,6 +21,14 @@ public:
 	virtual bool Send(uint8_t  *buf, size_t len) = 0;
 	virtual int Recv(uint8_t *buf, size_t len) = 0;
 
+	//For reactor, only net connects surpport them
+	//Descriptor to poll, -1 if not connected or not surpported
+	virtual int Handle(void) const { return -1; }
+	//nonblock: connect is in progress after Validate, Recv returns 0
+	//if nothing arrived
+	virtual void SetNonBlock(bool /* nonblock */) {}
+	virtual void Close(void) {}
+
 	virtual ~IConnect() {}
 };
 
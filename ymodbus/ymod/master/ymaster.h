@@ -7,9 +7,12 @@
 #define __YMODBUS_YMASTER_H__
 
 #include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
 #include "ymod/ymbstore.h"
 #include "ymod/ymbplayer.h"
 #include "ymod/ymbtask.h"
+#include "ymod/ymbqueue.h"
+#include "ymod/ymbevent.h"
 
 #include "ymod/ymbnet.h"
 #include "ymod/ymbrtu.h"
@@ -19,6 +22,11 @@
 #include "ymod/master/ytcpconnect.h"
 #include "ymod/master/yserconnect.h"
 #include "ymod/master/yudpconnect.h"
+#include "ymod/master/ymbpipeline.h"
+#include "ymod/master/ymbrequest.h"
+#include "ymod/master/ymbquery.h"
+#include "ymod/master/ymbrtt.h"
+#include "ymod/master/ymbbreaker.h"
 
 #include "ymblog.h"
 #include "ymbopts.h"
@@ -26,11 +34,10 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
-#include <map>
+#include <chrono>
 
 namespace YModbus {
 
@@ -66,6 +73,7 @@ public:
 	{
 		this->conn_.SetTimeout(this->perto_);
 		this->conn_.Validate();
+		this->turnaround_ = pipeline_.Supported() ? 0 : kDefTurnaround;
 
 		if (this->thrm_ == TASK)
 			this->Start();
@@ -79,6 +87,7 @@ public:
 	{
 		this->conn_.SetTimeout(this->perto_);
 		this->conn_.Validate();
+		this->turnaround_ = pipeline_.Supported() ? 0 : kDefTurnaround;
 
 		if (thrm_ == TASK)
 			this->Start();
@@ -96,20 +105,9 @@ public:
 
 	void WaitAsynReader(void)
 	{
-		//wait for all of reader exit
+		//wait for all of reader completed
 		std::unique_lock<std::mutex> lock(asynMutex_);
-		while (!asynReader_.empty()) {
-			auto it = asynReader_.begin();
-			auto id = it->first;
-			auto reader = std::move(it->second);
-			lock.unlock();
-			if (reader.joinable())
-				reader.join();
-			lock.lock();
-			it = asynReader_.find(id);
-			if (it != asynReader_.end()) 
-				asynReader_.erase(id);
-		}
+		asynCond_.wait(lock, [this] { return asynNum_ == 0; });
 	}
 
 	void SetByteOrder(eByteOrder bor) {	bor_ = bor; }
@@ -126,6 +124,61 @@ public:
 	void SetReadTimeout(long rdto) { rdto_ = rdto; }
 	long GetReadTimeout(void) const { return rdto_; }
 
+	//adaptive: timeout of each slave is estimated from its response
+	//time, and limited by the read timeout, see RttTable
+	void SetAdaptiveTimeout(bool adaptive) { rtt_.SetAdaptive(adaptive); }
+	bool GetAdaptiveTimeout(void) const { return rtt_.GetAdaptive(); }
+
+	//backoff: double the adaptive timeout on each retry
+	void SetRetryBackoff(bool backoff) { rtt_.SetBackoff(backoff); }
+	bool GetRetryBackoff(void) const { return rtt_.GetBackoff(); }
+
+	//threshold: consecutive timeouts to suspend a slave, 0: never
+	//suspend: ms, the suspended slave is probed after it, see Breaker
+	//Requests to a suspended slave fail at once with -EHOSTUNREACH.
+	void SetBreaker(uint32_t threshold, long suspend) { breaker_.Set(threshold, suspend); }
+	uint32_t GetBreakerThreshold(void) const { return breaker_.GetThreshold(); }
+	long GetBreakerSuspend(void) const { return breaker_.GetSuspend(); }
+	bool IsSuspended(uint8_t sid) const { return breaker_.Suspended(sid); }
+
+	//Requests are scheduled by priority, see RequestScope and RequestQueue
+	//depth: max requests of the priority pending, beyond it they fail
+	//at once with -ENOBUFS
+	//weight: share of the bus, no effect on PRIO_ALARM
+	void SetQueueDepth(ePriority prio, size_t depth) { queue_.SetDepth(prio, depth); }
+	size_t GetQueueDepth(ePriority prio) const { return queue_.GetDepth(prio); }
+	void SetWeight(ePriority prio, uint32_t weight) { queue_.SetWeight(prio, weight); }
+	uint32_t GetWeight(ePriority prio) const { return queue_.GetWeight(prio); }
+	size_t GetPending(ePriority prio) const { return queue_.GetPending(prio); }
+
+	//window: max requests on the wire, 1 ~ kMaxPipelineWindow
+	//Only for TASK mode and protocols with transaction id(MNet),
+	//other protocols always send the next request after response.
+	void SetWindow(uint32_t window) { window_ = window != 0 ? window : 1; }
+	uint32_t GetWindow(void) const { return window_; }
+
+	//delay: ms, turnaround delay after a broadcast(slave id 0) sent,
+	//time for the slaves to process it. Broadcast is not answered, so
+	//writes to id 0 return after it, reads to id 0 fail with -EINVAL.
+	//Default 0 for protocols with transaction id(TCP/UDP), else kDefTurnaround.
+	void SetTurnaroundDelay(long delay) { turnaround_ = delay > 0 ? delay : 0; }
+	long GetTurnaroundDelay(void) const { return turnaround_; }
+
+	//coalesce: single writes(WriteSingleRegister/WriteSingleCoil) pending
+	//to contiguous addresses of a slave are merged into one multiple
+	//write, each writer still gets its result. Only for TASK mode.
+	void SetWriteCoalescing(bool coalesce) { coalesce_ = coalesce; }
+	bool GetWriteCoalescing(void) const { return coalesce_; }
+
+	//gap: Pull* of the same slave and function are merged into one read,
+	//if registers(coils) between them are not more than gap.
+	//Adjacent or overlapping Pull* are always merged.
+	void SetQueryGap(uint16_t gap) { pending_.SetGap(gap); }
+	uint16_t GetQueryGap(void) const { return pending_.GetGap(); }
+
+	//return: Pull* absorbed by the identical one pending, see QueryList
+	uint64_t GetAbsorbedQuerys(void) const { return pending_.GetAbsorbed(); }
+
 	bool CheckConnect(void)
 	{
 		YMB_ASSERT(this->conn_);
@@ -190,6 +243,33 @@ public:
 		return this->Read(inf, buf, bufsiz);
 	}
 
+	//Read without copy, the response is received into a buffer of the
+	//calling thread, and data points to the datas in it
+	//fun: kFunReadCoils ~ kFunReadInputRegisters
+	//data: net order, valid until the next ReadView of this thread
+	//return: >= 0, bytes of data; < 0, errorcode
+	int ReadView(uint8_t sid, uint8_t fun, uint16_t reg, uint16_t num,
+		const uint8_t *&data)
+	{
+		static thread_local uint8_t viewbuf[kMaxMsgLen];
+
+		data = nullptr;
+		if (fun < kFunReadCoils || fun > kFunReadInputRegisters)
+			return -EINVAL;
+
+		MsgInf inf = { sid, fun, reg, num };
+		inf.pbuf = viewbuf;
+		inf.bufsiz = sizeof(viewbuf);
+
+		int ret = this->SendRequest(inf);
+		if (ret == 0 && inf.datalen != 0) { //received data
+			data = inf.databuf;
+			ret = inf.datalen;
+		}
+
+		return ret;
+	}
+
 	//return: = 0, OK; 
 	//return: < 0, errorcode of exception
 	//values: data value, net order
@@ -266,6 +346,121 @@ public:
 		return this->Read(inf, buf, bufsiz);
 	}
 
+	//Asynchronous api, return without waiting for the response
+	//return: = 0, OK, complete will be called in master task thread,
+	//or before return in POLL mode;
+	//return: < 0, errorcode, complete will not be called
+	//complete: result of the request, see Completion
+	int ReadCoilsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return this->Submit({ sid, kFunReadCoils, reg, num },
+			std::move(complete));
+	}
+
+	int ReadDiscreteInputsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return this->Submit({ sid, kFunReadDiscreteInputs, reg, num },
+			std::move(complete));
+	}
+
+	int ReadInputRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return this->Submit({ sid, kFunReadInputRegisters, reg, num },
+			std::move(complete));
+	}
+
+	int ReadHoldingRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return this->Submit({ sid, kFunReadHoldingRegisters, reg, num },
+			std::move(complete));
+	}
+
+	int WriteSingleCoilAsync(uint8_t sid,
+		uint16_t reg, bool onoff, Completion complete)
+	{
+		uint8_t databuf[] = {
+			static_cast<uint8_t>(onoff ? 0xff : 0x00),
+			0x00
+		};
+		MsgInf inf = { sid, kFunWriteSingleCoil, 0, 0, reg, 1, databuf, 2 };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	int WriteCoilsAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *bits, uint8_t wbytes, Completion complete)
+	{
+		MsgInf inf = { sid, kFunWriteMultiCoils, 0, 0, reg, num,
+			const_cast<uint8_t*>(bits), wbytes };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	int WriteSingleRegisterAsync(uint8_t sid,
+		uint16_t reg, uint16_t value, Completion complete)
+	{
+		uint8_t databuf[] = {
+			static_cast<uint8_t>(value >> 8),
+			static_cast<uint8_t>(value & 0xff)
+		};
+		MsgInf inf = { sid, kFunWriteSingleRegister, 0, 0, reg, 1, databuf, 2 };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	int WriteRegistersAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *values, uint8_t wbytes, Completion complete)
+	{
+		MsgInf inf = { sid, kFunWriteMultiRegisters, 0, 0, reg, num,
+			const_cast<uint8_t*>(values), wbytes };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	int MaskWriteRegistersAsync(uint8_t sid, uint16_t reg,
+		uint16_t andmask, uint16_t ormask, Completion complete)
+	{
+		uint8_t databuf[] = {
+			static_cast<uint8_t>(andmask >> 8),
+			static_cast<uint8_t>(andmask & 0xff),
+			static_cast<uint8_t>(ormask >> 8),
+			static_cast<uint8_t>(ormask & 0xff)
+		};
+		MsgInf inf = { sid, kFunMaskWriteRegister, 0, 0, reg, 1, databuf, 4 };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	int WriteReadRegistersAsync(uint8_t sid,
+		uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
+		uint16_t rreg, uint16_t rnum, Completion complete)
+	{
+		MsgInf inf = { sid, kFunWriteAndReadRegisters, rreg, rnum, wreg, wnum,
+			const_cast<uint8_t*>(values), wbytes };
+
+		return this->Submit(inf, std::move(complete));
+	}
+
+	//Read many blocks in one call, they are queued together and the
+	//caller is woken up once when all are completed. Blocks are
+	//pipelined as SetWindow, or executed back to back.
+	//results: >= 0, bytes read into buf of each spec; < 0, errorcode
+	//return: blocks read
+	int ReadBatch(const std::vector<ReadSpec> &specs, std::vector<int> &results)
+	{
+		return ExecBatch(specs, results,
+			[this](const MsgInf &inf, Completion complete) {
+			return this->Submit(inf, std::move(complete), false);
+		}, [this] {
+			if (this->thrm_ == TASK)
+				this->event_.Notify();
+		});
+	}
+
 	//return: >= 0, OK
 	//return: < 0,  errorcode of exception
 	int ReportSlaveId(uint8_t maxsid, uint8_t *buf, size_t bufsiz)
@@ -302,6 +497,80 @@ public:
 		return ret == EOK;
 	}
 
+	//Read count values of T from successive registers, as many values
+	//as fit are packed into each read, and the reads are submitted
+	//together, see ReadBatch. Byte order is converted by SetByteOrder.
+	//fun: kFunReadHoldingRegisters or kFunReadInputRegisters
+	//return: = count, OK; < 0, errorcode
+	template<typename T>
+	int ReadValues(uint8_t sid, uint16_t startreg, T *vals, size_t count,
+		uint8_t fun = kFunReadHoldingRegisters)
+	{
+		static_assert(sizeof(T) % 2 == 0 && sizeof(T) <= kMaxRegNum * 2,
+			"T must be of whole registers");
+		const size_t regs = sizeof(T) / 2;
+		const size_t per = kMaxRegNum / regs; //values of one read
+
+		if (fun != kFunReadHoldingRegisters && fun != kFunReadInputRegisters)
+			return -EINVAL;
+		if (count * regs > 0x10000u - startreg)
+			return -EINVAL;
+
+		//datas are read into vals directly
+		uint8_t *p = reinterpret_cast<uint8_t*>(vals);
+		std::vector<ReadSpec> specs;
+		std::vector<int> results;
+
+		for (size_t i = 0; i < count; i += per) {
+			size_t n = count - i < per ? count - i : per;
+			specs.push_back({ sid, fun, static_cast<uint16_t>(startreg + i * regs),
+				static_cast<uint16_t>(n * regs), p + i * sizeof(T), n * sizeof(T) });
+		}
+
+		ReadBatch(specs, results);
+		for (size_t k = 0; k < specs.size(); k++) {
+			if (results[k] < 0)
+				return results[k];
+			if (static_cast<size_t>(results[k]) != specs[k].bufsiz)
+				return -EFAULT; //exception or short response
+		}
+
+		YNetToHostArray(vals, count, bor_);
+		return static_cast<int>(count);
+	}
+
+	//Write count values of T to successive holding registers, as many
+	//values as fit are packed into each write.
+	//return: = count, OK; < 0, errorcode, values before the failed
+	//write have been written
+	template<typename T>
+	int WriteValues(uint8_t sid, uint16_t startreg, const T *vals, size_t count)
+	{
+		static_assert(sizeof(T) % 2 == 0 && sizeof(T) <= kMaxWriteRegNum * 2,
+			"T must be of whole registers");
+		const size_t regs = sizeof(T) / 2;
+		const size_t per = kMaxWriteRegNum / regs; //values of one write
+		T wvals[kMaxWriteRegNum / (sizeof(T) / 2)];
+
+		if (count * regs > 0x10000u - startreg)
+			return -EINVAL;
+
+		for (size_t i = 0; i < count; i += per) {
+			size_t n = count - i < per ? count - i : per;
+
+			memcpy(wvals, vals + i, n * sizeof(T));
+			YHostToNetArray(wvals, n, bor_);
+
+			int ret = WriteRegisters(sid, static_cast<uint16_t>(startreg + i * regs),
+				static_cast<uint16_t>(n * regs), reinterpret_cast<uint8_t*>(wvals),
+				static_cast<uint8_t>(n * sizeof(T)));
+			if (ret != EOK)
+				return ret;
+		}
+
+		return static_cast<int>(count);
+	}
+
 	template<typename Tw, typename Tr>
 	bool WriteReadValue(uint8_t sid, 
 		uint16_t wreg, Tw &wval, uint16_t rreg, Tr &rval)
@@ -323,32 +592,34 @@ public:
 		return ret == sizeof(rvalue);
 	}
 
+	//Read value of holding registers without waiting
+	//f: void(uint8_t sid, uint16_t startreg, T val), only called if
+	//succeeded, in master task thread, see Completion
+	//return: = 0, OK; < 0, errorcode, f will not be called
 	template<typename T, typename F>
-	void AsyncRead(uint8_t sid, uint16_t startreg, F f)
+	int AsyncRead(uint8_t sid, uint16_t startreg, F f)
 	{
+		eByteOrder bor = bor_;
+
 		std::unique_lock<std::mutex> lock(asynMutex_);
+		asynNum_++;
+		lock.unlock();
 
-		for (auto id : exitReader_) {	//erase exit reader thread
-			auto it = asynReader_.find(id);
-			if (it != asynReader_.end()) {
-				auto reader = std::move(it->second);
-				if (reader.joinable())
-					reader.join();
-				asynReader_.erase(it);
+		int ret = this->ReadHoldingRegistersAsync(sid, startreg, sizeof(T) / 2,
+			[this, sid, startreg, bor, f](int ret, const uint8_t *buf) {
+			if (ret == sizeof(T)) {
+				T val;
+				memcpy(&val, buf, sizeof(val));
+				YNetToHost(val, bor);
+				f(sid, startreg, val);
 			}
-		}
-		exitReader_.clear();
+			this->AsynReaderDone();
+		});
 
-		asynReader_[asynId_] = std::thread(
-			[this](uint8_t s, uint16_t r, F f, uint32_t id) {
-			T val;
-			if (this->ReadValue(s, r, val)) 
-				f(s, r, val);
-			std::unique_lock<std::mutex> lock(this->asynMutex_);
-			this->exitReader_.push_back(id); //mark exit reader
-		}, sid, startreg, f, asynId_);
+		if (ret != EOK)
+			AsynReaderDone();
 
-		asynId_++;
+		return ret;
 	}
 
 protected:
@@ -356,22 +627,50 @@ protected:
 	std::string Name(void) override { return "TMaster Task"; }
 
 private:
-	int ExecPoll(MsgInf &inf);
-	int SendRecv(MsgInf &inf);
+	int ExecPoll(MsgInf &inf, uint32_t tries = 0);
+	int SendRecv(MsgInf &inf, uint32_t tries);
+	int SendBroadcast(MsgInf &inf);
+	int RecvSlaveMsg(MsgInf &inf, long rdto, size_t &msglen);
+	void UpdateSlave(uint8_t sid, uint32_t tries, int err, long rtt);
+	void UpdateStore(const MsgInf &inf);
+	void RunPipeline(void);
+	bool Schedule(Request *&req);
+
+	bool FetchQuerys(void);
+	int ExecQuery(const Query &q);
+	void FinishQuery(const Query &q, const MsgInf &inf, int err);
 
 	int Read(MsgInf &inf, uint8_t *buf, size_t bufsiz);
 	int Write(MsgInf &inf);
 
 	int SendRequest(MsgInf &inf);
 	void PostQuery(const MsgInf &inf);
+	int Submit(const MsgInf &inf, Completion complete, bool notify = true);
+
+	void AsynReaderDone(void)
+	{
+		std::unique_lock<std::mutex> lock(asynMutex_);
+		if (--asynNum_ == 0)
+			asynCond_.notify_all();
+	}
+	bool Finish(Request *req, int err);
+	void Complete(Request *req);
 
 	const uint32_t kDefRetries = 3;
 	const long kDefRdTimeout = 500; //ms
 	const long kPerReadTimeout = 10; //ms
+	const long kMinRdTimeout = 20; //ms, least adaptive timeout
+	const uint32_t kDefWindow = 1;
+	const long kDefTurnaround = 100; //ms, for serial line
 
 	uint32_t retries_ = kDefRetries;
 	long rdto_ = kDefRdTimeout; //read timeout
 	const long perto_ = kPerReadTimeout; //ms 每次接收超时
+	uint32_t window_ = kDefWindow; //max outstanding requests
+	bool coalesce_ = false; //merge single writes
+	long turnaround_ = 0; //ms, delay after broadcast
+	RttTable rtt_{ kMinRdTimeout }; //timeout of each slave
+	Breaker breaker_; //health of each slave
 
 	eThreadMode thrm_;
 	eByteOrder bor_;
@@ -381,26 +680,17 @@ private:
 	TProtocol prot_;
 	TConnect conn_;
 
-	struct Request
-	{
-		Request(MsgInf &i) : err(0), inf(i) {}
-		int err;	//error, api or logical error
-		MsgInf &inf; //modbus exception code is in inf.err
-		std::mutex mutex;
-		std::condition_variable cond;
-	};
-	typedef std::shared_ptr<Request> RequestPtr;
-
-	std::queue<RequestPtr> requests_;
-	std::queue<MsgInf> querys_;
+	RequestPool pool_;
+	RequestQueue queue_;
+	MpscQueue<MsgInf, kMaxQueryNum> querys_;
+	QueryList pending_; //querys fetched by master task
+	Pipeline<TProtocol, TConnect, Transaction> pipeline_{ prot_, conn_ };
 
-	std::mutex mutex_;
-	std::condition_variable cond_;
+	Event event_; //wake up master task
 
-	uint32_t asynId_ = 0;
+	uint32_t asynNum_ = 0; //AsyncRead outstanding
 	std::mutex asynMutex_;
-	std::map<uint32_t, std::thread> asynReader_;
-	std::vector<uint32_t> exitReader_;
+	std::condition_variable asynCond_;
 
 	static thread_local int error;
 };
@@ -465,33 +755,114 @@ int  TMaster<TProtocol, TConnect, TBase>::Write(MsgInf &inf)
 	return EOK;
 }
 
+template<typename TProtocol, typename TConnect, typename TBase>
+int TMaster<TProtocol, TConnect, TBase>::Submit(const MsgInf &inf,
+	Completion complete, bool notify)
+{
+	Request *req = pool_.Get(inf, std::move(complete));
+	if (req == nullptr) {
+		YMB_DEBUG("Too many requests pending!\n");
+		return -EBUSY;
+	}
+
+	if (thrm_ == TASK) {
+		if (int ret = queue_.Push(req)) {
+			YMB_DEBUG("Too many requests of priority %d!\n", req->prio);
+			pool_.Put(req);
+			return ret;
+		}
+		if (notify)
+			event_.Notify();
+	}
+	else { //POLL, execute poll diretctly
+		while (!Finish(req, ExecPoll(req->inf, req->tries)))
+			;
+	}
+
+	return EOK;
+}
+
+//Retry or complete the executed request
+//return: true, request is completed; false, request need to retry
+template<typename TProtocol, typename TConnect, typename TBase>
+bool TMaster<TProtocol, TConnect, TBase>::Finish(Request *req, int err)
+{
+	if (IsRetryable(err) && ++req->tries < retries_) {
+		req->inf = req->ask;
+		return false;
+	}
+
+	req->err = err;
+
+	if (req->group != nullptr) { //merged writes, complete each of them
+		SplitWrites(queue_, *req, -EFAULT, [this](Request *r) { this->Complete(r); });
+		pool_.Put(req);
+	}
+	else {
+		Complete(req);
+	}
+
+	return true;
+}
+
+//Pass the result to the caller
+template<typename TProtocol, typename TConnect, typename TBase>
+void TMaster<TProtocol, TConnect, TBase>::Complete(Request *req)
+{
+	if (req->complete) { //asynchronous request, return it to pool
+		int ret = GetRequestResult(*req, -EFAULT);
+		req->complete(ret, ret > 0 ? req->inf.databuf : nullptr);
+		pool_.Put(req);
+	}
+	else { //synchronous request, wake up the caller
+		std::unique_lock<std::mutex> lock(req->mutex);
+		req->done = true;
+		req->cond.notify_all();
+	}
+}
+
 template<typename TProtocol, typename TConnect, typename TBase>
 int  TMaster<TProtocol, TConnect, TBase>::SendRequest(MsgInf &inf)
 {
-	uint32_t retry = 0;
-	error = -EFAULT;
+	if (thrm_ == TASK) {
+		//发送请求, retried by master task
+		Request *req = pool_.Get(inf, nullptr);
+		if (req == nullptr) {
+			YMB_DEBUG("Too many requests pending!\n");
+			return error = -EBUSY;
+		}
 
-	do {
-		if (thrm_ == TASK) {
-			if (auto req = std::make_shared<Request>(inf)) {
-				//发送请求
-				std::unique_lock<std::mutex> lockq(mutex_);
-				requests_.push(req);
-				cond_.notify_all();
-				lockq.unlock();
-
-				//等待执行
-				std::unique_lock<std::mutex> lockr(req->mutex);
-				req->cond.wait(lockr);
-
-				//错误信息存放在线程局部变量
-				error = req->err;
-			}
+		if (int ret = queue_.Push(req)) {
+			YMB_DEBUG("Too many requests of priority %d!\n", req->prio);
+			pool_.Put(req);
+			return error = ret;
 		}
-		else { //POLL, execute poll diretctly
-			error = ExecPoll(inf);
+		event_.Notify();
+
+		//等待执行, done is set before notify, no wakeup is lost
+		std::unique_lock<std::mutex> lockr(req->mutex);
+		req->cond.wait(lockr, [req] { return req->done; });
+		lockr.unlock();
+
+		//错误信息存放在线程局部变量
+		error = req->err;
+		inf = req->inf;
+		if (inf.pbuf == req->buf) { //datas are gone with the request
+			inf.pbuf = nullptr;
+			inf.bufsiz = 0;
+			inf.databuf = nullptr;
+			inf.datalen = 0;
 		}
-	} while (error != 0 && ++retry < retries_);
+
+		pool_.Put(req);
+		return error;
+	}
+
+	uint32_t retry = 0;
+
+	do { //POLL, execute poll diretctly
+		error = ExecPoll(inf, retry);
+	} while (IsRetryable(error) && ++retry < retries_);
 
 	return error;
 }
@@ -501,9 +872,13 @@ void  TMaster<TProtocol, TConnect, TBase>::PostQuery(const MsgInf &inf)
 {
 	if (thrm_ == TASK) {
 		//提交查询，不需等待返回
-		std::unique_lock<std::mutex> lock(mutex_);
-		querys_.push(inf);
-		cond_.notify_all();
+		if (querys_.Push(inf)) {
+			event_.Notify();
+		}
+		else {
+			YMB_DEBUG("Too many querys pending!\n");
+			error = -EBUSY;
+		}
 	}
 	else {
 		//POLL mode, also need waiting for result, but only execute once
@@ -512,7 +887,7 @@ void  TMaster<TProtocol, TConnect, TBase>::PostQuery(const MsgInf &inf)
 }
 
 template<typename TProtocol, typename TConnect, typename TBase>
-int TMaster<TProtocol, TConnect, TBase>::ExecPoll(MsgInf &inf)
+int TMaster<TProtocol, TConnect, TBase>::ExecPoll(MsgInf &inf, uint32_t tries)
 {
 	bool bInnerBuf = false;
 
@@ -524,12 +899,10 @@ int TMaster<TProtocol, TConnect, TBase>::ExecPoll(MsgInf &inf)
 
 	YMB_ASSERT(inf.bufsiz >= sizeof(msgbuf_));
 
-	int ret = SendRecv(inf);
+	int ret = SendRecv(inf, tries);
 
-	if (ret == EOK && inf.datalen != 0 && store_) {
-		YMB_ASSERT(inf.databuf != nullptr);
-		store_->Set(inf.id, inf.rreg, inf.databuf, inf.rnum);
-	}
+	if (ret == EOK)
+		UpdateStore(inf);
 
 	if (bInnerBuf) {
 		inf.pbuf = nullptr;
@@ -542,82 +915,298 @@ int TMaster<TProtocol, TConnect, TBase>::ExecPoll(MsgInf &inf)
 }
 
 template<typename TProtocol, typename TConnect, typename TBase>
-int TMaster<TProtocol, TConnect, TBase>::SendRecv(MsgInf &inf)
+void TMaster<TProtocol, TConnect, TBase>::UpdateStore(const MsgInf &inf)
+{
+	if (inf.datalen != 0 && store_) {
+		YMB_ASSERT(inf.databuf != nullptr);
+		store_->Set(inf.id, inf.rreg, inf.databuf, inf.rnum);
+	}
+}
+
+//Move querys posted into pending list, merged if possible
+//return: true, some querys are pending
+template<typename TProtocol, typename TConnect, typename TBase>
+bool TMaster<TProtocol, TConnect, TBase>::FetchQuerys(void)
+{
+	MsgInf inf;
+
+	while (!pending_.Full() && querys_.Pop(inf))
+		pending_.Add(inf);
+
+	return !pending_.Empty();
+}
+
+template<typename TProtocol, typename TConnect, typename TBase>
+int TMaster<TProtocol, TConnect, TBase>::ExecQuery(const Query &q)
+{
+	MsgInf inf = q.inf;
+
+	inf.pbuf = msgbuf_;
+	inf.bufsiz = sizeof(msgbuf_);
+
+	int ret = SendRecv(inf, 0);
+	FinishQuery(q, inf, ret);
+
+	return ret;
+}
+
+//inf: response of query
+template<typename TProtocol, typename TConnect, typename TBase>
+void TMaster<TProtocol, TConnect, TBase>::FinishQuery(const Query &q,
+	const MsgInf &inf, int err)
+{
+	if (err != EOK)
+		return;
+
+	if (inf.err != 0 && q.nparts > 1) { //merged read may be refused
+		YMB_DEBUG("Merged query exception %u, split it!\n", inf.err);
+		pending_.Split(q);
+		return;
+	}
+
+	if (inf.datalen != 0) {
+		ForEachQueryPart(q, inf, [this](const MsgInf &pinf) {
+			this->UpdateStore(pinf);
+		});
+	}
+}
+
+template<typename TProtocol, typename TConnect, typename TBase>
+int TMaster<TProtocol, TConnect, TBase>::SendRecv(MsgInf &inf, uint32_t tries)
 {
+	if (inf.id == kBroadcastId)
+		return SendBroadcast(inf);
+
+	if (!breaker_.Allow(inf.id)) //suspended
+		return -EHOSTUNREACH;
+
 	if (!conn_.Validate())
 		return -ENOLINK;
 
 	YMB_ASSERT(inf.pbuf != nullptr);
 	size_t msglen = prot_.MakeMasterMsg(inf.pbuf, inf.bufsiz, inf);
 
+	uint8_t sid = inf.id;
+	long rdto = rtt_.Timeout(sid, tries, rdto_);
+
 	conn_.Purge(); //清空buffer
 	if (!conn_.Send(inf.pbuf, msglen))
 		return -ENETRESET;
 
+	int64_t sent = RttTable::Now();
+
+	int ret = RecvSlaveMsg(inf, rdto, msglen);
+	conn_.SetTimeout(perto_); //for pipeline
+
+	UpdateSlave(sid, tries, ret, static_cast<long>(RttTable::Now() - sent));
+	if (ret != EOK)
+		return ret;
+
+	return prot_.ParseSlaveMsg(inf.pbuf, msglen, inf);
+}
+
+//Broadcast is not answered, return after the msg sent and the
+//turnaround delay elapsed, the next request is not sent before it
+//return: = 0, OK, msg has been sent; < 0, errorcode
+template<typename TProtocol, typename TConnect, typename TBase>
+int TMaster<TProtocol, TConnect, TBase>::SendBroadcast(MsgInf &inf)
+{
+	const FunDesc &desc = GetFunDesc(inf.fun);
+	if (!desc.supported || desc.bits != 0) //nothing can be read back
+		return -EINVAL;
+
+	if (!conn_.Validate())
+		return -ENOLINK;
+
+	YMB_ASSERT(inf.pbuf != nullptr);
+	size_t msglen = prot_.MakeMasterMsg(inf.pbuf, inf.bufsiz, inf);
+
+	if (!conn_.Send(inf.pbuf, msglen))
+		return -ENETRESET;
+
+	if (turnaround_ > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(turnaround_));
+
+	//as if answered with the request, nothing to update to the store
+	inf.databuf = nullptr;
+	inf.datalen = 0;
+
+	return EOK;
+}
+
+//Receive the response before the deadline, return as soon as the bytes
+//predicted by the request(Rtu), or expected by VerifySlaveMsg arrived
+//rdto: ms, read timeout
+//msglen: length of the response
+//return: = 0, OK, msg arrived; < 0, errorcode
+template<typename TProtocol, typename TConnect, typename TBase>
+int TMaster<TProtocol, TConnect, TBase>::RecvSlaveMsg(MsgInf &inf,
+	long rdto, size_t &msglen)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(rdto);
+	int expect = prot_.ExpectSlaveMsgLen(inf); //predicted by request
+	int need = expect > 0 ? expect : prot_.VerifySlaveMsg(inf.pbuf, 0);
+	Crc16Context crc; //of the bytes arrived(Rtu)
+
 	msglen = 0;
-	for (long to = 0; to < rdto_; to += perto_) { //timeout
-		int ret = conn_.Recv(inf.pbuf + msglen, inf.bufsiz - msglen);
-		if (ret > 0) { //received some data
-			msglen += ret;
-			ret = prot_.VerifySlaveMsg(inf.pbuf, msglen);
-			if (ret == EOK) //OK, msg arrived
-				return prot_.ParseSlaveMsg(inf.pbuf, msglen, inf);
-			if (ret < 0) //msg error
-				return -EBADMSG;
-		}
+	while (need > 0) {
+		auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+			deadline - Clock::now()).count();
+		if (left <= 0) //timeout
+			return -EBUSY;
+
+		if (msglen + need > inf.bufsiz)
+			return -EBADMSG;
+
+		conn_.SetTimeout(static_cast<long>((left + 999) / 1000));
+		int ret = conn_.Recv(inf.pbuf + msglen, static_cast<size_t>(need));
 		if (ret < 0) //connect error
 			return -ENETRESET;
+		if (ret == 0) //nothing arrived
+			continue;
+
+		msglen += ret;
+		need = prot_.VerifySlaveMsg(inf.pbuf, msglen, crc);
+		if (need == EOK) { //OK, msg arrived
+			int tid = prot_.GetTransactionId(inf.pbuf, msglen);
+			if (tid >= 0 && tid != inf.tid) { //late response of the last try
+				msglen = 0;
+				crc.Reset();
+				need = prot_.VerifySlaveMsg(inf.pbuf, 0);
+			}
+		}
 	}
 
-	return -EBUSY;
+	return need == EOK ? EOK : -EBADMSG;
+}
+
+//Track the response time and health of slave with the result of a try
+template<typename TProtocol, typename TConnect, typename TBase>
+void TMaster<TProtocol, TConnect, TBase>::UpdateSlave(uint8_t sid,
+	uint32_t tries, int err, long rtt)
+{
+	if (err == EOK) {
+		rtt_.Sample(sid, tries, rtt);
+		breaker_.Success(sid);
+	}
+	else if (err == -EBUSY) { //timeout
+		rtt_.Expire(sid);
+		breaker_.Failure(sid);
+	}
 }
 
 template<typename TProtocol, typename TConnect, typename TBase>
 void TMaster<TProtocol, TConnect, TBase>::Run(void)
 {
+	Request *req;
+
 	while (this->IsRunning()) {
 		//等待操作通知
-		std::unique_lock<std::mutex> lock(mutex_);
-		cond_.wait_for(lock, std::chrono::seconds(1));
-
-		while (!requests_.empty() || !querys_.empty()) {
-			if (!requests_.empty()) { //始终优先执行请求命令
-				auto req = requests_.front();
-				lock.unlock();
-
-				req->err = ExecPoll(req->inf);
-				req->cond.notify_all();
-
-				lock.lock();
-				requests_.pop();
-			}
-			else if (!querys_.empty()) {
-				auto &inf = querys_.front();
-				lock.unlock();
+		if (pipeline_.Empty() && pending_.Empty()) {
+			event_.WaitFor(1000, [this] {
+				return !queue_.Empty() || !querys_.Empty();
+			});
+		}
 
-				ExecPoll(inf);
+		if ((window_ > 1 && pipeline_.Supported()) || !pipeline_.Empty()) {
+			RunPipeline();
+			continue;
+		}
 
-				lock.lock();
-				querys_.pop();
+		while (Schedule(req)) {
+			if (req != nullptr) {
+				if (!Finish(req, ExecPoll(req->inf, req->tries)))
+					queue_.Retry(req);
 			}
-			else {
-				; //assert(false);
+			else { //query
+				Query q = pending_.Front();
+				pending_.Pop();
+				ExecQuery(q);
 			}
 		}
 	}
 
 	//完成所有等待的请求
-	std::unique_lock<std::mutex> lock(mutex_);
-	while (!requests_.empty()) {
-		auto req = requests_.front();
-		lock.unlock();
+	while (!pipeline_.Empty())
+		RunPipeline();
 
-		req->err = ExecPoll(req->inf);
-		req->cond.notify_all();
+	while (queue_.Pop(req, false)) {
+		if (!Finish(req, ExecPoll(req->inf, req->tries)))
+			queue_.Retry(req);
+	}
+}
+
+//Pick the next one to execute, requests expired are completed here
+//return: true, req to execute, or a query if req is nullptr
+template<typename TProtocol, typename TConnect, typename TBase>
+bool TMaster<TProtocol, TConnect, TBase>::Schedule(Request *&req)
+{
+	while (queue_.Pop(req, FetchQuerys())) {
+		if (req == nullptr) //query
+			return true;
+
+		if (!req->Expired()) {
+			if (coalesce_)
+				req = CoalesceWrites(queue_, pool_, req);
+			return true;
+		}
+
+		YMB_DEBUG0("Request expired before sent!\n");
+		Finish(req, -ETIMEDOUT);
+	}
+
+	return false;
+}
+
+//Keep the window full of requests, then receive the responses
+template<typename TProtocol, typename TConnect, typename TBase>
+void TMaster<TProtocol, TConnect, TBase>::RunPipeline(void)
+{
+	Transaction t;
 
-		lock.lock();
-		requests_.pop();
+	while (!pipeline_.Full(window_)) {
+		if (!Schedule(t.req)) {
+			break;
+		}
+		else if (t.req != nullptr && t.req->ask.id == kBroadcastId) {
+			if (!Finish(t.req, SendBroadcast(t.req->inf))) //not outstanding
+				queue_.Retry(t.req);
+		}
+		else if (t.req != nullptr) {
+			int err = !breaker_.Allow(t.req->ask.id) ? -EHOSTUNREACH
+				: pipeline_.Send(t.req->inf, t,
+					rtt_.Timeout(t.req->ask.id, t.req->tries, rdto_));
+			if (err != EOK && !Finish(t.req, err))
+				queue_.Retry(t.req);
+		}
+		else { //query
+			t.query = pending_.Front();
+			pending_.Pop();
+			if (t.query.inf.id != kBroadcastId && breaker_.Allow(t.query.inf.id))
+				pipeline_.Send(t.query.inf, t, rtt_.Timeout(t.query.inf.id, 0, rdto_));
+		}
 	}
+
+	if (pipeline_.Empty())
+		return;
+
+	pipeline_.Recv([this](MsgInf &inf, Transaction &t, int err, long rtt) {
+		if (t.req == nullptr) { //query
+			this->UpdateSlave(t.query.inf.id, 0, err, rtt);
+			this->FinishQuery(t.query, inf, err);
+			return;
+		}
+
+		this->UpdateSlave(t.req->ask.id, t.req->tries, err, rtt);
+		if (err == EOK)
+			this->UpdateStore(inf);
+
+		t.req->inf = inf;
+		if (!this->Finish(t.req, err))
+			this->queue_.Retry(t.req);
+	});
 }
 
 //The most useful master predefines
@@ -0,0 +1,118 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBBREAKER_H__
+#define __YMODBUS_YMBBREAKER_H__
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+namespace YModbus {
+
+//Health of the slaves behind one connection(circuit breaker).
+//A slave is suspended after threshold consecutive timeouts, and the
+//requests to it fail at once with -EHOSTUNREACH. When suspend is over
+//one request is let through as a probe, the slave is healthy again if
+//it answers, or suspended twice as long(up to kMaxSuspend) if not.
+//The broadcast id(0) is never tracked.
+//Allow, Success and Failure are called by the thread executing the
+//requests only, Suspended and the settings by any thread.
+class Breaker
+{
+public:
+	Breaker()
+		: threshold_(0)
+		, suspend_(1000)
+	{
+	}
+
+	//threshold: consecutive timeouts to suspend the slave, 0: never
+	//suspend: ms, time before the first probe
+	void Set(uint32_t threshold, long suspend)
+	{
+		threshold_.store(threshold, std::memory_order_relaxed);
+		suspend_.store(suspend > 0 ? suspend : 1, std::memory_order_relaxed);
+	}
+
+	uint32_t GetThreshold(void) const { return threshold_.load(std::memory_order_relaxed); }
+	long GetSuspend(void) const { return suspend_.load(std::memory_order_relaxed); }
+
+	//return: true, request to the slave may be sent
+	bool Allow(uint8_t sid)
+	{
+		Entry &e = entries_[sid];
+		long suspend = e.suspend.load(std::memory_order_relaxed);
+
+		if (suspend == 0 || sid == 0) //healthy
+			return true;
+
+		auto now = Clock::now();
+		if (now < e.probe)
+			return false;
+
+		//probing, no more probes until the next suspend is over
+		e.probe = now + std::chrono::milliseconds(suspend);
+		return true;
+	}
+
+	//Slave answered, even if with an exception
+	void Success(uint8_t sid)
+	{
+		Entry &e = entries_[sid];
+
+		e.timeouts = 0;
+		e.suspend.store(0, std::memory_order_relaxed);
+	}
+
+	//No response in timeout
+	void Failure(uint8_t sid)
+	{
+		Entry &e = entries_[sid];
+		uint32_t threshold = threshold_.load(std::memory_order_relaxed);
+		long suspend = e.suspend.load(std::memory_order_relaxed);
+
+		if (threshold == 0 || sid == 0)
+			return;
+
+		if (suspend != 0) { //probe failed
+			suspend = suspend < kMaxSuspend / 2 ? suspend * 2 : kMaxSuspend;
+		}
+		else if (++e.timeouts >= threshold) { //trip
+			suspend = suspend_.load(std::memory_order_relaxed);
+		}
+		else {
+			return;
+		}
+
+		e.suspend.store(suspend, std::memory_order_relaxed);
+		e.probe = Clock::now() + std::chrono::milliseconds(suspend);
+	}
+
+	bool Suspended(uint8_t sid) const
+	{
+		return entries_[sid].suspend.load(std::memory_order_relaxed) != 0;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	static const long kMaxSuspend = 60000; //ms
+
+	struct Entry
+	{
+		uint32_t timeouts = 0; //consecutive
+		std::atomic<long> suspend{ 0 }; //ms, 0: healthy, read by Suspended
+		Clock::time_point probe; //the next probe is allowed
+	};
+
+	std::atomic<uint32_t> threshold_;
+	std::atomic<long> suspend_;
+	Entry entries_[256];
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBBREAKER_H__
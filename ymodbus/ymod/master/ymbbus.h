@@ -0,0 +1,224 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBBUS_H__
+#define __YMODBUS_YMBBUS_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/master/ymbrouter.h"
+#include "ymblog.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cerrno>
+
+namespace YModbus {
+
+//Masters of some buses(serial ports) behind one api. A bus executes one
+//request at a time, so each bus is a lane with its own master and task,
+//kept busy by the requests queued to it, and buses work in parallel.
+//Requests are routed to the bus of the slave by its id(SetRoute), the
+//results of all buses go into one store. A scan list over all of the
+//buses is run by Scanner<BusGroup<...>>, which queues each read to its
+//bus when due. Broadcast(id 0) is sent on every bus, it fails with the
+//error of any bus, and is completed when it is sent on all of buses.
+//Requests to a slave not routed fail with -ENXIO, Pull* are ignored.
+//Buses and routes are set up before requests are made.
+//TMasterT: {Master, TMaster<...>}, masters should be in TASK mode
+template<typename TMasterT>
+class BusGroup : public MasterRouter<TMasterT, BusGroup<TMasterT>>
+{
+public:
+	BusGroup()
+	{
+		for (auto &route : routes_)
+			route = -ENXIO;
+	}
+
+	BusGroup(const BusGroup&) = delete;
+	BusGroup &operator = (const BusGroup&) = delete;
+
+	//args: arguments to construct the master of the bus
+	//return: index of the bus
+	template<typename... Args>
+	size_t AddBus(const Args&... args)
+	{
+		lanes_.emplace_back(new Lane);
+		lanes_.back()->master.reset(new TMasterT(args...));
+
+		return lanes_.size() - 1;
+	}
+
+	size_t Size(void) const { return lanes_.size(); }
+	TMasterT &GetMaster(size_t bus) { return *lanes_.at(bus)->master; }
+
+	//outstanding requests of the bus, api calls not returned
+	uint32_t GetOutstanding(size_t bus) const
+	{
+		return lanes_.at(bus)->outstanding.load();
+	}
+
+	//Slaves [first, last] are on the bus
+	//return: = 0, OK; < 0, errorcode
+	int SetRoute(uint8_t first, uint8_t last, size_t bus)
+	{
+		if (bus >= lanes_.size() || first == kBroadcastId || first > last)
+			return -EINVAL;
+
+		for (uint32_t sid = first; sid <= last; sid++)
+			routes_[sid] = static_cast<int>(bus);
+
+		return EOK;
+	}
+
+	int SetRoute(uint8_t sid, size_t bus) { return SetRoute(sid, sid, bus); }
+
+	//return: >= 0, index of the bus; < 0, -ENXIO, slave is not routed
+	int GetRoute(uint8_t sid) const { return routes_[sid].load(); }
+
+private:
+	friend class MasterRouter<TMasterT, BusGroup<TMasterT>>;
+
+	struct Lane
+	{
+		std::unique_ptr<TMasterT> master;
+		std::atomic<uint32_t> outstanding{ 0 };
+
+		//asynchronous request is completed, see Completion::Then
+		static void Done(void *lane) { static_cast<Lane*>(lane)->outstanding--; }
+	};
+
+	//Results of a broadcast on all of buses
+	struct Fanout
+	{
+		std::atomic<size_t> left; //buses not completed, and the caller
+		std::atomic<int> err{ EOK }; //the last error of any bus
+		Completion complete;
+	};
+
+	TMasterT &Front(void) const { return *lanes_.front()->master; }
+
+	//f: void(TMasterT &m)
+	template<typename F>
+	void ForEach(F f)
+	{
+		for (auto &lane : lanes_)
+			f(*lane->master);
+	}
+
+	//f: void(TMasterT &m), slave not routed is ignored
+	template<typename F>
+	void Pull(uint8_t sid, F f)
+	{
+		int bus = routes_[sid];
+
+		if (bus >= 0) {
+			f(*lanes_[bus]->master);
+		}
+		else {
+			YMB_DEBUG("Slave %u is not routed!\n", sid);
+		}
+	}
+
+	//f: int(TMasterT &m)
+	template<typename F>
+	int Call(uint8_t sid, F f)
+	{
+		if (sid == kBroadcastId) //nothing can be read back, writes are by CallAsync
+			return -EINVAL;
+
+		int bus = routes_[sid];
+		if (bus < 0)
+			return bus;
+
+		return Exec(*lanes_[bus], f);
+	}
+
+	template<typename F>
+	int Exec(Lane &lane, F &f)
+	{
+		lane.outstanding++;
+		int ret = f(*lane.master);
+		lane.outstanding--;
+
+		return ret;
+	}
+
+	//f: int(TMasterT &m, Completion c)
+	template<typename F>
+	int CallAsync(uint8_t sid, Completion complete, F f)
+	{
+		if (sid == kBroadcastId)
+			return Broadcast(std::move(complete), f);
+
+		int bus = routes_[sid];
+		if (bus < 0)
+			return bus;
+
+		Lane *lane = lanes_[bus].get();
+
+		lane->outstanding++;
+		complete.Then(&Lane::Done, lane);
+		int ret = f(*lane->master, std::move(complete));
+		if (ret < 0) //complete will not be called
+			lane->outstanding--;
+
+		return ret;
+	}
+
+	//Queued to all of buses at once, complete is called after the last
+	//one, unless none of them is queued
+	template<typename F>
+	int Broadcast(Completion complete, F &f)
+	{
+		auto fanout = std::make_shared<Fanout>();
+		size_t queued = 0;
+		int err = -ENXIO; //no bus
+
+		fanout->left = lanes_.size() + 1;
+		fanout->complete = std::move(complete);
+
+		for (auto &pl : lanes_) {
+			Lane *lane = pl.get();
+
+			lane->outstanding++;
+			int ret = f(*lane->master, [lane, fanout](int ret, const uint8_t*) {
+				if (ret < 0)
+					fanout->err = ret;
+				Done(*fanout);
+				lane->outstanding--;
+			});
+			if (ret < 0) { //complete will not be called
+				lane->outstanding--;
+				fanout->err = err = ret;
+				fanout->left--;
+			}
+			else {
+				queued++;
+			}
+		}
+
+		if (queued == 0)
+			return err;
+
+		Done(*fanout);
+		return EOK;
+	}
+
+	static void Done(Fanout &fanout)
+	{
+		if (--fanout.left == 0 && fanout.complete)
+			fanout.complete(fanout.err, nullptr);
+	}
+
+	std::vector<std::unique_ptr<Lane>> lanes_;
+	std::atomic<int> routes_[256]; //bus of each slave, < 0 not routed
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBBUS_H__
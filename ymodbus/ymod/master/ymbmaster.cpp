@@ -5,6 +5,8 @@
 */
 #include "ymod/master/ymbmaster.h"
 #include "ymod/ymbtask.h"
+#include "ymod/ymbqueue.h"
+#include "ymod/ymbevent.h"
 
 #include "ymod/ymbnet.h"
 #include "ymod/ymbrtu.h"
@@ -13,11 +15,17 @@
 #include "ymod/master/ytcpconnect.h"
 #include "ymod/master/yserconnect.h"
 #include "ymod/master/yudpconnect.h"
+#include "ymod/master/ymbpipeline.h"
+#include "ymod/master/ymbrequest.h"
+#include "ymod/master/ymbquery.h"
+#include "ymod/master/ymbrtt.h"
+#include "ymod/master/ymbbreaker.h"
 
 #include "ymbopts.h"
 
-#include <queue>
 #include <mutex>
+#include <chrono>
+#include <thread>
 #include <condition_variable>
 #include <cstring>
 
@@ -25,19 +33,12 @@ namespace YModbus {
 
 namespace {
 
-struct Request
-{
-	Request(MsgInf &i) : err(0), inf(i) {}
-	int err;	//error, api or logical error
-	MsgInf &inf; //modbus exception code is in inf.err
-	std::mutex mutex;
-	std::condition_variable cond;
-};
-typedef std::shared_ptr<Request> RequestPtr;
-
 const uint32_t kDefRetries = 3;
 const long kDefRdTimeout = 500; //ms
 const long kPerReadTimeout = 10; //ms
+const long kMinRdTimeout = 20; //ms, least adaptive timeout
+const uint32_t kDefWindow = 1;
+const long kDefTurnaround = 100; //ms, for serial line
 
 } //namespace {
 
@@ -47,14 +48,18 @@ public:
 	typedef Net<IProtocol> INet;
 	typedef Rtu<IProtocol> IRtu;
 	typedef Ascii<IProtocol> IAscii;
+	typedef Pipeline<IProtocol, IConnect, Transaction> IPipeline;
 
 	Impl(eThreadMode thrm)
 		: retries_(kDefRetries)
 		, rdto_(kDefRdTimeout)
+		, window_(kDefWindow)
+		, coalesce_(false)
+		, turnaround_(0)
 		, thrm_(thrm)
+		, rtt_(kMinRdTimeout)
 	{
-		if (thrm_ == TASK)
-			this->Start();
+		//Task is started by Master, after prot_, conn_ and pipeline_ are set
 	}
 
 	~Impl()
@@ -95,6 +100,23 @@ public:
 		return ret;
 	}
 
+	//Response is received into a buffer of the calling thread
+	int ReadView(MsgInf &inf, const uint8_t *&data)
+	{
+		static thread_local uint8_t viewbuf[kMaxMsgLen];
+
+		inf.pbuf = viewbuf;
+		inf.bufsiz = sizeof(viewbuf);
+
+		int ret = this->SendRequest(inf);
+		if (ret == 0 && inf.datalen != 0) { //received data
+			data = inf.databuf;
+			ret = inf.datalen;
+		}
+
+		return ret;
+	}
+
 	int Write(MsgInf &inf)
 	{
 		uint8_t sid = inf.id;
@@ -124,44 +146,98 @@ public:
 
 	int SendRequest(MsgInf &inf)
 	{
+		if (thrm_ == TASK) {
+			//发送请求, retried by master task
+			Request *req = pool_.Get(inf, nullptr);
+			if (req == nullptr) {
+				YMB_DEBUG("Too many requests pending!\n");
+				return error = -EBUSY;
+			}
+
+			if (int ret = queue_.Push(req)) {
+				YMB_DEBUG("Too many requests of priority %d!\n", req->prio);
+				pool_.Put(req);
+				return error = ret;
+			}
+			event_.Notify();
+
+			//等待执行, done is set before notify, no wakeup is lost
+			std::unique_lock<std::mutex> lockr(req->mutex);
+			req->cond.wait(lockr, [req] { return req->done; });
+			lockr.unlock();
+
+			//错误信息存放在线程局部变量
+			error = req->err;
+			inf = req->inf;
+			if (inf.pbuf == req->buf) { //datas are gone with the request
+				inf.pbuf = nullptr;
+				inf.bufsiz = 0;
+				inf.databuf = nullptr;
+				inf.datalen = 0;
+			}
+
+			pool_.Put(req);
+			return error;
+		}
+
 		uint32_t retry = 0;
-		error = -EFAULT;
 
-		do {
+		do { //POLL, execute poll diretctly
 		    if (retry != 0) {
                 YMB_DEBUG0("SendRequest retry %u\n", retry);
 		    }
-			if (thrm_ == TASK) {
-				if (auto req = std::make_shared<Request>(inf)) {
-					//发送请求
-					std::unique_lock<std::mutex> lockq(mutex_);
-					requests_.push(req);
-					cond_.notify_all();
-					lockq.unlock();
-
-					//等待执行
-					std::unique_lock<std::mutex> lockr(req->mutex);
-					req->cond.wait(lockr);
-
-					//错误信息存放在线程局部变量
-					error = req->err;
-				}
-			}
-			else { //POLL, execute poll diretctly
-				error = ExecPoll(inf);
-			}
-		} while (error != 0 && ++retry < retries_);
+			error = ExecPoll(inf, retry);
+		} while (IsRetryable(error) && ++retry < retries_);
 
 		return error;
 	}
 
+	//Wake up master task for the requests submitted without notify
+	void Notify(void)
+	{
+		if (thrm_ == TASK)
+			event_.Notify();
+	}
+
+	//notify: false, master task is woken up by the caller later
+	//return: = 0, OK, complete will be called later;
+	//return: < 0, errorcode, complete will not be called
+	int Submit(const MsgInf &inf, Completion complete, bool notify = true)
+	{
+		Request *req = pool_.Get(inf, std::move(complete));
+		if (req == nullptr) {
+			YMB_DEBUG("Too many requests pending!\n");
+			return -EBUSY;
+		}
+
+		if (thrm_ == TASK) {
+			if (int ret = queue_.Push(req)) {
+				YMB_DEBUG("Too many requests of priority %d!\n", req->prio);
+				pool_.Put(req);
+				return ret;
+			}
+			if (notify)
+				event_.Notify();
+		}
+		else { //POLL, execute poll diretctly
+			while (!Finish(req, ExecPoll(req->inf, req->tries)))
+				;
+		}
+
+		return EOK;
+	}
+
 	void PostQuery(const MsgInf &inf)
 	{
 		if (thrm_ == TASK) {
 			//提交查询，不需等待返回
-			std::unique_lock<std::mutex> lock(mutex_);
-			querys_.push(inf);
-			cond_.notify_all();
+			if (querys_.Push(inf)) {
+				event_.Notify();
+			}
+			else {
+				YMB_DEBUG("Too many querys pending!\n");
+				error = -EBUSY;
+			}
 		}
 		else {
 			//POLL mode, also need waiting for result, but only execute once
@@ -172,13 +248,21 @@ public:
 	const long perto_ = kPerReadTimeout; //ms 每次接收超时
 	uint32_t retries_;
 	long rdto_; //read timeout
+	uint32_t window_; //max outstanding requests
+	bool coalesce_; //merge single writes
+	long turnaround_; //ms, delay after broadcast
 	eThreadMode thrm_;
+	RttTable rtt_; //timeout of each slave
+	Breaker breaker_; //health of each slave
+	RequestQueue queue_; //requests by priority
 	uint8_t msgbuf_[kMaxMsgLen];
 
 	std::weak_ptr<IMonitor> monitor_;
 	std::weak_ptr<IStore> store_;
 	std::unique_ptr<IProtocol> prot_;
 	std::unique_ptr<IConnect> conn_;
+	std::unique_ptr<IPipeline> pipeline_; //created with prot_ and conn_
+	QueryList pending_; //querys fetched by master task
 	std::string desc_;
 	static thread_local int error; //TMaster api operate error
 
@@ -187,19 +271,30 @@ protected:
 	std::string Name(void) override { return "Master Task"; }
 
 private:
-	int ExecPoll(MsgInf &inf);
-	int SendRecv(MsgInf &inf);
-
-	std::queue<RequestPtr> requests_;
-	std::queue<MsgInf> querys_;
-
-	std::mutex mutex_;
-	std::condition_variable cond_;
+	int ExecPoll(MsgInf &inf, uint32_t tries = 0);
+	int SendRecv(MsgInf &inf, uint32_t tries);
+	int SendBroadcast(MsgInf &inf);
+	int RecvSlaveMsg(MsgInf &inf, long rdto, size_t &msglen);
+	void UpdateSlave(uint8_t sid, uint32_t tries, int err, long rtt);
+	void UpdateStore(const MsgInf &inf);
+	bool Pipelined(void);
+	void RunPipeline(void);
+	bool Schedule(Request *&req);
+	bool Finish(Request *req, int err);
+	void Complete(Request *req);
+
+	bool FetchQuerys(void);
+	int ExecQuery(const Query &q);
+	void FinishQuery(const Query &q, const MsgInf &inf, int err);
+
+	RequestPool pool_;
+	MpscQueue<MsgInf, kMaxQueryNum> querys_;
+	Event event_; //wake up master task
 };
 
 thread_local int Master::Impl::error = 0;
 
-int Master::Impl::ExecPoll(MsgInf &inf)
+int Master::Impl::ExecPoll(MsgInf &inf, uint32_t tries)
 {
 	bool bInnerBuf;
 
@@ -213,10 +308,24 @@ int Master::Impl::ExecPoll(MsgInf &inf)
 		bInnerBuf = false;
 	}
 
-	int ret = SendRecv(inf);
+	int ret = SendRecv(inf, tries);
+
+	if (ret == EOK)
+		UpdateStore(inf);
+
+	if (bInnerBuf) {
+		inf.pbuf = nullptr;
+		inf.bufsiz = 0;
+	}
+
+	return ret;
+}
+
+void Master::Impl::UpdateStore(const MsgInf &inf)
+{
 	auto store = store_.lock();
 
-	if (ret == EOK && inf.datalen != 0 && store) {
+	if (inf.datalen != 0 && store) {
 		YMB_ASSERT(inf.databuf != nullptr);
 		if (inf.fun == kFunReadCoils
 			|| inf.fun == kFunReadDiscreteInputs) { //bit
@@ -230,99 +339,334 @@ int Master::Impl::ExecPoll(MsgInf &inf)
 			store->Set(inf.id, inf.rreg, inf.databuf, inf.rnum);
 		}
 	}
+}
 
-	if (bInnerBuf) {
-		inf.pbuf = nullptr;
-		inf.bufsiz = 0;
-	}
+//Move querys posted into pending list, merged if possible
+//return: true, some querys are pending
+bool Master::Impl::FetchQuerys(void)
+{
+	MsgInf inf;
+
+	while (!pending_.Full() && querys_.Pop(inf))
+		pending_.Add(inf);
+
+	return !pending_.Empty();
+}
+
+int Master::Impl::ExecQuery(const Query &q)
+{
+	MsgInf inf = q.inf;
+
+	inf.pbuf = msgbuf_;
+	inf.bufsiz = sizeof(msgbuf_);
+
+	int ret = SendRecv(inf, 0);
+	FinishQuery(q, inf, ret);
 
 	return ret;
 }
 
-int Master::Impl::SendRecv(MsgInf &inf)
+//inf: response of query
+void Master::Impl::FinishQuery(const Query &q, const MsgInf &inf, int err)
 {
+	if (err != EOK)
+		return;
+
+	if (inf.err != 0 && q.nparts > 1) { //merged read may be refused
+		YMB_DEBUG("Merged query exception %u, split it!\n", inf.err);
+		pending_.Split(q);
+		return;
+	}
+
+	if (inf.datalen != 0) {
+		ForEachQueryPart(q, inf, [this](const MsgInf &pinf) {
+			this->UpdateStore(pinf);
+		});
+	}
+}
+
+int Master::Impl::SendRecv(MsgInf &inf, uint32_t tries)
+{
+	if (inf.id == kBroadcastId)
+		return SendBroadcast(inf);
+
+	if (!breaker_.Allow(inf.id)) //suspended
+		return -EHOSTUNREACH;
+
 	if (!conn_->Validate())
 		return -ENOLINK;
 
 	YMB_ASSERT(inf.pbuf != nullptr);
 	size_t msglen = prot_->MakeMasterMsg(inf.pbuf, inf.bufsiz, inf);
 
+	uint8_t sid = inf.id;
+	long rdto = rtt_.Timeout(sid, tries, rdto_);
+
 	conn_->Purge(); //清空buffer
 
 	YMB_HEXDUMP0(inf.pbuf, msglen, "send: ");
 	if (!conn_->Send(inf.pbuf, msglen))
 		return -ENETRESET;
 
+	int64_t sent = RttTable::Now();
+
 	if (auto monitor = monitor_.lock())
 		monitor->SendPacket(desc_, inf.pbuf, static_cast<int>(msglen));
 
+	int ret = RecvSlaveMsg(inf, rdto, msglen);
+	conn_->SetTimeout(perto_); //for pipeline
+
+	UpdateSlave(sid, tries, ret, static_cast<long>(RttTable::Now() - sent));
+	if (ret != EOK)
+		return ret;
+
+	if (auto monitor = monitor_.lock())
+		monitor->RecvPacket(desc_, inf.pbuf, static_cast<int>(msglen));
+
+	return prot_->ParseSlaveMsg(inf.pbuf, msglen, inf);
+}
+
+//Broadcast is not answered, return after the msg sent and the
+//turnaround delay elapsed, the next request is not sent before it
+//return: = 0, OK, msg has been sent; < 0, errorcode
+int Master::Impl::SendBroadcast(MsgInf &inf)
+{
+	const FunDesc &desc = GetFunDesc(inf.fun);
+	if (!desc.supported || desc.bits != 0) //nothing can be read back
+		return -EINVAL;
+
+	if (!conn_->Validate())
+		return -ENOLINK;
+
+	YMB_ASSERT(inf.pbuf != nullptr);
+	size_t msglen = prot_->MakeMasterMsg(inf.pbuf, inf.bufsiz, inf);
+
+	if (!conn_->Send(inf.pbuf, msglen))
+		return -ENETRESET;
+
+	if (auto monitor = monitor_.lock())
+		monitor->SendPacket(desc_, inf.pbuf, static_cast<int>(msglen));
+
+	if (turnaround_ > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(turnaround_));
+
+	//as if answered with the request, nothing to update to the store
+	inf.databuf = nullptr;
+	inf.datalen = 0;
+
+	return EOK;
+}
+
+//Receive the response before the deadline, return as soon as the bytes
+//predicted by the request(Rtu), or expected by VerifySlaveMsg arrived
+//rdto: ms, read timeout
+//msglen: length of the response
+//return: = 0, OK, msg arrived; < 0, errorcode
+int Master::Impl::RecvSlaveMsg(MsgInf &inf, long rdto, size_t &msglen)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(rdto);
+	int expect = prot_->ExpectSlaveMsgLen(inf); //predicted by request
+	int need = expect > 0 ? expect : prot_->VerifySlaveMsg(inf.pbuf, 0);
+	Crc16Context crc; //of the bytes arrived(Rtu)
+
 	msglen = 0;
-	for (long to = 0; to < rdto_; to += perto_) { //timeout
-		int ret = conn_->Recv(inf.pbuf + msglen, inf.bufsiz - msglen);
-		if (ret > 0) { //received some data
-		    YMB_HEXDUMP0(inf.pbuf + msglen, ret, "recv: ");
-			msglen += ret;
-			ret = prot_->VerifySlaveMsg(inf.pbuf, msglen);
-			if (ret == EOK) { //OK, msg arrived
-				if (auto monitor = monitor_.lock())
-					monitor->RecvPacket(desc_, inf.pbuf, static_cast<int>(msglen));
-				return prot_->ParseSlaveMsg(inf.pbuf, msglen, inf);
-			}
-			if (ret < 0) //msg error
-				return -EBADMSG;
-		}
+	while (need > 0) {
+		auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+			deadline - Clock::now()).count();
+		if (left <= 0) //timeout
+			return -EBUSY;
+
+		if (msglen + need > inf.bufsiz)
+			return -EBADMSG;
+
+		conn_->SetTimeout(static_cast<long>((left + 999) / 1000));
+		int ret = conn_->Recv(inf.pbuf + msglen, static_cast<size_t>(need));
 		if (ret < 0) //connect error
 			return -ENETRESET;
+		if (ret == 0) //nothing arrived
+			continue;
+
+		YMB_HEXDUMP0(inf.pbuf + msglen, ret, "recv: ");
+		msglen += ret;
+		need = prot_->VerifySlaveMsg(inf.pbuf, msglen, crc);
+		if (need == EOK) { //OK, msg arrived
+			int tid = prot_->GetTransactionId(inf.pbuf, msglen);
+			if (tid >= 0 && tid != inf.tid) { //late response of the last try
+				msglen = 0;
+				crc.Reset();
+				need = prot_->VerifySlaveMsg(inf.pbuf, 0);
+			}
+		}
 	}
 
-	return -EBUSY;
+	return need == EOK ? EOK : -EBADMSG;
+}
+
+//Track the response time and health of slave with the result of a try
+void Master::Impl::UpdateSlave(uint8_t sid, uint32_t tries, int err, long rtt)
+{
+	if (err == EOK) {
+		rtt_.Sample(sid, tries, rtt);
+		breaker_.Success(sid);
+	}
+	else if (err == -EBUSY) { //timeout
+		rtt_.Expire(sid);
+		breaker_.Failure(sid);
+	}
 }
 
 void Master::Impl::Run(void)
 {
+	Request *req;
+
 	while (this->IsRunning()) {
 		//等待操作通知
-		std::unique_lock<std::mutex> lock(mutex_);
-		cond_.wait_for(lock, std::chrono::seconds(1));
-
-		while (!requests_.empty() || !querys_.empty()) {
-			if (!requests_.empty()) { //始终优先执行请求命令
-				auto req = requests_.front();
-				lock.unlock();
+		if (pipeline_->Empty() && pending_.Empty()) {
+			event_.WaitFor(1000, [this] {
+				return !queue_.Empty() || !querys_.Empty();
+			});
+		}
 
-				req->err = ExecPoll(req->inf);
-				req->cond.notify_all();
+		if (Pipelined()) {
+			RunPipeline();
+			continue;
+		}
 
-				lock.lock();
-				requests_.pop();
+		while (Schedule(req)) {
+			if (req != nullptr) {
+				if (!Finish(req, ExecPoll(req->inf, req->tries)))
+					queue_.Retry(req);
 			}
-			else if (!querys_.empty()) {
-				auto &inf = querys_.front();
-				lock.unlock();
-
-				ExecPoll(inf);
-
-				lock.lock();
-				querys_.pop();
-			}
-			else {
-				; //assert(false);
+			else { //query
+				Query q = pending_.Front();
+				pending_.Pop();
+				ExecQuery(q);
 			}
 		}
 	}
 
 	//完成所有等待的请求
-	std::unique_lock<std::mutex> lock(mutex_);
-	while (!requests_.empty()) {
-		auto req = requests_.front();
-		lock.unlock();
+	while (!pipeline_->Empty())
+		RunPipeline();
+
+	while (queue_.Pop(req, false)) {
+		if (!Finish(req, ExecPoll(req->inf, req->tries)))
+			queue_.Retry(req);
+	}
+}
 
-		req->err = ExecPoll(req->inf);
+//Retry or complete the executed request
+//return: true, request is completed; false, request need to retry
+bool Master::Impl::Finish(Request *req, int err)
+{
+	if (IsRetryable(err) && ++req->tries < retries_) {
+		YMB_DEBUG0("SendRequest retry %u\n", req->tries);
+		req->inf = req->ask;
+		return false;
+	}
+
+	req->err = err;
+
+	if (req->group != nullptr) { //merged writes, complete each of them
+		SplitWrites(queue_, *req, -EBADF, [this](Request *r) { this->Complete(r); });
+		pool_.Put(req);
+	}
+	else {
+		Complete(req);
+	}
+
+	return true;
+}
+
+//Pass the result to the caller
+void Master::Impl::Complete(Request *req)
+{
+	if (req->complete) { //asynchronous request, return it to pool
+		int ret = GetRequestResult(*req, -EBADF);
+		req->complete(ret, ret > 0 ? req->inf.databuf : nullptr);
+		pool_.Put(req);
+	}
+	else { //synchronous request, wake up the caller
+		std::unique_lock<std::mutex> lock(req->mutex);
+		req->done = true;
 		req->cond.notify_all();
+	}
+}
+
+//Pick the next one to execute, requests expired are completed here
+//return: true, req to execute, or a query if req is nullptr
+bool Master::Impl::Schedule(Request *&req)
+{
+	while (queue_.Pop(req, FetchQuerys())) {
+		if (req == nullptr) //query
+			return true;
+
+		if (!req->Expired()) {
+			if (coalesce_)
+				req = CoalesceWrites(queue_, pool_, req);
+			return true;
+		}
+
+		YMB_DEBUG0("Request expired before sent!\n");
+		Finish(req, -ETIMEDOUT);
+	}
+
+	return false;
+}
+
+bool Master::Impl::Pipelined(void)
+{
+	return (window_ > 1 && pipeline_->Supported()) || !pipeline_->Empty();
+}
+
+//Keep the window full of requests, then receive the responses
+void Master::Impl::RunPipeline(void)
+{
+	Transaction t;
 
-		lock.lock();
-		requests_.pop();
+	while (!pipeline_->Full(window_)) {
+		if (!Schedule(t.req)) {
+			break;
+		}
+		else if (t.req != nullptr && t.req->ask.id == kBroadcastId) {
+			if (!Finish(t.req, SendBroadcast(t.req->inf))) //not outstanding
+				queue_.Retry(t.req);
+		}
+		else if (t.req != nullptr) {
+			int err = !breaker_.Allow(t.req->ask.id) ? -EHOSTUNREACH
+				: pipeline_->Send(t.req->inf, t,
+					rtt_.Timeout(t.req->ask.id, t.req->tries, rdto_));
+			if (err != EOK && !Finish(t.req, err))
+				queue_.Retry(t.req);
+		}
+		else { //query
+			t.query = pending_.Front();
+			pending_.Pop();
+			if (t.query.inf.id != kBroadcastId && breaker_.Allow(t.query.inf.id))
+				pipeline_->Send(t.query.inf, t, rtt_.Timeout(t.query.inf.id, 0, rdto_));
+		}
 	}
+
+	if (pipeline_->Empty())
+		return;
+
+	pipeline_->Recv([this](MsgInf &inf, Transaction &t, int err, long rtt) {
+		if (t.req == nullptr) { //query
+			this->UpdateSlave(t.query.inf.id, 0, err, rtt);
+			this->FinishQuery(t.query, inf, err);
+			return;
+		}
+
+		this->UpdateSlave(t.req->ask.id, t.req->tries, err, rtt);
+		if (err == EOK)
+			this->UpdateStore(inf);
+
+		t.req->inf = inf;
+		if (!this->Finish(t.req, err))
+			this->queue_.Retry(t.req);
+	});
 }
 
 //Master api implementation
@@ -362,7 +706,13 @@ Master::Master(const std::string &ip, uint16_t port,
 
 	impl_->conn_->SetTimeout(impl_->perto_);
 	impl_->conn_->Validate();
+	impl_->pipeline_ = std::make_unique<Impl::IPipeline>(
+		*impl_->prot_, *impl_->conn_);
+	impl_->turnaround_ = impl_->pipeline_->Supported() ? 0 : kDefTurnaround;
 	impl_->desc_ = ip + ":" + std::to_string(port);
+
+	if (impl_->thrm_ == TASK)
+		impl_->Start();
 }
 
 Master::Master(const std::string &com, uint32_t baudrate,
@@ -387,7 +737,13 @@ Master::Master(const std::string &com, uint32_t baudrate,
 
 	impl_->conn_->SetTimeout(impl_->perto_);
 	impl_->conn_->Validate();
+	impl_->pipeline_ = std::make_unique<Impl::IPipeline>(
+		*impl_->prot_, *impl_->conn_);
+	impl_->turnaround_ = impl_->pipeline_->Supported() ? 0 : kDefTurnaround;
 	impl_->desc_ = com;
+
+	if (impl_->thrm_ == TASK)
+		impl_->Start();
 }
 
 Master::~Master()
@@ -437,6 +793,122 @@ long Master::GetReadTimeout(void) const
 	return impl_->rdto_;
 }
 
+void Master::SetAdaptiveTimeout(bool adaptive)
+{
+	impl_->rtt_.SetAdaptive(adaptive);
+}
+
+bool Master::GetAdaptiveTimeout(void) const
+{
+	return impl_->rtt_.GetAdaptive();
+}
+
+void Master::SetRetryBackoff(bool backoff)
+{
+	impl_->rtt_.SetBackoff(backoff);
+}
+
+bool Master::GetRetryBackoff(void) const
+{
+	return impl_->rtt_.GetBackoff();
+}
+
+//threshold: consecutive timeouts to suspend a slave, 0: never
+//suspend: ms
+void Master::SetBreaker(uint32_t threshold, long suspend)
+{
+	impl_->breaker_.Set(threshold, suspend);
+}
+
+uint32_t Master::GetBreakerThreshold(void) const
+{
+	return impl_->breaker_.GetThreshold();
+}
+
+long Master::GetBreakerSuspend(void) const
+{
+	return impl_->breaker_.GetSuspend();
+}
+
+bool Master::IsSuspended(uint8_t sid) const
+{
+	return impl_->breaker_.Suspended(sid);
+}
+
+void Master::SetQueueDepth(ePriority prio, size_t depth)
+{
+	impl_->queue_.SetDepth(prio, depth);
+}
+
+size_t Master::GetQueueDepth(ePriority prio) const
+{
+	return impl_->queue_.GetDepth(prio);
+}
+
+void Master::SetWeight(ePriority prio, uint32_t weight)
+{
+	impl_->queue_.SetWeight(prio, weight);
+}
+
+uint32_t Master::GetWeight(ePriority prio) const
+{
+	return impl_->queue_.GetWeight(prio);
+}
+
+size_t Master::GetPending(ePriority prio) const
+{
+	return impl_->queue_.GetPending(prio);
+}
+
+//window: max requests on the wire
+void Master::SetWindow(uint32_t window)
+{
+	impl_->window_ = window != 0 ? window : 1;
+}
+
+uint32_t Master::GetWindow(void) const
+{
+	return impl_->window_;
+}
+
+//delay: ms, turnaround delay after a broadcast
+void Master::SetTurnaroundDelay(long delay)
+{
+	impl_->turnaround_ = delay > 0 ? delay : 0;
+}
+
+long Master::GetTurnaroundDelay(void) const
+{
+	return impl_->turnaround_;
+}
+
+//coalesce: merge single writes to contiguous addresses
+void Master::SetWriteCoalescing(bool coalesce)
+{
+	impl_->coalesce_ = coalesce;
+}
+
+bool Master::GetWriteCoalescing(void) const
+{
+	return impl_->coalesce_;
+}
+
+//gap: registers(coils) between Pull* merged into one read
+void Master::SetQueryGap(uint16_t gap)
+{
+	impl_->pending_.SetGap(gap);
+}
+
+uint16_t Master::GetQueryGap(void) const
+{
+	return impl_->pending_.GetGap();
+}
+
+uint64_t Master::GetAbsorbedQuerys(void) const
+{
+	return impl_->pending_.GetAbsorbed();
+}
+
 //错误信息
 int Master::GetLastError(void) const
 {
@@ -512,6 +984,19 @@ int Master::ReadHoldingRegisters(uint8_t sid,
 	return impl_->Read(inf, buf, bufsiz);
 }
 
+//data: net order, valid until the next ReadView of this thread
+int Master::ReadView(uint8_t sid, uint8_t fun, uint16_t reg, uint16_t num,
+	const uint8_t *&data)
+{
+	data = nullptr;
+	if (fun < kFunReadCoils || fun > kFunReadInputRegisters)
+		return -EINVAL;
+
+	MsgInf inf = { sid, fun, reg, num };
+
+	return impl_->ReadView(inf, data);
+}
+
 //return: = 0, OK;
 //return: < 0, errorcode of exception
 //values: data value, net order
@@ -588,6 +1073,118 @@ int Master::WriteReadRegisters(uint8_t sid,
 	return impl_->Read(inf, buf, bufsiz);
 }
 
+//Asynchronous api, return without waiting for the response
+//return: = 0, OK, complete will be called in master task thread,
+//or before return in POLL mode;
+//return: < 0, errorcode, complete will not be called
+int Master::ReadCoilsAsync(uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Submit({ sid, kFunReadCoils, reg, num },
+		std::move(complete));
+}
+
+int Master::ReadDiscreteInputsAsync(uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Submit({ sid, kFunReadDiscreteInputs, reg, num },
+		std::move(complete));
+}
+
+int Master::ReadInputRegistersAsync(uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Submit({ sid, kFunReadInputRegisters, reg, num },
+		std::move(complete));
+}
+
+int Master::ReadHoldingRegistersAsync(uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Submit({ sid, kFunReadHoldingRegisters, reg, num },
+		std::move(complete));
+}
+
+int Master::WriteSingleCoilAsync(uint8_t sid,
+	uint16_t reg, bool onoff, Completion complete)
+{
+	uint8_t databuf[] = {
+		static_cast<uint8_t>(onoff ? 0xff : 0x00),
+		0x00
+	};
+	MsgInf inf = { sid, kFunWriteSingleCoil, 0, 0, reg, 1, databuf, 2 };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+int Master::WriteCoilsAsync(uint8_t sid, uint16_t reg, uint16_t num,
+	const uint8_t *bits, uint8_t wbytes, Completion complete)
+{
+	MsgInf inf = { sid, kFunWriteMultiCoils, 0, 0, reg, num,
+		const_cast<uint8_t*>(bits), wbytes };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+int Master::WriteSingleRegisterAsync(uint8_t sid,
+	uint16_t reg, uint16_t value, Completion complete)
+{
+	uint8_t databuf[] = {
+		static_cast<uint8_t>(value >> 8),
+		static_cast<uint8_t>(value & 0xff)
+	};
+	MsgInf inf = { sid, kFunWriteSingleRegister, 0, 0, reg, 1, databuf, 2 };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+int Master::WriteRegistersAsync(uint8_t sid, uint16_t reg, uint16_t num,
+	const uint8_t *values, uint8_t wbytes, Completion complete)
+{
+	MsgInf inf = { sid, kFunWriteMultiRegisters, 0, 0, reg, num,
+		const_cast<uint8_t*>(values), wbytes };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+int Master::MaskWriteRegistersAsync(uint8_t sid, uint16_t reg,
+	uint16_t andmask, uint16_t ormask, Completion complete)
+{
+	uint8_t databuf[] = {
+		static_cast<uint8_t>(andmask >> 8),
+		static_cast<uint8_t>(andmask & 0xff),
+		static_cast<uint8_t>(ormask >> 8),
+		static_cast<uint8_t>(ormask & 0xff)
+	};
+	MsgInf inf = { sid, kFunMaskWriteRegister, 0, 0, reg, 1, databuf, 4 };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+int Master::WriteReadRegistersAsync(uint8_t sid,
+	uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
+	uint16_t rreg, uint16_t rnum, Completion complete)
+{
+	MsgInf inf = { sid, kFunWriteAndReadRegisters, rreg, rnum, wreg, wnum,
+		const_cast<uint8_t*>(values), wbytes };
+
+	return impl_->Submit(inf, std::move(complete));
+}
+
+//results: >= 0, bytes read of each spec; < 0, errorcode
+//return: blocks read
+int Master::ReadBatch(const std::vector<ReadSpec> &specs, std::vector<int> &results)
+{
+	Impl *impl = impl_.get();
+
+	return ExecBatch(specs, results,
+		[impl](const MsgInf &inf, Completion complete) {
+		return impl->Submit(inf, std::move(complete), false);
+	}, [impl] {
+		impl->Notify();
+	});
+}
+
 //return: >= 0, OK
 //return: < 0,  errorcode of exception
 int Master::ReportSlaveId(uint8_t /* maxsid */, uint8_t * /* buf */, size_t /* bufsiz*/)
@@ -7,6 +7,7 @@
 #define __YMODBUS_YMBMASTER_H__
 
 #include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
 #include "ymod/ymbstore.h"
 #include "ymod/ymbmonitor.h"
 #include "ymod/ymbplayer.h"
@@ -48,6 +49,63 @@ public:
 	void SetReadTimeout(long rdto);
 	long GetReadTimeout(void) const;
 
+	//adaptive: timeout of each slave is estimated from its response
+	//time, and limited by the read timeout
+	void SetAdaptiveTimeout(bool adaptive);
+	bool GetAdaptiveTimeout(void) const;
+
+	//backoff: double the adaptive timeout on each retry
+	void SetRetryBackoff(bool backoff);
+	bool GetRetryBackoff(void) const;
+
+	//threshold: consecutive timeouts to suspend a slave, 0: never
+	//suspend: ms, the suspended slave is probed after it, doubled on
+	//each failed probe. Requests to a suspended slave fail at once
+	//with -EHOSTUNREACH.
+	void SetBreaker(uint32_t threshold, long suspend);
+	uint32_t GetBreakerThreshold(void) const;
+	long GetBreakerSuspend(void) const;
+	bool IsSuspended(uint8_t sid) const;
+
+	//Requests are scheduled by priority, set by RequestScope of the
+	//calling thread. PRIO_ALARM goes first, the others share the bus
+	//by weight. Pull* querys are PRIO_BULK.
+	//depth: max requests of the priority pending, beyond it they fail
+	//at once with -ENOBUFS
+	void SetQueueDepth(ePriority prio, size_t depth);
+	size_t GetQueueDepth(ePriority prio) const;
+	void SetWeight(ePriority prio, uint32_t weight);
+	uint32_t GetWeight(ePriority prio) const;
+	size_t GetPending(ePriority prio) const;
+
+	//window: max requests on the wire, 1 ~ kMaxPipelineWindow
+	//Only for TASK mode and protocols with transaction id(TCP/UDP),
+	//other protocols always send the next request after response.
+	void SetWindow(uint32_t window);
+	uint32_t GetWindow(void) const;
+
+	//delay: ms, turnaround delay after a broadcast(slave id 0) sent,
+	//time for the slaves to process it. Broadcast is not answered, so
+	//writes to id 0 return after it, reads to id 0 fail with -EINVAL.
+	//Default 0 for protocols with transaction id(TCP/UDP), else 100.
+	void SetTurnaroundDelay(long delay);
+	long GetTurnaroundDelay(void) const;
+
+	//coalesce: single writes(WriteSingleRegister/WriteSingleCoil) pending
+	//to contiguous addresses of a slave are merged into one multiple
+	//write, each writer still gets its result. Only for TASK mode.
+	void SetWriteCoalescing(bool coalesce);
+	bool GetWriteCoalescing(void) const;
+
+	//gap: Pull* of the same slave and function are merged into one read,
+	//if registers(coils) between them are not more than gap.
+	//Adjacent or overlapping Pull* are always merged.
+	void SetQueryGap(uint16_t gap);
+	uint16_t GetQueryGap(void) const;
+
+	//return: Pull* absorbed by the identical one not sent yet
+	uint64_t GetAbsorbedQuerys(void) const;
+
 	//错误信息，线程相关，每个线程独立
 	int GetLastError(void) const;
 	std::string GetErrorString(int err) const;
@@ -75,6 +133,14 @@ public:
 	virtual int ReadHoldingRegisters(uint8_t sid,
 		uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz);
 
+	//Read without copy, the response is received into a buffer of the
+	//calling thread, and data points to the datas in it
+	//fun: kFunReadCoils ~ kFunReadInputRegisters
+	//data: net order, valid until the next ReadView of this thread
+	//return: >= 0, bytes of data; < 0, errorcode
+	int ReadView(uint8_t sid, uint8_t fun, uint16_t reg, uint16_t num,
+		const uint8_t *&data);
+
 	//return: = 0, OK; 
 	//return: < 0, errorcode of exception
 	//values: data value, net order
@@ -95,6 +161,41 @@ public:
 		uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
 		uint16_t rreg, uint16_t rnum, uint8_t *buf, size_t bufsiz);
 
+	//Asynchronous api, return without waiting for the response
+	//return: = 0, OK, complete will be called in master task thread,
+	//or before return in POLL mode;
+	//return: < 0, errorcode, complete will not be called
+	//complete: result of the request, see Completion
+	int ReadCoilsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadDiscreteInputsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadInputRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadHoldingRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+
+	int WriteSingleCoilAsync(uint8_t sid,
+		uint16_t reg, bool onoff, Completion complete);
+	int WriteCoilsAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *bits, uint8_t wbytes, Completion complete);
+	int WriteSingleRegisterAsync(uint8_t sid,
+		uint16_t reg, uint16_t value, Completion complete);
+	int WriteRegistersAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *values, uint8_t wbytes, Completion complete);
+	int MaskWriteRegistersAsync(uint8_t sid, uint16_t reg,
+		uint16_t andmask, uint16_t ormask, Completion complete);
+	int WriteReadRegistersAsync(uint8_t sid,
+		uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
+		uint16_t rreg, uint16_t rnum, Completion complete);
+
+	//Read many blocks in one call, they are queued together and the
+	//caller is woken up once when all are completed. Blocks are
+	//pipelined as SetWindow, or executed back to back.
+	//results: >= 0, bytes read into buf of each spec; < 0, errorcode
+	//return: blocks read
+	int ReadBatch(const std::vector<ReadSpec> &specs, std::vector<int> &results);
+
 	//return: >= 0, OK
 	//return: < 0,  errorcode of exception
 	virtual int ReportSlaveId(uint8_t maxsid, uint8_t *buf, size_t bufsiz);
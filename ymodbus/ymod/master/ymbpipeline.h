@@ -0,0 +1,240 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBPIPELINE_H__
+#define __YMODBUS_YMBPIPELINE_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbprot.h"
+#include "ymblog.h"
+#include "ymbopts.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+namespace YModbus {
+
+//Outstanding transactions of one master connection.
+//Responses are matched to requests by transaction id, so more than one
+//request may be on the wire. Protocols without transaction id(Rtu/Ascii)
+//are not surpported, see Supported.
+//TProtocol: {MNet, MRtu, MAscii, IProtocol}
+//TConnect: {TcpConnect, SerConnect, UdpConnect, IConnect}
+//TContext: data of the owner for each transaction, returned on completion
+template<typename TProtocol, typename TConnect, typename TContext>
+class Pipeline
+{
+public:
+	Pipeline(TProtocol &prot, TConnect &conn)
+		: prot_(prot)
+		, conn_(conn)
+		, slots_(kMaxPipelineWindow)
+		, busy_(0)
+		, rxlen_(0)
+	{
+	}
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline &operator = (const Pipeline&) = delete;
+
+	bool Supported(void)
+	{
+		uint8_t hdr[8] = { 0 };
+		return prot_.GetTransactionId(hdr, sizeof(hdr)) >= 0;
+	}
+
+	bool Empty(void) const { return busy_ == 0; }
+	bool Full(size_t window) const
+	{
+		return busy_ >= std::min(window, slots_.size());
+	}
+
+	//rdto: read timeout of the transaction, ms
+	//return: = 0, OK, msg has been sent;
+	//return: < 0, errorcode, the transaction is not outstanding
+	int Send(const MsgInf &inf, const TContext &ctx, long rdto);
+
+	//Receive responses, then complete the answered and the expired
+	//complete: void(MsgInf &inf, TContext &ctx, int err, long rtt)
+	//rtt: us, time from sending to completion
+	template<typename F>
+	void Recv(F complete);
+
+	//Complete all outstanding transactions with err
+	template<typename F>
+	void Abort(int err, F complete);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Slot
+	{
+		bool busy = false;
+		int tid = -1;
+		Clock::time_point sent;
+		long rdto = 0; //ms
+		MsgInf inf;
+		TContext ctx;
+		bool inner = false; //without pbuf, response is parsed in rxbuf_
+		uint8_t buf[kMaxMsgLen]; //for the msg without pbuf
+	};
+
+	Slot *Match(int tid);
+
+	template<typename F>
+	void Complete(Slot &slot, int err, F &complete);
+
+	TProtocol &prot_;
+	TConnect &conn_;
+
+	std::vector<Slot> slots_;
+	size_t busy_;
+
+	uint8_t rxbuf_[kMaxMsgLen * 2];
+	size_t rxlen_;
+};
+
+template<typename TProtocol, typename TConnect, typename TContext>
+int Pipeline<TProtocol, TConnect, TContext>::Send(const MsgInf &inf,
+	const TContext &ctx, long rdto)
+{
+	auto it = std::find_if(slots_.begin(), slots_.end(),
+		[](const Slot &s) { return !s.busy; });
+	if (it == slots_.end())
+		return -EBUSY;
+
+	if (!conn_.Validate())
+		return -ENOLINK;
+
+	Slot &slot = *it;
+	slot.inf = inf;
+	slot.inner = slot.inf.pbuf == nullptr;
+	if (slot.inner) {
+		slot.inf.pbuf = slot.buf;
+		slot.inf.bufsiz = sizeof(slot.buf);
+	}
+
+	YMB_ASSERT(slot.inf.bufsiz >= kMaxMsgLen);
+	size_t msglen = prot_.MakeMasterMsg(slot.inf.pbuf, slot.inf.bufsiz, slot.inf);
+
+	if (busy_ == 0) { //Nothing on the wire, 清空buffer
+		conn_.Purge();
+		rxlen_ = 0;
+	}
+
+	if (!conn_.Send(slot.inf.pbuf, msglen))
+		return -ENETRESET;
+
+	slot.tid = prot_.GetTransactionId(slot.inf.pbuf, msglen);
+	slot.sent = Clock::now();
+	slot.rdto = rdto;
+	slot.ctx = ctx;
+	slot.busy = true;
+	busy_++;
+
+	return EOK;
+}
+
+template<typename TProtocol, typename TConnect, typename TContext>
+template<typename F>
+void Pipeline<TProtocol, TConnect, TContext>::Recv(F complete)
+{
+	int ret = conn_.Recv(rxbuf_ + rxlen_, sizeof(rxbuf_) - rxlen_);
+	if (ret < 0) { //connect error
+		rxlen_ = 0;
+		Abort(-ENETRESET, complete);
+		return;
+	}
+
+	rxlen_ += static_cast<size_t>(ret);
+
+	//The stream may carry several responses, they are moved out at last
+	size_t off = 0;
+	int len;
+	while (off < rxlen_ && (len = GetSlaveMsgLen(prot_, rxbuf_ + off, rxlen_ - off)) != 0) {
+		uint8_t *msg = rxbuf_ + off;
+
+		if (len < 0) { //msg error, we can't find the next msg any more
+			YMB_HEXDUMP(msg, rxlen_ - off,
+				"Bad slave message! len = %u:", (unsigned)(rxlen_ - off));
+			off = rxlen_;
+			break;
+		}
+
+		Slot *slot = Match(prot_.GetTransactionId(msg, len));
+		if (slot != nullptr) {
+			if (slot->inner) //datas are only used in complete, not copied
+				slot->inf.pbuf = msg;
+			else
+				memcpy(slot->inf.pbuf, msg, len);
+			ret = prot_.ParseSlaveMsg(slot->inf.pbuf, len, slot->inf);
+			Complete(*slot, ret, complete);
+		}
+		else { //response of expired request
+			YMB_DEBUG("Pipeline: response of nobody, dropped.\n");
+		}
+
+		off += static_cast<size_t>(len);
+	}
+
+	rxlen_ -= off;
+	if (off != 0 && rxlen_ != 0)
+		memmove(rxbuf_, rxbuf_ + off, rxlen_);
+
+	auto now = Clock::now();
+	for (auto &slot : slots_) {
+		if (slot.busy && now - slot.sent >= std::chrono::milliseconds(slot.rdto))
+			Complete(slot, -EBUSY, complete); //timeout
+	}
+}
+
+template<typename TProtocol, typename TConnect, typename TContext>
+template<typename F>
+void Pipeline<TProtocol, TConnect, TContext>::Abort(int err, F complete)
+{
+	for (auto &slot : slots_) {
+		if (slot.busy)
+			Complete(slot, err, complete);
+	}
+}
+
+template<typename TProtocol, typename TConnect, typename TContext>
+typename Pipeline<TProtocol, TConnect, TContext>::Slot *
+Pipeline<TProtocol, TConnect, TContext>::Match(int tid)
+{
+	for (auto &slot : slots_) {
+		if (slot.busy && slot.tid == tid)
+			return &slot;
+	}
+
+	return nullptr;
+}
+
+template<typename TProtocol, typename TConnect, typename TContext>
+template<typename F>
+void Pipeline<TProtocol, TConnect, TContext>::Complete(Slot &slot,
+	int err, F &complete)
+{
+	if (slot.inner) { //inner buffer, datas are still valid
+		slot.inf.pbuf = nullptr;
+		slot.inf.bufsiz = 0;
+	}
+
+	long rtt = static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+		Clock::now() - slot.sent).count());
+
+	complete(slot.inf, slot.ctx, err, rtt);
+
+	slot.ctx = TContext();
+	slot.busy = false;
+	busy_--;
+}
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBPIPELINE_H__
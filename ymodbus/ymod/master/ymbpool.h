@@ -0,0 +1,157 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBPOOL_H__
+#define __YMODBUS_YMBPOOL_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/master/ymbrouter.h"
+#include "ymblog.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace YModbus {
+
+typedef enum {
+	SHARD_SLAVEID,	//slave id modulo connections, keeps order per slave
+	SHARD_LEAST,	//connection with least outstanding requests
+} eShardMode;
+
+//Some masters to the same endpoint, each with its own connection and
+//task. Gateways serving several sockets in parallel are used by all of
+//them at the same time. All of masters share one store.
+//TMasterT: {Master, TMaster<...>}, masters should be in TASK mode
+template<typename TMasterT>
+class MasterPool : public MasterRouter<TMasterT, MasterPool<TMasterT>>
+{
+public:
+	//num: connections, > 0
+	//args: arguments to construct each master
+	template<typename... Args>
+	MasterPool(size_t num, eShardMode shard, const Args&... args)
+		: shard_(shard)
+		, next_(0)
+	{
+		YMB_ASSERT(num != 0);
+
+		for (size_t i = 0; i < num; i++) {
+			slots_.emplace_back(new Slot);
+			slots_.back()->master.reset(new TMasterT(args...));
+		}
+	}
+
+	MasterPool() = delete;
+	MasterPool(const MasterPool&) = delete;
+	MasterPool &operator = (const MasterPool&) = delete;
+
+	size_t Size(void) const { return slots_.size(); }
+	TMasterT &GetMaster(size_t index) { return *slots_.at(index)->master; }
+
+	//outstanding requests of the connection, api calls not returned
+	uint32_t GetOutstanding(size_t index) const
+	{
+		return slots_.at(index)->outstanding.load();
+	}
+
+	void SetShardMode(eShardMode shard) { shard_ = shard; }
+	eShardMode GetShardMode(void) const { return shard_; }
+
+	//window: max requests on the wire of each connection
+	void SetWindow(uint32_t window)
+	{
+		ForEach([=](TMasterT &m) { m.SetWindow(window); });
+	}
+
+	uint32_t GetWindow(void) const
+	{
+		return Front().GetWindow();
+	}
+
+private:
+	friend class MasterRouter<TMasterT, MasterPool<TMasterT>>;
+
+	struct Slot
+	{
+		std::unique_ptr<TMasterT> master;
+		std::atomic<uint32_t> outstanding{ 0 };
+
+		//asynchronous request is completed, see Completion::Then
+		static void Done(void *slot) { static_cast<Slot*>(slot)->outstanding--; }
+	};
+
+	TMasterT &Front(void) const { return *slots_.front()->master; }
+
+	//f: void(TMasterT &m)
+	template<typename F>
+	void ForEach(F f)
+	{
+		for (auto &slot : slots_)
+			f(*slot->master);
+	}
+
+	//f: void(TMasterT &m)
+	template<typename F>
+	void Pull(uint8_t sid, F f)
+	{
+		f(*Pick(sid).master);
+	}
+
+	//Connection of the request to the slave
+	Slot &Pick(uint8_t sid)
+	{
+		if (shard_ == SHARD_SLAVEID)
+			return *slots_[sid % slots_.size()];
+
+		//least outstanding, ties are taken in turn
+		size_t start = next_++ % slots_.size();
+		Slot *least = slots_[start].get();
+		for (size_t i = 1; i < slots_.size() && least->outstanding != 0; i++) {
+			Slot *slot = slots_[(start + i) % slots_.size()].get();
+			if (slot->outstanding < least->outstanding)
+				least = slot;
+		}
+
+		return *least;
+	}
+
+	//f: int(TMasterT &m)
+	template<typename F>
+	int Call(uint8_t sid, F f)
+	{
+		Slot &slot = Pick(sid);
+
+		slot.outstanding++;
+		int ret = f(*slot.master);
+		slot.outstanding--;
+
+		return ret;
+	}
+
+	//f: int(TMasterT &m, Completion c)
+	template<typename F>
+	int CallAsync(uint8_t sid, Completion complete, F f)
+	{
+		Slot &slot = Pick(sid);
+
+		slot.outstanding++;
+		complete.Then(&Slot::Done, &slot);
+		int ret = f(*slot.master, std::move(complete));
+		if (ret < 0) //complete will not be called
+			slot.outstanding--;
+
+		return ret;
+	}
+
+	eShardMode shard_;
+	std::atomic<size_t> next_; //start of least outstanding search
+	std::vector<std::unique_ptr<Slot>> slots_;
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBPOOL_H__
@@ -0,0 +1,203 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBQUERY_H__
+#define __YMODBUS_YMBQUERY_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbprot.h"
+#include "ymblog.h"
+#include "ymbopts.h"
+
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+namespace YModbus {
+
+struct Request;
+
+//One read on the bus for some Pull* querys
+struct Query
+{
+	struct Part
+	{
+		uint16_t reg;
+		uint16_t num;
+	};
+
+	MsgInf inf;			//merged read
+	bool split = false;	//split from a failed merged read, never merge again
+	uint8_t nparts = 0;
+	Part parts[kMaxQueryParts]; //original querys
+};
+
+//Owner of one transaction of master, request or query
+struct Transaction
+{
+	Request *req = nullptr;
+	Query query;
+};
+
+inline bool IsBitFun(uint8_t fun)
+{
+	return fun == kFunReadCoils || fun == kFunReadDiscreteInputs;
+}
+
+//Pending querys of master task, only used in master task thread.
+//Querys of the same slave and function are merged into one read, if
+//they are adjacent or overlapping, or the gap between is not greater
+//than gap. The merged read is not greater than kMaxRegNum registers
+//or kMaxBitNum coils.
+//A query identical to a pending one(sid, fun, reg, num) is absorbed,
+//it would read the same datas at the same time, so polling faster than
+//the bus neither grows the list nor reads the block again.
+class QueryList
+{
+public:
+	QueryList() : gap_(0), absorbed_(0) {}
+
+	QueryList(const QueryList&) = delete;
+	QueryList &operator = (const QueryList&) = delete;
+
+	//gap: registers(coils) not queried, but may be read for merging
+	void SetGap(uint16_t gap) { gap_ = gap; }
+	uint16_t GetGap(void) const { return gap_; }
+
+	bool Empty(void) const { return querys_.empty(); }
+	bool Full(void) const { return querys_.size() >= kMaxQueryNum; }
+
+	Query &Front(void) { return querys_.front(); }
+	void Pop(void) { querys_.pop_front(); }
+
+	//return: false, absorbed by the identical one pending
+	bool Add(const MsgInf &inf)
+	{
+		Query *merged = nullptr;
+
+		for (auto &q : querys_) {
+			if (q.inf.id != inf.id || q.inf.fun != inf.fun)
+				continue;
+
+			for (uint8_t i = 0; i < q.nparts; i++) {
+				if (q.parts[i].reg == inf.rreg && q.parts[i].num == inf.rnum) {
+					absorbed_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+			}
+
+			if (merged == nullptr && CanMerge(q, inf))
+				merged = &q;
+		}
+
+		if (merged != nullptr) {
+			Merge(*merged, inf);
+			return true;
+		}
+
+		querys_.emplace_back();
+		Query &q = querys_.back();
+		q.inf = { inf.id, inf.fun, inf.rreg, inf.rnum };
+		q.parts[q.nparts++] = { inf.rreg, inf.rnum };
+
+		return true;
+	}
+
+	//Any thread
+	//return: querys absorbed since constructed
+	uint64_t GetAbsorbed(void) const
+	{
+		return absorbed_.load(std::memory_order_relaxed);
+	}
+
+	//Query again each original query of the failed merged read
+	void Split(const Query &merged)
+	{
+		for (int i = merged.nparts - 1; i >= 0; i--) {
+			querys_.emplace_front();
+			Query &q = querys_.front();
+			const Query::Part &part = merged.parts[i];
+			q.inf = { merged.inf.id, merged.inf.fun, part.reg, part.num };
+			q.split = true;
+			q.parts[q.nparts++] = part;
+		}
+	}
+
+private:
+	//q is of the same slave and function
+	bool CanMerge(const Query &q, const MsgInf &inf) const
+	{
+		if (q.split || q.nparts >= kMaxQueryParts)
+			return false;
+
+		uint32_t qend = q.inf.rreg + q.inf.rnum;
+		uint32_t iend = inf.rreg + inf.rnum;
+		uint32_t gap = inf.rreg > qend ? inf.rreg - qend
+			: (q.inf.rreg > iend ? q.inf.rreg - iend : 0);
+		uint32_t num = std::max(qend, iend) - std::min<uint32_t>(q.inf.rreg, inf.rreg);
+		uint32_t maxnum = IsBitFun(inf.fun) ? kMaxBitNum : kMaxRegNum;
+
+		return gap <= gap_ && num <= maxnum;
+	}
+
+	void Merge(Query &q, const MsgInf &inf)
+	{
+		uint32_t qend = q.inf.rreg + q.inf.rnum;
+		uint32_t iend = inf.rreg + inf.rnum;
+		uint32_t reg = std::min(q.inf.rreg, inf.rreg);
+
+		q.inf.rreg = static_cast<uint16_t>(reg);
+		q.inf.rnum = static_cast<uint16_t>(std::max(qend, iend) - reg);
+		q.parts[q.nparts++] = { inf.rreg, inf.rnum };
+	}
+
+	uint16_t gap_;
+	std::deque<Query> querys_;
+	std::atomic<uint64_t> absorbed_;
+};
+
+//Pass the datas of each original query to f
+//inf: response of the merged read
+//f: void(const MsgInf &inf)
+template<typename F>
+void ForEachQueryPart(const Query &q, const MsgInf &inf, F f)
+{
+	uint8_t bits[(kMaxBitNum + 7) / 8];
+	size_t datalen = IsBitFun(inf.fun) ? (q.inf.rnum + 7) / 8 : q.inf.rnum * 2;
+
+	if (inf.datalen < datalen) {
+		YMB_DEBUG("Query response is too short! %u < %u\n",
+			(unsigned)inf.datalen, (unsigned)datalen);
+		return;
+	}
+
+	for (uint8_t i = 0; i < q.nparts; i++) {
+		const Query::Part &part = q.parts[i];
+		uint16_t off = part.reg - q.inf.rreg;
+		MsgInf pinf = { inf.id, inf.fun, part.reg, part.num };
+
+		if (IsBitFun(inf.fun)) { //bit, shift to the first byte
+			pinf.datalen = static_cast<uint8_t>((part.num + 7) / 8);
+			memset(bits, 0, pinf.datalen);
+			for (uint16_t b = 0; b < part.num; b++) {
+				uint16_t pos = off + b;
+				if ((inf.databuf[pos / 8] >> (pos % 8)) & 0x1)
+					bits[b / 8] |= static_cast<uint8_t>(1 << (b % 8));
+			}
+			pinf.databuf = bits;
+		}
+		else { //register
+			pinf.datalen = static_cast<uint8_t>(part.num * 2);
+			pinf.databuf = inf.databuf + off * 2;
+		}
+
+		f(pinf);
+	}
+}
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBQUERY_H__
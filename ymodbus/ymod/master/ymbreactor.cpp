@@ -0,0 +1,667 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#include "ymod/master/ymbreactor.h"
+#include "ymod/ymbqueue.h"
+#include "ymod/ymbevent.h"
+#include "ymod/ymbtimer.h"
+
+#include "ymod/ymbnet.h"
+#include "ymod/ymbrtu.h"
+#include "ymod/ymbascii.h"
+
+#include "ymod/master/ytcpconnect.h"
+#include "ymod/master/yudpconnect.h"
+#include "ymod/master/ymbrequest.h"
+#include "ymod/master/ymbrtt.h"
+
+#include "ymblog.h"
+#include "ymbopts.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+
+namespace YModbus {
+
+namespace {
+
+const uint32_t kDefRetries = 3;
+const long kDefRdTimeout = 500; //ms
+const long kMinRdTimeout = 10; //ms, least adaptive timeout
+const long kTimerTick = 5; //ms
+const size_t kTimerSlots = 1024;
+const int kMaxEvents = 256;
+
+} //namespace {
+
+struct Reactor::Impl
+{
+	typedef Net<IProtocol> INet;
+	typedef Rtu<IProtocol> IRtu;
+	typedef Ascii<IProtocol> IAscii;
+
+	typedef enum {
+		CLOSED,
+		CONNECTING,	//stream connect is in progress
+		IDLE,
+		WAITING,	//request is on the wire
+	} eState;
+
+	//Transactions of one device, executed one by one
+	struct Endpoint
+	{
+		std::unique_ptr<IProtocol> prot;
+		std::unique_ptr<IConnect> conn;
+		bool stream = false;
+		eState state = CLOSED;
+		size_t rxlen = 0;
+		Crc16Context crc; //of the rxlen bytes(Rtu)
+		std::deque<Request*> requests; //front is executing
+		TimerWheel<Endpoint>::Timer timer;
+		RttTable rtt{ kMinRdTimeout }; //timeout of each slave
+		int64_t sent = 0; //us, the front is sent
+	};
+
+	struct Submit
+	{
+		Endpoint *ep;
+		Request *req;
+	};
+
+	Impl(eThreadMode thrm)
+		: retries_(kDefRetries)
+		, rdto_(kDefRdTimeout)
+		, thrm_(thrm)
+		, epfd_(epoll_create1(EPOLL_CLOEXEC))
+		, count_(0)
+		, endpoints_(kMaxEndpointNum)
+		, pool_(kMaxReactorRequestNum)
+		, wheel_(kTimerTick, kTimerSlots)
+	{
+		if (epfd_ < 0) {
+			YMB_ERROR("Reactor epoll failed! errno = %d\n", errno);
+			return;
+		}
+
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.ptr = nullptr; //event_
+		if (epoll_ctl(epfd_, EPOLL_CTL_ADD, event_.Handle(), &ev) != 0)
+			YMB_ERROR("Reactor add event failed! errno = %d\n", errno);
+	}
+
+	~Impl()
+	{
+		Submit s;
+		while (submits_.Pop(s)) //posted but not fetched, aborted below
+			s.ep->requests.push_back(s.req);
+
+		for (int i = 0; i < count_; i++)
+			Abort(*endpoints_[i], -ECANCELED);
+
+		if (epfd_ >= 0)
+			close(epfd_);
+	}
+
+	int Add(const std::string &ip, uint16_t port, eProtocol type);
+	int Post(int ep, const MsgInf &inf, Completion complete);
+	void Poll(long to);
+	void Abort(Endpoint &ep, int err);
+
+	uint32_t retries_;
+	long rdto_; //read timeout
+	bool adaptive_ = false; //for endpoints added later
+	bool backoff_ = false;
+	eThreadMode thrm_;
+	std::weak_ptr<IStore> store_;
+
+private:
+	bool Open(Endpoint &ep);
+	void Close(Endpoint &ep);
+	void Kick(Endpoint &ep);
+	void Finish(Endpoint &ep, int err);
+	void Fail(Endpoint &ep, int err);
+
+	void OnEvent(Endpoint &ep, uint32_t events);
+	void OnRead(Endpoint &ep);
+	void OnTimeout(Endpoint &ep);
+	void FetchSubmits(void);
+	void UpdateStore(const MsgInf &inf);
+
+	int epfd_;
+	std::mutex mutex_; //for adding endpoint
+	std::atomic<int> count_; //endpoints added
+	std::vector<std::unique_ptr<Endpoint>> endpoints_;
+
+	RequestPool pool_;
+	MpscQueue<Submit, kMaxReactorRequestNum> submits_;
+	Event event_; //wake up reactor
+	TimerWheel<Endpoint> wheel_;
+};
+
+int Reactor::Impl::Add(const std::string &ip, uint16_t port, eProtocol type)
+{
+	std::unique_ptr<Endpoint> ep = std::make_unique<Endpoint>();
+
+	switch (type) {
+	case TCP:
+		ep->prot = std::make_unique<INet>();
+		ep->conn = std::make_unique<TcpConnect>(ip, port);
+		ep->stream = true;
+		break;
+	case TCPRTU:
+		ep->prot = std::make_unique<IRtu>();
+		ep->conn = std::make_unique<TcpConnect>(ip, port);
+		ep->stream = true;
+		break;
+	case TCPASCII:
+		ep->prot = std::make_unique<IAscii>();
+		ep->conn = std::make_unique<TcpConnect>(ip, port);
+		ep->stream = true;
+		break;
+	case UDP:
+		ep->prot = std::make_unique<INet>();
+		ep->conn = std::make_unique<UdpConnect>(ip, port);
+		break;
+	case UDPRTU:
+		ep->prot = std::make_unique<IRtu>();
+		ep->conn = std::make_unique<UdpConnect>(ip, port);
+		break;
+	case UDPASCII:
+		ep->prot = std::make_unique<IAscii>();
+		ep->conn = std::make_unique<UdpConnect>(ip, port);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ep->conn->SetTimeout(0);
+	ep->conn->SetNonBlock(true);
+	ep->rtt.SetAdaptive(adaptive_);
+	ep->rtt.SetBackoff(backoff_);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	int id = count_.load();
+	if (static_cast<size_t>(id) >= endpoints_.size()) {
+		YMB_DEBUG("Too many endpoints of reactor!\n");
+		return -ENOMEM;
+	}
+
+	endpoints_[id] = std::move(ep);
+	count_.store(id + 1, std::memory_order_release); //publish it
+
+	return id;
+}
+
+int Reactor::Impl::Post(int ep, const MsgInf &inf, Completion complete)
+{
+	if (ep < 0 || ep >= count_.load(std::memory_order_acquire))
+		return -EINVAL;
+
+	Request *req = pool_.Get(inf, std::move(complete));
+	if (req == nullptr) {
+		YMB_DEBUG("Too many requests pending!\n");
+		return -EBUSY;
+	}
+
+	//never full, requests are less than the pool
+	submits_.Push({ endpoints_[ep].get(), req });
+	event_.Notify();
+
+	return EOK;
+}
+
+void Reactor::Impl::Poll(long to)
+{
+	struct epoll_event events[kMaxEvents];
+
+	event_.Arm();
+	FetchSubmits();
+
+	if (!wheel_.Empty() && to > wheel_.GetTick())
+		to = wheel_.GetTick();
+
+	int n = epoll_wait(epfd_, events, kMaxEvents, static_cast<int>(to));
+	event_.Disarm();
+
+	for (int i = 0; i < n; i++) {
+		if (events[i].data.ptr != nullptr)
+			OnEvent(*static_cast<Endpoint*>(events[i].data.ptr), events[i].events);
+	}
+
+	FetchSubmits();
+	wheel_.Expire([this](Endpoint *ep) { this->OnTimeout(*ep); });
+}
+
+//Move the submitted requests to their endpoints
+void Reactor::Impl::FetchSubmits(void)
+{
+	Submit s;
+
+	while (submits_.Pop(s)) {
+		s.ep->requests.push_back(s.req);
+		if (s.ep->requests.size() == 1)
+			Kick(*s.ep);
+	}
+}
+
+//Connect the endpoint, may be in progress
+bool Reactor::Impl::Open(Endpoint &ep)
+{
+	if (!ep.conn->Validate())
+		return false;
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN | (ep.stream ? static_cast<uint32_t>(EPOLLOUT) : 0);
+	ev.data.ptr = &ep;
+	if (epoll_ctl(epfd_, EPOLL_CTL_ADD, ep.conn->Handle(), &ev) != 0) {
+		YMB_DEBUG("Reactor add endpoint failed! errno = %d\n", errno);
+		ep.conn->Close();
+		return false;
+	}
+
+	ep.rxlen = 0;
+	if (ep.stream) { //writable after connected
+		ep.state = CONNECTING;
+		wheel_.Arm(ep.timer, &ep, rdto_);
+	}
+	else {
+		ep.state = IDLE;
+	}
+
+	return true;
+}
+
+void Reactor::Impl::Close(Endpoint &ep)
+{
+	int fd = ep.conn->Handle();
+
+	if (fd >= 0) {
+		epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+		ep.conn->Close();
+	}
+
+	wheel_.Cancel(ep.timer);
+	ep.state = CLOSED;
+	ep.rxlen = 0;
+}
+
+//Send the next request of endpoint if it is idle
+void Reactor::Impl::Kick(Endpoint &ep)
+{
+	while (!ep.requests.empty()) {
+		if (ep.state == CONNECTING || ep.state == WAITING)
+			return;
+
+		if (ep.state == CLOSED) {
+			if (!Open(ep)) {
+				Finish(ep, -ENOLINK);
+				continue;
+			}
+			if (ep.state == CONNECTING)
+				return;
+		}
+
+		Request *req = ep.requests.front();
+		size_t msglen = ep.prot->MakeMasterMsg(req->inf.pbuf, req->inf.bufsiz, req->inf);
+
+		ep.conn->Purge(); //清空buffer
+		if (ep.conn->Handle() < 0 || !ep.conn->Send(req->inf.pbuf, msglen)) {
+			Close(ep);
+			Finish(ep, -ENETRESET);
+			continue;
+		}
+
+		ep.state = WAITING;
+		ep.rxlen = 0;
+		ep.sent = RttTable::Now();
+		wheel_.Arm(ep.timer, &ep, ep.rtt.Timeout(req->ask.id, req->tries, rdto_));
+	}
+}
+
+//Retry or complete the executing request of endpoint
+void Reactor::Impl::Finish(Endpoint &ep, int err)
+{
+	Request *req = ep.requests.front();
+
+	if (err != EOK && ++req->tries < retries_) { //retry, still the front
+		req->inf = req->ask;
+		return;
+	}
+
+	ep.requests.pop_front();
+	req->err = err;
+
+	if (req->complete) {
+		int ret = GetRequestResult(*req, -EFAULT);
+		req->complete(ret, ret > 0 ? req->inf.databuf : nullptr);
+	}
+
+	pool_.Put(req);
+}
+
+//Connect is broken, retry or complete the executing request
+void Reactor::Impl::Fail(Endpoint &ep, int err)
+{
+	bool executing = ep.state == CONNECTING || ep.state == WAITING;
+
+	Close(ep);
+
+	if (executing)
+		Finish(ep, err);
+
+	Kick(ep);
+}
+
+//Complete all requests of endpoint
+void Reactor::Impl::Abort(Endpoint &ep, int err)
+{
+	Close(ep);
+
+	while (!ep.requests.empty()) {
+		ep.requests.front()->tries = retries_;
+		Finish(ep, err);
+	}
+}
+
+void Reactor::Impl::OnEvent(Endpoint &ep, uint32_t events)
+{
+	if (ep.state == CONNECTING) {
+		int err = 0;
+		socklen_t len = sizeof(err);
+
+		if (getsockopt(ep.conn->Handle(), SOL_SOCKET, SO_ERROR, &err, &len) != 0
+			|| err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+			YMB_DEBUG("Reactor connect failed! errno = %d\n", err);
+			Fail(ep, -ENOLINK);
+			return;
+		}
+
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.ptr = &ep;
+		epoll_ctl(epfd_, EPOLL_CTL_MOD, ep.conn->Handle(), &ev);
+
+		wheel_.Cancel(ep.timer);
+		ep.state = IDLE;
+		Kick(ep);
+		return;
+	}
+
+	if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+		OnRead(ep);
+}
+
+void Reactor::Impl::OnRead(Endpoint &ep)
+{
+	if (ep.state != WAITING) { //response of nobody, or closed by peer
+		uint8_t buf[kMaxMsgLen];
+		if (ep.conn->Recv(buf, sizeof(buf)) < 0 || ep.conn->Handle() < 0)
+			Fail(ep, -ENETRESET);
+		return;
+	}
+
+	Request *req = ep.requests.front();
+	int ret = ep.conn->Recv(req->inf.pbuf + ep.rxlen, req->inf.bufsiz - ep.rxlen);
+	if (ret < 0) { //connect error
+		Fail(ep, -ENETRESET);
+		return;
+	}
+
+	if (ep.rxlen == 0) //a new response
+		ep.crc.Reset();
+
+	ep.rxlen += static_cast<size_t>(ret);
+	ret = ep.prot->VerifySlaveMsg(req->inf.pbuf, ep.rxlen, ep.crc);
+	if (ret > 0) //more data expected
+		return;
+
+	if (ret == EOK) { //OK, msg arrived
+		ep.rtt.Sample(req->ask.id, req->tries, static_cast<long>(RttTable::Now() - ep.sent));
+		ret = ep.prot->ParseSlaveMsg(req->inf.pbuf, ep.rxlen, req->inf);
+		if (ret == EOK)
+			UpdateStore(req->inf);
+	}
+	else { //msg error
+		ret = -EBADMSG;
+	}
+
+	wheel_.Cancel(ep.timer);
+	ep.state = IDLE;
+	ep.rxlen = 0;
+
+	Finish(ep, ret);
+	Kick(ep);
+}
+
+void Reactor::Impl::OnTimeout(Endpoint &ep)
+{
+	if (ep.state == CONNECTING) {
+		YMB_DEBUG("Reactor connect timeout!\n");
+		Fail(ep, -ENOLINK);
+	}
+	else if (ep.state == WAITING) {
+		ep.rtt.Expire(ep.requests.front()->ask.id);
+		ep.state = IDLE;
+		ep.rxlen = 0;
+		Finish(ep, -EBUSY);
+		Kick(ep);
+	}
+}
+
+void Reactor::Impl::UpdateStore(const MsgInf &inf)
+{
+	auto store = store_.lock();
+
+	if (inf.datalen != 0 && store) {
+		YMB_ASSERT(inf.databuf != nullptr);
+		if (inf.fun == kFunReadCoils
+			|| inf.fun == kFunReadDiscreteInputs) { //bit
+			for (uint16_t i = 0; i < inf.rnum; i++) { //one bit to one register
+				uint8_t val[] = { 0,
+					static_cast<uint8_t>((inf.databuf[i/8] >> (i%8)) & 0x1) };
+				store->Set(inf.id, inf.rreg + i, val, 1);
+			}
+		}
+		else { //register
+			store->Set(inf.id, inf.rreg, inf.databuf, inf.rnum);
+		}
+	}
+}
+
+//Reactor api implementation
+Reactor::Reactor(eThreadMode thrm)
+	: impl_(std::make_unique<Impl>(thrm))
+{
+	if (thrm == TASK)
+		this->Start();
+}
+
+Reactor::~Reactor()
+{
+	if (impl_->thrm_ == TASK) {
+		this->Stop();
+		this->Wait();
+	}
+}
+
+void Reactor::Run(void)
+{
+	while (this->IsRunning())
+		impl_->Poll(1000);
+}
+
+void Reactor::Poll(long to)
+{
+	YMB_ASSERT(impl_->thrm_ == POLL);
+	impl_->Poll(to);
+}
+
+int Reactor::AddEndpoint(const std::string &ip, uint16_t port, eProtocol type)
+{
+	return impl_->Add(ip, port, type);
+}
+
+void Reactor::SetStore(std::shared_ptr<IStore> store)
+{
+	impl_->store_ = store;
+}
+
+std::shared_ptr<IStore> Reactor::GetStore(void) const
+{
+	return impl_->store_.lock();
+}
+
+//reties: retry count
+void Reactor::SetRetries(uint32_t retries)
+{
+	impl_->retries_ = retries;
+}
+
+uint32_t Reactor::GetRetries(void) const
+{
+	return impl_->retries_;
+}
+
+//rdto: ms
+void Reactor::SetReadTimeout(long rdto)
+{
+	impl_->rdto_ = rdto;
+}
+
+long Reactor::GetReadTimeout(void) const
+{
+	return impl_->rdto_;
+}
+
+void Reactor::SetAdaptiveTimeout(bool adaptive)
+{
+	impl_->adaptive_ = adaptive;
+}
+
+bool Reactor::GetAdaptiveTimeout(void) const
+{
+	return impl_->adaptive_;
+}
+
+void Reactor::SetRetryBackoff(bool backoff)
+{
+	impl_->backoff_ = backoff;
+}
+
+bool Reactor::GetRetryBackoff(void) const
+{
+	return impl_->backoff_;
+}
+
+//异步抓取操作，不需返回读取的数据，也不需等待执行完成
+//返回的数据通过过SetStore的对象处理
+int Reactor::PullCoils(int ep, uint8_t sid, uint16_t reg, uint16_t num)
+{
+	return impl_->Post(ep, { sid, kFunReadCoils, reg, num },
+		[](int, const uint8_t*) {});
+}
+
+int Reactor::PullDiscreteInputs(int ep, uint8_t sid, uint16_t reg, uint16_t num)
+{
+	return impl_->Post(ep, { sid, kFunReadDiscreteInputs, reg, num },
+		[](int, const uint8_t*) {});
+}
+
+int Reactor::PullHoldingRegisters(int ep, uint8_t sid, uint16_t reg, uint16_t num)
+{
+	return impl_->Post(ep, { sid, kFunReadHoldingRegisters, reg, num },
+		[](int, const uint8_t*) {});
+}
+
+int Reactor::PullInputRegisters(int ep, uint8_t sid, uint16_t reg, uint16_t num)
+{
+	return impl_->Post(ep, { sid, kFunReadInputRegisters, reg, num },
+		[](int, const uint8_t*) {});
+}
+
+//Asynchronous api, return without waiting for the response
+//return: = 0, OK, complete will be called in reactor thread;
+//return: < 0, errorcode, complete will not be called
+int Reactor::ReadCoilsAsync(int ep, uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Post(ep, { sid, kFunReadCoils, reg, num },
+		std::move(complete));
+}
+
+int Reactor::ReadDiscreteInputsAsync(int ep, uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Post(ep, { sid, kFunReadDiscreteInputs, reg, num },
+		std::move(complete));
+}
+
+int Reactor::ReadInputRegistersAsync(int ep, uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Post(ep, { sid, kFunReadInputRegisters, reg, num },
+		std::move(complete));
+}
+
+int Reactor::ReadHoldingRegistersAsync(int ep, uint8_t sid,
+	uint16_t reg, uint16_t num, Completion complete)
+{
+	return impl_->Post(ep, { sid, kFunReadHoldingRegisters, reg, num },
+		std::move(complete));
+}
+
+int Reactor::WriteSingleCoilAsync(int ep, uint8_t sid,
+	uint16_t reg, bool onoff, Completion complete)
+{
+	uint8_t databuf[] = {
+		static_cast<uint8_t>(onoff ? 0xff : 0x00),
+		0x00
+	};
+	MsgInf inf = { sid, kFunWriteSingleCoil, 0, 0, reg, 1, databuf, 2 };
+
+	return impl_->Post(ep, inf, std::move(complete));
+}
+
+int Reactor::WriteCoilsAsync(int ep, uint8_t sid, uint16_t reg, uint16_t num,
+	const uint8_t *bits, uint8_t wbytes, Completion complete)
+{
+	MsgInf inf = { sid, kFunWriteMultiCoils, 0, 0, reg, num,
+		const_cast<uint8_t*>(bits), wbytes };
+
+	return impl_->Post(ep, inf, std::move(complete));
+}
+
+int Reactor::WriteSingleRegisterAsync(int ep, uint8_t sid,
+	uint16_t reg, uint16_t value, Completion complete)
+{
+	uint8_t databuf[] = {
+		static_cast<uint8_t>(value >> 8),
+		static_cast<uint8_t>(value & 0xff)
+	};
+	MsgInf inf = { sid, kFunWriteSingleRegister, 0, 0, reg, 1, databuf, 2 };
+
+	return impl_->Post(ep, inf, std::move(complete));
+}
+
+int Reactor::WriteRegistersAsync(int ep, uint8_t sid, uint16_t reg, uint16_t num,
+	const uint8_t *values, uint8_t wbytes, Completion complete)
+{
+	MsgInf inf = { sid, kFunWriteMultiRegisters, 0, 0, reg, num,
+		const_cast<uint8_t*>(values), wbytes };
+
+	return impl_->Post(ep, inf, std::move(complete));
+}
+
+} //namespace YModbus
@@ -0,0 +1,104 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBREACTOR_H__
+#define __YMODBUS_YMBREACTOR_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/ymbstore.h"
+#include "ymod/ymbtask.h"
+
+#include <string>
+#include <memory>
+
+namespace YModbus {
+
+//Master engine for many endpoints in one thread.
+//Non-blocking sockets of all endpoints are polled by epoll, every
+//endpoint runs one transaction at a time, and read timeouts are kept
+//by a timer wheel. Only net endpoints(TCP*, UDP*) are surpported.
+//Results are passed to the completion of the request, and updated to
+//the store. Use more reactors to spread the endpoints over threads.
+class Reactor : public Task
+{
+public:
+	explicit Reactor(eThreadMode thrm = TASK);
+	~Reactor();
+
+	Reactor(const Reactor&) = delete;
+	Reactor &operator = (const Reactor&) = delete;
+
+	//type: {TCP, TCPRTU, TCPASCII, UDP, UDPRTU, UDPASCII}
+	//return: >= 0, id of endpoint; < 0, errorcode
+	//Endpoint is connected when the first request is executed
+	int AddEndpoint(const std::string &ip, uint16_t port, eProtocol type);
+
+	void SetStore(std::shared_ptr<IStore> store);
+	std::shared_ptr<IStore> GetStore(void) const;
+
+	//reties: retry count
+	void SetRetries(uint32_t retries);
+	uint32_t GetRetries(void) const;
+
+	//rdto: ms, also timeout of connecting
+	void SetReadTimeout(long rdto);
+	long GetReadTimeout(void) const;
+
+	//adaptive: timeout of each slave is estimated from its response
+	//time, and limited by the read timeout
+	//backoff: double the adaptive timeout on each retry
+	//Only for the endpoints added later.
+	void SetAdaptiveTimeout(bool adaptive);
+	bool GetAdaptiveTimeout(void) const;
+	void SetRetryBackoff(bool backoff);
+	bool GetRetryBackoff(void) const;
+
+	//POLL mode, run the reactor once
+	//to: ms, max time waiting for events
+	void Poll(long to);
+
+	//异步抓取操作，不需返回读取的数据，也不需等待执行完成
+	//返回的数据通过过SetStore的对象处理
+	//return: = 0, OK; < 0, errorcode
+	int PullCoils(int ep, uint8_t sid, uint16_t reg, uint16_t num);
+	int PullDiscreteInputs(int ep, uint8_t sid, uint16_t reg, uint16_t num);
+	int PullHoldingRegisters(int ep, uint8_t sid, uint16_t reg, uint16_t num);
+	int PullInputRegisters(int ep, uint8_t sid, uint16_t reg, uint16_t num);
+
+	//Asynchronous api, return without waiting for the response
+	//return: = 0, OK, complete will be called in reactor thread;
+	//return: < 0, errorcode, complete will not be called
+	//complete: result of the request, see Completion
+	int ReadCoilsAsync(int ep, uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadDiscreteInputsAsync(int ep, uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadInputRegistersAsync(int ep, uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+	int ReadHoldingRegistersAsync(int ep, uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete);
+
+	int WriteSingleCoilAsync(int ep, uint8_t sid,
+		uint16_t reg, bool onoff, Completion complete);
+	int WriteCoilsAsync(int ep, uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *bits, uint8_t wbytes, Completion complete);
+	int WriteSingleRegisterAsync(int ep, uint8_t sid,
+		uint16_t reg, uint16_t value, Completion complete);
+	int WriteRegistersAsync(int ep, uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *values, uint8_t wbytes, Completion complete);
+
+protected:
+	void Run(void) override; //thread func
+	std::string Name(void) override { return "Reactor Task"; }
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBREACTOR_H__
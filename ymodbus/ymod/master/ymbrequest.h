@@ -0,0 +1,598 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBREQUEST_H__
+#define __YMODBUS_YMBREQUEST_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/ymbprot.h"
+#include "ymod/ymbqueue.h"
+#include "ymblog.h"
+#include "ymbopts.h"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+namespace YModbus {
+
+//Request of master api, executed by master task thread.
+//Requests are pooled, and never be freed until the master is destroyed.
+struct Request
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Request()
+		: err(0), tries(0), done(false), split(false), prio(PRIO_NORMAL)
+		, group(nullptr), next(nullptr), index(0), freenext(0)
+	{
+	}
+
+	bool Expired(void) const { return Clock::now() >= deadline; }
+
+	int err;		//error, api or logical error
+	uint32_t tries;	//times of execution
+	bool done;		//synchronous request has been completed
+	bool split;		//split from a failed merged write, never merge again
+	ePriority prio;
+	Clock::time_point deadline; //must be sent before it
+	Request *group;	//writes merged into this one, see CoalesceWrites
+	Request *next;	//next write in the group
+	uint32_t index;	//in the pool
+	std::atomic<uint32_t> freenext; //index + 1 of the next free one, see RequestPool
+
+	MsgInf ask;		//request as submitted, for retry
+	MsgInf inf;		//modbus exception code is in inf.err
+	Completion complete; //asynchronous request, or null
+
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	uint8_t wbuf[256]; //copy of data to write for asynchronous request
+	uint8_t buf[kMaxMsgLen];
+};
+
+//Requests of a master, taken by any thread calling the api, and put back
+//by the master task(asynchronous) or the caller(synchronous).
+//The free ones are a lock-free stack(R. K. Treiber's) of indexes, its
+//head is tagged with a count of changes against ABA, requests popped
+//are never freed, so the next of a stale head is still readable.
+//Requests are created on demand, up to maxnum.
+class RequestPool
+{
+public:
+	explicit RequestPool(size_t maxnum = kMaxRequestNum)
+		: maxnum_(maxnum)
+		, reqs_(maxnum)
+		, created_(0)
+		, free_(0)
+	{
+		YMB_ASSERT(maxnum < kIndexMask);
+	}
+
+	RequestPool(const RequestPool&) = delete;
+	RequestPool &operator = (const RequestPool&) = delete;
+
+	//Any thread
+	//return: nullptr, too many requests pending
+	Request *Get(const MsgInf &inf, Completion complete)
+	{
+		Request *req = Pop();
+
+		if (req == nullptr) {
+			size_t index = created_.fetch_add(1, std::memory_order_relaxed);
+			if (index >= maxnum_) {
+				created_.fetch_sub(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			reqs_[index].reset(new Request);
+			req = reqs_[index].get();
+			req->index = static_cast<uint32_t>(index);
+		}
+
+		const RequestScope::Options &opts = RequestScope::Current();
+
+		req->err = 0;
+		req->tries = 0;
+		req->done = false;
+		req->split = false;
+		req->prio = opts.prio;
+		req->deadline = opts.deadline > 0
+			? Request::Clock::now() + std::chrono::milliseconds(opts.deadline)
+			: Request::Clock::time_point::max();
+		req->group = nullptr;
+		req->next = nullptr;
+		req->ask = inf;
+		req->complete = std::move(complete);
+
+		if (req->complete && req->ask.databuf != nullptr) {
+			//caller's data may be gone before execution
+			YMB_ASSERT(req->ask.datalen <= sizeof(req->wbuf));
+			memcpy(req->wbuf, req->ask.databuf, req->ask.datalen);
+			req->ask.databuf = req->wbuf;
+		}
+
+		if (req->ask.pbuf == nullptr) {
+			req->ask.pbuf = req->buf;
+			req->ask.bufsiz = sizeof(req->buf);
+		}
+
+		req->inf = req->ask;
+
+		return req;
+	}
+
+	//Any thread
+	void Put(Request *req)
+	{
+		req->complete = nullptr;
+
+		uint64_t head = free_.load(std::memory_order_relaxed);
+		uint64_t top;
+		do {
+			req->freenext.store(static_cast<uint32_t>(head & kIndexMask),
+				std::memory_order_relaxed);
+			top = ((head & ~kIndexMask) + kTagOne) | (req->index + 1);
+		} while (!free_.compare_exchange_weak(head, top,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+private:
+	static const uint64_t kIndexMask = 0xffffffffu; //index + 1, 0 is empty
+	static const uint64_t kTagOne = uint64_t(1) << 32;
+
+	Request *Pop(void)
+	{
+		uint64_t head = free_.load(std::memory_order_acquire);
+
+		while ((head & kIndexMask) != 0) {
+			Request *req = reqs_[(head & kIndexMask) - 1].get();
+			uint64_t next = ((head & ~kIndexMask) + kTagOne)
+				| req->freenext.load(std::memory_order_relaxed);
+			if (free_.compare_exchange_weak(head, next,
+				std::memory_order_acquire, std::memory_order_acquire))
+				return req;
+		}
+
+		return nullptr;
+	}
+
+	size_t maxnum_;
+	std::vector<std::unique_ptr<Request>> reqs_; //by index, created ones
+	std::atomic<size_t> created_;
+	std::atomic<uint64_t> free_; //tag << 32 | index + 1 of the top
+};
+
+//Submitted requests of master in priority classes.
+//PRIO_ALARM is always scheduled first, the other classes share the
+//bus by weight(weighted round robin), so none of them is starved.
+//Pull* querys take turns with the requests of PRIO_BULK.
+//Requests are pushed by any thread, and popped by master task.
+class RequestQueue
+{
+public:
+	RequestQueue()
+	{
+		const uint32_t weights[PRIO_NUM] = { 1, 8, 4, 1 };
+
+		for (int i = 0; i < PRIO_NUM; i++) {
+			classes_[i].depth = kMaxRequestNum;
+			classes_[i].weight = weights[i];
+			classes_[i].credit = weights[i];
+			classes_[i].pending.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	RequestQueue(const RequestQueue&) = delete;
+	RequestQueue &operator = (const RequestQueue&) = delete;
+
+	//depth: max requests of the class waiting for execution
+	void SetDepth(ePriority prio, size_t depth) { classes_[prio].depth = depth; }
+	size_t GetDepth(ePriority prio) const { return classes_[prio].depth; }
+
+	//weight: share of the bus, no effect on PRIO_ALARM
+	void SetWeight(ePriority prio, uint32_t weight)
+	{
+		classes_[prio].weight = weight != 0 ? weight : 1;
+	}
+	uint32_t GetWeight(ePriority prio) const { return classes_[prio].weight; }
+
+	//requests of the class waiting for execution
+	size_t GetPending(ePriority prio) const
+	{
+		return classes_[prio].pending.load(std::memory_order_relaxed);
+	}
+
+	//Any thread
+	//return: = 0, OK; -ENOBUFS, class is full, submit later
+	int Push(Request *req)
+	{
+		Class &c = classes_[req->prio];
+
+		if (c.pending.fetch_add(1, std::memory_order_relaxed) >= c.depth) {
+			c.pending.fetch_sub(1, std::memory_order_relaxed);
+			return -ENOBUFS;
+		}
+
+		//never full, requests are less than the pool
+		c.requests.Push(req);
+		return EOK;
+	}
+
+	//Master task, the request popped need to retry
+	void Retry(Request *req)
+	{
+		classes_[req->prio].pending.fetch_add(1, std::memory_order_relaxed);
+		classes_[req->prio].requests.Push(req);
+	}
+
+	//Master task, the request popped is executed before the others of its class
+	void Unpop(Request *req)
+	{
+		Class &c = classes_[req->prio];
+
+		c.held.push_front(req);
+		c.pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Master task
+	bool Empty(void) const
+	{
+		for (const auto &c : classes_) {
+			if (Ready(c))
+				return false;
+		}
+
+		return true;
+	}
+
+	//Master task, look ahead at the requests of the class not popped yet
+	//f: void(Request *req), in the order of submission
+	template<typename F>
+	void ForEach(ePriority prio, F f)
+	{
+		Class &c = classes_[prio];
+		Request *req;
+
+		while (c.requests.Pop(req))
+			c.held.push_back(req);
+
+		for (auto r : c.held)
+			f(r);
+	}
+
+	//Master task, take out the request found by ForEach
+	void Remove(Request *req)
+	{
+		Class &c = classes_[req->prio];
+		auto it = std::find(c.held.begin(), c.held.end(), req);
+
+		if (it != c.held.end()) {
+			c.held.erase(it);
+			c.pending.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	//Master task, schedule the next one
+	//querys: Pull* querys are pending
+	//return: true, req to execute, or a query if req is nullptr;
+	//return: false, nothing to execute
+	bool Pop(Request *&req, bool querys)
+	{
+		if (Pop(PRIO_ALARM, req))
+			return true;
+
+		for (int round = 0; round < 2; round++) {
+			bool ready = false;
+
+			for (int i = PRIO_HIGH; i < PRIO_NUM; i++) {
+				Class &c = classes_[i];
+				bool hasquery = querys && i == PRIO_BULK;
+
+				if (!Ready(c) && !hasquery)
+					continue;
+				ready = true;
+
+				if (c.credit == 0)
+					continue;
+				c.credit--;
+
+				if (hasquery && (turn_ || !Ready(c))) {
+					turn_ = false;
+					req = nullptr;
+					return true;
+				}
+
+				turn_ = hasquery;
+				return Pop(static_cast<ePriority>(i), req);
+			}
+
+			if (!ready)
+				break;
+
+			for (auto &c : classes_) //all ready are out of credit
+				c.credit = c.weight;
+		}
+
+		return false;
+	}
+
+	//Master task, only requests
+	bool Pop(ePriority prio, Request *&req)
+	{
+		Class &c = classes_[prio];
+
+		if (!c.held.empty()) { //they are before requests
+			req = c.held.front();
+			c.held.pop_front();
+		}
+		else if (!c.requests.Pop(req)) {
+			return false;
+		}
+
+		c.pending.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	struct Class
+	{
+		MpscQueue<Request*, kMaxRequestNum> requests;
+		std::deque<Request*> held; //popped by ForEach, still pending
+		std::atomic<size_t> pending; //in requests
+		size_t depth;
+		uint32_t weight;
+		uint32_t credit; //left in this round
+	};
+
+	static bool Ready(const Class &c)
+	{
+		return !c.held.empty() || !c.requests.Empty();
+	}
+
+	Class classes_[PRIO_NUM];
+	bool turn_ = false; //querys' turn of PRIO_BULK
+};
+
+//Submit the reads of a batch, and wait for all of them with one wakeup
+//submit: int(const MsgInf &inf, Completion complete), queue the request
+//without waking up master task, see Submit
+//notify: void(void), wake up master task
+//results: bytes read of each spec, or errorcode
+//return: blocks read
+template<typename S, typename N>
+int ExecBatch(const std::vector<ReadSpec> &specs, std::vector<int> &results,
+	S submit, N notify)
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t left = 0; //reads submitted but not completed
+	int ok = 0;
+
+	results.assign(specs.size(), 0);
+
+	for (size_t i = 0; i < specs.size(); i++) {
+		const ReadSpec &spec = specs[i];
+
+		if (spec.fun < kFunReadCoils || spec.fun > kFunReadInputRegisters) {
+			results[i] = -EINVAL;
+			continue;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			left++;
+		}
+
+		int ret = submit({ spec.sid, spec.fun, spec.reg, spec.num },
+			[&, i](int ret, const uint8_t *buf) {
+			const ReadSpec &spec = specs[i];
+
+			if (ret > 0 && static_cast<size_t>(ret) > spec.bufsiz) {
+				YMB_DEBUG("buffer size is too small!\n");
+				ret = -ENOMEM;
+			}
+			else if (ret > 0) {
+				memcpy(spec.buf, buf, ret);
+			}
+			results[i] = ret;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			ok += ret > 0 ? 1 : 0;
+			if (--left == 0)
+				cond.notify_all();
+		});
+
+		if (ret != EOK) {
+			std::unique_lock<std::mutex> lock(mutex);
+			results[i] = ret;
+			left--;
+		}
+	}
+
+	notify();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	cond.wait(lock, [&left] { return left == 0; });
+
+	return ok;
+}
+
+//Request failed with err is executed again, unless the slave is
+//suspended(-EHOSTUNREACH), its deadline is over(-ETIMEDOUT), or it
+//can't be made(-EINVAL). Both of TASK and POLL modes use it.
+inline bool IsRetryable(int err)
+{
+	return err != EOK && err != -EHOSTUNREACH && err != -ETIMEDOUT && err != -EINVAL;
+}
+
+//Result of request for the caller
+//return: >= 0, bytes of data(read) or EOK(write); < 0, errorcode
+inline int GetRequestResult(const Request &req, int mismatch)
+{
+	const MsgInf &ask = req.ask;
+	const MsgInf &inf = req.inf;
+
+	if (req.err != 0)
+		return req.err;
+
+	if (GetFunDesc(ask.fun).bits != 0) //read
+		return inf.datalen;
+
+	if (inf.err != 0) {
+		YMB_DEBUG("eXecute Write exception! code = %u\n", inf.err);
+		return -EFAULT;
+	}
+
+	if (inf.id != ask.id || inf.fun != ask.fun || inf.wreg != ask.wreg) {
+		YMB_DEBUG("eXecute Write response error id/fun/reg"
+			"send: id = %02x, fun = %02x, reg = %02x \n"
+			"recv: id = %02x, fun = %02x, reg = %02x \n",
+			ask.id, ask.fun, ask.wreg, inf.id, inf.fun, inf.wreg);
+		return mismatch;
+	}
+
+	return EOK;
+}
+
+//Merge the pending single writes(0x05/0x06) of the same class and slave
+//with addresses contiguous to req into one multiple write(0x0F/0x10).
+//Writes are looked ahead in the order of submission, until any other
+//request to the slave or to all slaves, or a second write of an address,
+//so nothing merged is executed before a request submitted ahead of it.
+//return: request carrying the merged write, with the writes merged in
+//its group, see SplitWrites; or req if nothing is merged
+inline Request *CoalesceWrites(RequestQueue &queue, RequestPool &pool, Request *req)
+{
+	const MsgInf &ask = req->ask;
+	bool coil = ask.fun == kFunWriteSingleCoil;
+	uint32_t maxnum = coil ? kMaxWriteBitNum : kMaxWriteRegNum;
+	std::map<uint32_t, Request*> writes; //by address
+	bool stop = false;
+
+	if ((ask.fun != kFunWriteSingleCoil && ask.fun != kFunWriteSingleRegister)
+		|| ask.datalen != 2 || req->split)
+		return req;
+
+	writes.emplace(ask.wreg, req);
+	queue.ForEach(req->prio, [&](Request *r) {
+		if (stop || r->Expired() //expired is never sent
+			|| (r->ask.id != ask.id && r->ask.id != kBroadcastId))
+			return;
+
+		stop = r->ask.id != ask.id || r->ask.fun != ask.fun
+			|| r->ask.datalen != 2 || r->split || r->group != nullptr
+			|| !writes.emplace(r->ask.wreg, r).second;
+	});
+
+	//the contiguous run around req
+	uint32_t lo = ask.wreg, hi = ask.wreg;
+	while (hi - lo + 1 < maxnum) {
+		if (writes.count(hi + 1) != 0)
+			hi++;
+		else if (lo > 0 && writes.count(lo - 1) != 0)
+			lo--;
+		else
+			break;
+	}
+
+	if (lo == hi)
+		return req;
+
+	uint16_t num = static_cast<uint16_t>(hi - lo + 1);
+	Request *carrier = pool.Get({ ask.id,
+		static_cast<uint8_t>(coil ? kFunWriteMultiCoils : kFunWriteMultiRegisters),
+		0, 0, static_cast<uint16_t>(lo), num }, nullptr);
+	if (carrier == nullptr)
+		return req;
+
+	uint8_t *data = carrier->wbuf;
+	size_t datalen = coil ? (num + 7) / 8 : num * 2u;
+	Request **tail = &carrier->group;
+
+	memset(data, 0, datalen);
+	for (uint32_t reg = lo; reg <= hi; reg++) {
+		Request *r = writes[reg];
+		const uint8_t *value = r->ask.databuf;
+		uint32_t off = reg - lo;
+
+		if (coil) //0xff00 is on
+			data[off / 8] |= static_cast<uint8_t>((value[0] == 0xff ? 1 : 0) << (off % 8));
+		else
+			memcpy(data + off * 2, value, 2);
+
+		if (r != req)
+			queue.Remove(r);
+
+		*tail = r;
+		tail = &r->next;
+	}
+	*tail = nullptr;
+
+	carrier->prio = req->prio;
+	carrier->deadline = req->deadline;
+	carrier->ask.databuf = data;
+	carrier->ask.datalen = static_cast<uint8_t>(datalen);
+	carrier->inf = carrier->ask;
+
+	return carrier;
+}
+
+//Pass the result of the merged write to each write of its group.
+//If the slave refused the merged write with an exception, the writes
+//are executed again one by one, before the others of the class.
+//mismatch: errorcode of response mismatched, see GetRequestResult
+//f: void(Request *req), complete the write, req may be reused in it
+template<typename F>
+void SplitWrites(RequestQueue &queue, Request &carrier, int mismatch, F f)
+{
+	int ret = GetRequestResult(carrier, mismatch);
+	Request *next;
+
+	if (carrier.err == 0 && carrier.inf.err != 0) {
+		YMB_DEBUG("Merged write exception %u, split it!\n", carrier.inf.err);
+
+		Request *list = nullptr; //reversed, to be unpopped in order
+		for (Request *r = carrier.group; r != nullptr; r = next) {
+			next = r->next;
+			r->next = list;
+			list = r;
+		}
+
+		for (Request *r = list; r != nullptr; r = next) {
+			next = r->next;
+			r->next = nullptr;
+			r->split = true;
+			r->inf = r->ask;
+			queue.Unpop(r);
+		}
+
+		carrier.group = nullptr;
+		return;
+	}
+
+	for (Request *r = carrier.group; r != nullptr; r = next) {
+		next = r->next;
+		r->next = nullptr;
+		r->err = ret < 0 ? ret : EOK;
+		r->inf = r->ask; //as if answered alone
+		f(r);
+	}
+
+	carrier.group = nullptr;
+}
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBREQUEST_H__
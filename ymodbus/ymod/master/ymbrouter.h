@@ -0,0 +1,360 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBROUTER_H__
+#define __YMODBUS_YMBROUTER_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/ymbstore.h"
+#include "ymod/ymbplayer.h"
+
+#include <memory>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+namespace YModbus {
+
+//Api of a master over some masters, requests to a slave are routed to
+//one of them by TRoute, settings are made on all of them.
+//TMasterT: {Master, TMaster<...>}
+//TRoute: the group derived from it, {MasterPool, BusGroup}, which makes
+//MasterRouter a friend and provides:
+//  TMasterT &Front(void) const, the first master
+//  void ForEach(F f), f: void(TMasterT &m), on each master
+//  void Pull(uint8_t sid, F f), f: void(TMasterT &m)
+//  int Call(uint8_t sid, F f), f: int(TMasterT &m)
+//  int CallAsync(uint8_t sid, Completion complete, F f),
+//  f: int(TMasterT &m, Completion c), complete is passed as c
+//Synchronous writes to all slaves(broadcast) are made by CallAsync, so
+//TRoute may send them on all of masters at once, and waited for once.
+template<typename TMasterT, typename TRoute>
+class MasterRouter : public IPlayer
+{
+public:
+	void SetStore(std::shared_ptr<IStore> store)
+	{
+		Route().ForEach([&store](TMasterT &m) { m.SetStore(store); });
+	}
+
+	std::shared_ptr<IStore> GetStore(void) const
+	{
+		return Route().Front().GetStore();
+	}
+
+	//reties: retry count
+	void SetRetries(uint32_t retries)
+	{
+		Route().ForEach([=](TMasterT &m) { m.SetRetries(retries); });
+	}
+
+	uint32_t GetRetries(void) const
+	{
+		return Route().Front().GetRetries();
+	}
+
+	//rdto: ms
+	void SetReadTimeout(long rdto)
+	{
+		Route().ForEach([=](TMasterT &m) { m.SetReadTimeout(rdto); });
+	}
+
+	long GetReadTimeout(void) const
+	{
+		return Route().Front().GetReadTimeout();
+	}
+
+	void SetQueryGap(uint16_t gap)
+	{
+		Route().ForEach([=](TMasterT &m) { m.SetQueryGap(gap); });
+	}
+
+	uint16_t GetQueryGap(void) const
+	{
+		return Route().Front().GetQueryGap();
+	}
+
+	//return: true, all of masters are connected
+	bool CheckConnect(void)
+	{
+		bool valid = true;
+
+		Route().ForEach([&valid](TMasterT &m) {
+			if (!m.CheckConnect())
+				valid = false;
+		});
+
+		return valid;
+	}
+
+	//异步抓取操作，不需返回读取的数据，也不需等待执行完成
+	//返回的数据通过过SetStore的对象处理
+	void PullCoils(uint8_t sid, uint16_t reg, uint16_t num)
+	{
+		Route().Pull(sid, [=](TMasterT &m) { m.PullCoils(sid, reg, num); });
+	}
+
+	void PullDiscreteInputs(uint8_t sid, uint16_t reg, uint16_t num)
+	{
+		Route().Pull(sid, [=](TMasterT &m) { m.PullDiscreteInputs(sid, reg, num); });
+	}
+
+	void PullHoldingRegisters(uint8_t sid, uint16_t reg, uint16_t num)
+	{
+		Route().Pull(sid, [=](TMasterT &m) { m.PullHoldingRegisters(sid, reg, num); });
+	}
+
+	void PullInputRegisters(uint8_t sid, uint16_t reg, uint16_t num)
+	{
+		Route().Pull(sid, [=](TMasterT &m) { m.PullInputRegisters(sid, reg, num); });
+	}
+
+	//IPlayer================================================================
+	//return: >= 0, bytes of data to return;
+	//return: < 0, errorcode of exception, or of the routing, see TRoute
+	//buf: data value, net order
+	virtual int ReadCoils(uint8_t sid,
+		uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.ReadCoils(sid, reg, num, buf, bufsiz);
+		});
+	}
+
+	virtual int ReadDiscreteInputs(uint8_t sid,
+		uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.ReadDiscreteInputs(sid, reg, num, buf, bufsiz);
+		});
+	}
+
+	virtual int ReadInputRegisters(uint8_t sid,
+		uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.ReadInputRegisters(sid, reg, num, buf, bufsiz);
+		});
+	}
+
+	virtual int ReadHoldingRegisters(uint8_t sid,
+		uint16_t reg, uint16_t num, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.ReadHoldingRegisters(sid, reg, num, buf, bufsiz);
+		});
+	}
+
+	//return: = 0, OK;
+	//return: < 0, errorcode of exception
+	//values: data value, net order
+	virtual int WriteSingleCoil(uint8_t sid, uint16_t reg, bool onoff)
+	{
+		if (sid == kBroadcastId)
+			return Wait([=](Completion c) {
+				return WriteSingleCoilAsync(sid, reg, onoff, std::move(c));
+			});
+
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.WriteSingleCoil(sid, reg, onoff);
+		});
+	}
+
+	virtual int WriteCoils(uint8_t sid,
+		uint16_t reg, uint16_t num, const uint8_t *bits, uint8_t wbytes)
+	{
+		if (sid == kBroadcastId)
+			return Wait([=](Completion c) {
+				return WriteCoilsAsync(sid, reg, num, bits, wbytes, std::move(c));
+			});
+
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.WriteCoils(sid, reg, num, bits, wbytes);
+		});
+	}
+
+	virtual int WriteSingleRegister(uint8_t sid,
+		uint16_t reg, uint16_t value)
+	{
+		if (sid == kBroadcastId)
+			return Wait([=](Completion c) {
+				return WriteSingleRegisterAsync(sid, reg, value, std::move(c));
+			});
+
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.WriteSingleRegister(sid, reg, value);
+		});
+	}
+
+	virtual int WriteRegisters(uint8_t sid,
+		uint16_t reg, uint16_t num, const uint8_t *values, uint8_t wbytes)
+	{
+		if (sid == kBroadcastId)
+			return Wait([=](Completion c) {
+				return WriteRegistersAsync(sid, reg, num, values, wbytes, std::move(c));
+			});
+
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.WriteRegisters(sid, reg, num, values, wbytes);
+		});
+	}
+
+	virtual int MaskWriteRegisters(uint8_t sid,
+		uint16_t reg, uint16_t andmask, uint16_t ormask)
+	{
+		if (sid == kBroadcastId)
+			return Wait([=](Completion c) {
+				return MaskWriteRegistersAsync(sid, reg, andmask, ormask, std::move(c));
+			});
+
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.MaskWriteRegisters(sid, reg, andmask, ormask);
+		});
+	}
+
+	//return: >= 0, bytes of data to return
+	//return: < 0,  errorcode of exception
+	//values/buf: data value, net order
+	virtual int WriteReadRegisters(uint8_t sid,
+		uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
+		uint16_t rreg, uint16_t rnum, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Call(sid, [=](TMasterT &m) {
+			return m.WriteReadRegisters(sid, wreg, wnum, values, wbytes,
+				rreg, rnum, buf, bufsiz);
+		});
+	}
+
+	//On the first master
+	//return: >= 0, OK
+	//return: < 0,  errorcode of exception
+	virtual int ReportSlaveId(uint8_t maxsid, uint8_t *buf, size_t bufsiz)
+	{
+		return Route().Front().ReportSlaveId(maxsid, buf, bufsiz);
+	}
+
+	//Asynchronous api, see TMaster
+	int ReadCoilsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.ReadCoilsAsync(sid, reg, num, std::move(c));
+		});
+	}
+
+	int ReadDiscreteInputsAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.ReadDiscreteInputsAsync(sid, reg, num, std::move(c));
+		});
+	}
+
+	int ReadInputRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.ReadInputRegistersAsync(sid, reg, num, std::move(c));
+		});
+	}
+
+	int ReadHoldingRegistersAsync(uint8_t sid,
+		uint16_t reg, uint16_t num, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.ReadHoldingRegistersAsync(sid, reg, num, std::move(c));
+		});
+	}
+
+	int WriteSingleCoilAsync(uint8_t sid,
+		uint16_t reg, bool onoff, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.WriteSingleCoilAsync(sid, reg, onoff, std::move(c));
+		});
+	}
+
+	int WriteCoilsAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *bits, uint8_t wbytes, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.WriteCoilsAsync(sid, reg, num, bits, wbytes, std::move(c));
+		});
+	}
+
+	int WriteSingleRegisterAsync(uint8_t sid,
+		uint16_t reg, uint16_t value, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.WriteSingleRegisterAsync(sid, reg, value, std::move(c));
+		});
+	}
+
+	int WriteRegistersAsync(uint8_t sid, uint16_t reg, uint16_t num,
+		const uint8_t *values, uint8_t wbytes, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.WriteRegistersAsync(sid, reg, num, values, wbytes, std::move(c));
+		});
+	}
+
+	int MaskWriteRegistersAsync(uint8_t sid, uint16_t reg,
+		uint16_t andmask, uint16_t ormask, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.MaskWriteRegistersAsync(sid, reg, andmask, ormask, std::move(c));
+		});
+	}
+
+	int WriteReadRegistersAsync(uint8_t sid,
+		uint16_t wreg, uint16_t wnum, const uint8_t *values, uint8_t wbytes,
+		uint16_t rreg, uint16_t rnum, Completion complete)
+	{
+		return Route().CallAsync(sid, std::move(complete), [=](TMasterT &m, Completion c) {
+			return m.WriteReadRegistersAsync(sid, wreg, wnum, values, wbytes,
+				rreg, rnum, std::move(c));
+		});
+	}
+
+protected:
+	MasterRouter() {}
+
+	MasterRouter(const MasterRouter&) = delete;
+	MasterRouter &operator = (const MasterRouter&) = delete;
+
+private:
+	TRoute &Route(void) { return static_cast<TRoute&>(*this); }
+	const TRoute &Route(void) const { return static_cast<const TRoute&>(*this); }
+
+	//Wait for the completion of an asynchronous request
+	//submit: int(Completion complete), see CallAsync
+	template<typename S>
+	static int Wait(S submit)
+	{
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool done = false;
+		int err = EOK;
+
+		int ret = submit([&](int ret, const uint8_t*) {
+			std::unique_lock<std::mutex> lock(mutex);
+			err = ret;
+			done = true;
+			cond.notify_all();
+		});
+		if (ret < 0) //complete will not be called
+			return ret;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [&done] { return done; });
+
+		return err;
+	}
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBROUTER_H__
@@ -0,0 +1,114 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBRTT_H__
+#define __YMODBUS_YMBRTT_H__
+
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+namespace YModbus {
+
+//Response time estimator of the slaves behind one connection.
+//Like TCP(RFC 6298), timeout = SRTT + 4 * RTTVAR, clamped to
+//[minto, maxto]. After a timeout it is doubled until the slave is
+//sampled again, and with backoff also doubled on every retry.
+//Only the first try is sampled(Karn), response of a retry is ambiguous.
+//Only used in the thread executing the requests.
+class RttTable
+{
+public:
+	//minto: ms, the least timeout of adaptive
+	explicit RttTable(long minto)
+		: minto_(minto)
+		, adaptive_(false)
+		, backoff_(false)
+	{
+	}
+
+	//adaptive: false, always the max timeout(rdto)
+	void SetAdaptive(bool adaptive) { adaptive_ = adaptive; }
+	bool GetAdaptive(void) const { return adaptive_; }
+
+	//backoff: double the timeout on each retry
+	void SetBackoff(bool backoff) { backoff_ = backoff; }
+	bool GetBackoff(void) const { return backoff_; }
+
+	//tries: times the request has been executed
+	//maxto: ms, the configured read timeout
+	//return: ms, timeout of this try
+	long Timeout(uint8_t sid, uint32_t tries, long maxto) const
+	{
+		const Entry &e = entries_[sid];
+
+		if (!adaptive_ || e.srtt == 0) //not sampled yet
+			return maxto;
+
+		long rto = (e.srtt + 4 * e.rttvar + 999) / 1000; //us to ms
+		uint32_t shift = e.shift + (backoff_ ? tries : 0);
+
+		rto <<= shift < kMaxShift ? shift : kMaxShift;
+
+		return std::max(minto_, std::min(rto, maxto));
+	}
+
+	//rtt: us, from sending request to the response arrived
+	void Sample(uint8_t sid, uint32_t tries, long rtt)
+	{
+		Entry &e = entries_[sid];
+
+		if (tries != 0) //Karn
+			return;
+
+		rtt = std::max(rtt, 1L);
+		if (e.srtt == 0) { //the first sample
+			e.srtt = rtt;
+			e.rttvar = rtt / 2;
+		}
+		else { //RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+			long delta = e.srtt > rtt ? e.srtt - rtt : rtt - e.srtt;
+			e.rttvar += (delta - e.rttvar) / 4;
+			e.srtt += (rtt - e.srtt) / 8;
+		}
+
+		e.shift = 0;
+	}
+
+	//No response in timeout
+	void Expire(uint8_t sid)
+	{
+		Entry &e = entries_[sid];
+
+		if (e.shift < kMaxShift)
+			e.shift++;
+	}
+
+	//return: us, for measuring rtt
+	static int64_t Now(void)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	static const uint32_t kMaxShift = 6;
+
+	struct Entry
+	{
+		long srtt = 0; //us, 0: not sampled
+		long rttvar = 0; //us
+		uint32_t shift = 0; //timeouts since the last sample
+	};
+
+	long minto_;
+	bool adaptive_;
+	bool backoff_;
+	Entry entries_[256];
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBRTT_H__
@@ -0,0 +1,320 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBSCANNER_H__
+#define __YMODBUS_YMBSCANNER_H__
+
+#include "ymod/ymbdefs.h"
+#include "ymod/ymbcompl.h"
+#include "ymod/ymbtask.h"
+#include "ymod/ymbevent.h"
+#include "ymblog.h"
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+
+namespace YModbus {
+
+//One read of a scan group
+struct ScanItem
+{
+	uint8_t sid;
+	uint8_t fun; //kFunReadCoils ~ kFunReadInputRegisters
+	uint16_t reg;
+	uint16_t num;
+};
+
+//Statistics of a scan group
+struct ScanStat
+{
+	uint64_t cycles = 0;	//cycles issued
+	uint64_t errors = 0;	//cycles with any read failed
+	uint64_t late = 0;		//cycles issued later than deadline + tolerance
+	uint64_t missed = 0;	//cycles skipped, overrun or scanner behind
+	long maxlag = 0;		//ms, max delay of issuing after deadline
+	long lastdur = 0;		//ms, duration of the last completed cycle
+};
+
+//Cyclic scan of groups of reads, earliest deadline first.
+//Reads are issued with the asynchronous api of master, so the results
+//are updated to the store of master(SetStore).
+//A cycle is skipped if the previous cycle of the group is still running.
+//TMasterT: {Master, TMaster<...>}, master should be in TASK mode
+template<typename TMasterT>
+class Scanner : public Task
+{
+public:
+	explicit Scanner(TMasterT &master)
+		: master_(master)
+		, tolerance_(kDefTolerance)
+		, nextid_(0)
+		, busy_(0)
+		, changed_(false)
+		, epoch_(Clock::now())
+	{
+		this->Start();
+	}
+
+	Scanner() = delete;
+	Scanner(const Scanner&) = delete;
+	Scanner &operator = (const Scanner&) = delete;
+
+	~Scanner()
+	{
+		this->Stop();
+		this->Wait();
+
+		//completions of master refer to us
+		std::unique_lock<std::mutex> lock(mutex_);
+		doneCond_.wait(lock, [this] { return busy_ == 0; });
+	}
+
+	void Stop(void) override
+	{
+		Task::Stop();
+		this->Wake();
+	}
+
+	//tolerance: ms, cycle issued later than deadline + tolerance is late
+	void SetTolerance(long tolerance) { tolerance_ = tolerance; }
+	long GetTolerance(void) const { return tolerance_; }
+
+	//period: ms, > 0
+	//phase: ms, offset of the cycles from start of scanner
+	//return: >= 0, id of the group; < 0, errorcode
+	int AddGroup(const std::vector<ScanItem> &items, long period, long phase = 0)
+	{
+		if (items.empty() || period <= 0 || phase < 0)
+			return -EINVAL;
+
+		for (auto &item : items) {
+			if (item.fun < kFunReadCoils || item.fun > kFunReadInputRegisters)
+				return -EINVAL;
+		}
+
+		auto group = std::make_shared<Group>();
+		group->items = items;
+		group->period = std::chrono::milliseconds(period);
+
+		//align to the cycles of phase, next one from now
+		auto start = epoch_ + std::chrono::milliseconds(phase);
+		auto now = Clock::now();
+		if (start < now)
+			start += (now - start + group->period - Clock::duration(1))
+				/ group->period * group->period;
+		group->next = start;
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		int id = nextid_++;
+		groups_[id] = group;
+		lock.unlock();
+
+		this->Wake();
+
+		return id;
+	}
+
+	//The running cycle of the group is still completed
+	void RemoveGroup(int id)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		groups_.erase(id);
+	}
+
+	//return: false, no such group
+	bool GetStat(int id, ScanStat &stat) const
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		auto it = groups_.find(id);
+		if (it == groups_.end())
+			return false;
+
+		stat = it->second->stat;
+		return true;
+	}
+
+protected:
+	void Run(void) override; //thread func
+	std::string Name(void) override { return "Scanner Task"; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Group
+	{
+		std::vector<ScanItem> items;
+		Clock::duration period;
+		Clock::time_point next; //deadline of the next cycle
+		Clock::time_point issued;
+		uint32_t pending = 0; //reads of the running cycle
+		bool failed = false;
+		ScanStat stat;
+	};
+
+	typedef std::shared_ptr<Group> GroupPtr;
+
+	GroupPtr Earliest(void);
+	void Issue(const GroupPtr &group);
+	void Complete(const GroupPtr &group, int ret);
+
+	void Wake(void)
+	{
+		changed_ = true;
+		event_.Notify();
+	}
+
+	const long kDefTolerance = 10; //ms
+
+	TMasterT &master_;
+	long tolerance_;
+
+	int nextid_;
+	std::map<int, GroupPtr> groups_;
+	uint32_t busy_; //reads outstanding of all groups
+	mutable std::mutex mutex_;
+	std::condition_variable doneCond_;
+
+	std::atomic<bool> changed_; //groups changed or stopped
+	Event event_; //wake up scanner task
+	Clock::time_point epoch_;
+};
+
+//The group with the earliest deadline, with mutex_ held
+template<typename TMasterT>
+typename Scanner<TMasterT>::GroupPtr Scanner<TMasterT>::Earliest(void)
+{
+	GroupPtr earliest;
+
+	for (auto &it : groups_) {
+		if (!earliest || it.second->next < earliest->next)
+			earliest = it.second;
+	}
+
+	return earliest;
+}
+
+template<typename TMasterT>
+void Scanner<TMasterT>::Run(void)
+{
+	while (this->IsRunning()) {
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		changed_ = false;
+
+		GroupPtr group = Earliest();
+		auto now = Clock::now();
+		if (!group || group->next > now) { //sleep until the deadline
+			long ms = 1000;
+			if (group) {
+				ms = static_cast<long>(std::chrono::duration_cast<
+					std::chrono::milliseconds>(group->next - now).count()) + 1;
+			}
+			lock.unlock();
+			event_.WaitFor(ms, [this] { return changed_.load(); });
+			continue;
+		}
+
+		//scanner is behind a whole period, those cycles are gone
+		auto lag = now - group->next;
+		if (lag >= group->period) {
+			auto skipped = lag / group->period;
+			group->stat.missed += skipped;
+			group->next += skipped * group->period;
+			lag -= skipped * group->period;
+		}
+		group->next += group->period;
+
+		if (group->pending != 0) { //overrun, skip this cycle
+			group->stat.missed++;
+			continue;
+		}
+
+		long lagms = static_cast<long>(std::chrono::duration_cast<
+			std::chrono::milliseconds>(lag).count());
+		if (lagms > tolerance_)
+			group->stat.late++;
+		if (lagms > group->stat.maxlag)
+			group->stat.maxlag = lagms;
+
+		group->stat.cycles++;
+		group->pending = static_cast<uint32_t>(group->items.size());
+		group->failed = false;
+		group->issued = now;
+		busy_ += group->pending;
+		lock.unlock();
+
+		//completion may be called before return(POLL mode)
+		Issue(group);
+	}
+}
+
+template<typename TMasterT>
+void Scanner<TMasterT>::Issue(const GroupPtr &group)
+{
+	for (auto &item : group->items) {
+		Completion complete = [this, group](int ret, const uint8_t*) {
+			this->Complete(group, ret);
+		};
+
+		int ret = -EINVAL;
+		switch (item.fun) {
+		case kFunReadCoils:
+			ret = master_.ReadCoilsAsync(item.sid,
+				item.reg, item.num, std::move(complete));
+			break;
+		case kFunReadDiscreteInputs:
+			ret = master_.ReadDiscreteInputsAsync(item.sid,
+				item.reg, item.num, std::move(complete));
+			break;
+		case kFunReadHoldingRegisters:
+			ret = master_.ReadHoldingRegistersAsync(item.sid,
+				item.reg, item.num, std::move(complete));
+			break;
+		case kFunReadInputRegisters:
+			ret = master_.ReadInputRegistersAsync(item.sid,
+				item.reg, item.num, std::move(complete));
+			break;
+		default:
+			break;
+		}
+
+		if (ret < 0) { //complete will not be called
+			YMB_DEBUG("Scanner issue read failed! ret = %d\n", ret);
+			Complete(group, ret);
+		}
+	}
+}
+
+//ret: result of one read, see Completion
+template<typename TMasterT>
+void Scanner<TMasterT>::Complete(const GroupPtr &group, int ret)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	if (ret < 0)
+		group->failed = true;
+
+	YMB_ASSERT(group->pending != 0);
+	if (--group->pending == 0) { //cycle completed
+		if (group->failed)
+			group->stat.errors++;
+		group->stat.lastdur = static_cast<long>(std::chrono::duration_cast<
+			std::chrono::milliseconds>(Clock::now() - group->issued).count());
+	}
+
+	if (--busy_ == 0)
+		doneCond_.notify_all();
+}
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBSCANNER_H__
@@ -7,12 +7,33 @@
 #define __YMODBUS_YSERCONNECT_H__
 
 #include "ymod/master/yconnect.h"
+#include "ymod/ymbdefs.h"
 
 #include <memory>
 #include <string>
 
 namespace YModbus {
 
+//Time of a char on the line
+//stopbits: kSerStopbits1, kSerStopbits15, kSerStopbits2
+//return: us
+inline long GetSerCharTime(uint32_t baudrate,
+	uint8_t databits, char parity, uint8_t stopbits)
+{
+	//start-data-parity-stop, in 1/10 bit
+	uint32_t bits = (1 + databits + (parity != kSerParityNone ? 1 : 0)) * 10
+		+ (stopbits < kSerStopbits1 ? stopbits * 10 : stopbits);
+
+	return static_cast<long>((100000ull * bits + baudrate - 1) / baudrate);
+}
+
+//Silence of 3.5 chars between frames, fixed 1750 us above 19200 bps
+//return: us
+inline long GetSerFrameGap(uint32_t baudrate, long chartime)
+{
+	return baudrate > 19200 ? 1750 : (chartime * 7 + 1) / 2;
+}
+
 class SerConnect : public IConnect
 {
 public:
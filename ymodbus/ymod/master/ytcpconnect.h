@@ -26,6 +26,10 @@ public:
 	bool Send(uint8_t  *buf, size_t len);
 	int Recv(uint8_t *buf, size_t len);
 
+	int Handle(void) const;
+	void SetNonBlock(bool nonblock);
+	void Close(void);
+
 private:
 	struct Impl;
 	std::unique_ptr<Impl> impl_;
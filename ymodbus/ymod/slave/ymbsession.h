@@ -6,6 +6,8 @@
 #ifndef __YMODBUS_YMBSESSION_H__
 #define __YMODBUS_YMBSESSION_H__
 
+#include "ymod/ymbcrc.h"
+
 #include <string>
 #include <memory>
 
@@ -22,6 +24,10 @@ public:
 	virtual void Purge(void) = 0;
 	virtual void Discard(size_t nbytes) = 0;
 
+	//Crc of the bytes received so far, it's reset as the buffer changes
+	//except the bytes appended
+	virtual Crc16Context &RecvCrc(void) = 0;
+
 	virtual ~ISession() {}
 };
 
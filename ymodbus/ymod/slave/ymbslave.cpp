@@ -82,38 +82,50 @@ void Slave::Impl::Accept(void)
 
 	err_ = listener_->Accept(ses_);
 	for (auto &session : ses_) {
-		size_t msglen = session->Peek(&recvmsg);
-		int need = prot_->VerifyMasterMsg(recvmsg, msglen);
-		if (need < 0) { //bad msg
-			YMB_HEXDUMP(recvmsg, msglen, 
-				"Bad master message! len = %u:\n", msglen);
-			session->Purge(); //error, clear port data
-			continue; 
-		}
-
-		//msg has arrived
-		if (need == 0 && prot_->ParseMasterMsg(recvmsg, msglen, inf) == EOK) {
-			session->Purge();	
+		//All msgs received, the tail of a msg is kept for the next bytes
+		size_t msglen;
+		while ((msglen = session->Peek(&recvmsg)) > 0) {
+			int len = prot_->GetMasterMsgLen(recvmsg, msglen);
+			bool whole = len > 0 && static_cast<size_t>(len) <= msglen;
+			size_t framelen = whole ? static_cast<size_t>(len) : msglen;
+
+			int need = len < 0 ? len
+				: prot_->VerifyMasterMsg(recvmsg, framelen, session->RecvCrc());
+			if (need > 0 && !whole)
+				break; //the rest of msg is coming
+
+			if (need != 0) { //bad msg
+				YMB_HEXDUMP(recvmsg, framelen,
+					"Bad master message! len = %u:\n", (unsigned)framelen);
+				if (whole)
+					session->Discard(framelen); //only this msg
+				else
+					session->Purge(); //error, clear port data
+				continue;
+			}
 
 			if (auto monitor = monitor_.lock())
-				monitor->RecvPacket(desc_, recvmsg, msglen);
+				monitor->RecvPacket(desc_, recvmsg, framelen);
 
-			if (inf.id == id_ || id_ == kAnySlaveId) { //token or careless id
+			if (prot_->ParseMasterMsg(recvmsg, framelen, inf) == EOK
+				&& (inf.id == id_ || id_ == kAnySlaveId)) { //token or careless id
 				size_t roff = prot_->GetSlaveDataOffset(inf.fun);
 				int rsp = Request(inf, rspbuf_ + roff, bufsiz_ - roff);
 
 				if (rsp >= 0 && inf.id != kBroadcastId) {
 					inf.databuf = nullptr; //The Datas have filled into rspbuf.
-					msglen = prot_->MakeSlaveMsg(rspbuf_, bufsiz_, inf);
-					session->Write(rspbuf_, msglen);
+					size_t rsplen = prot_->MakeSlaveMsg(rspbuf_, bufsiz_, inf);
+					session->Write(rspbuf_, rsplen);
 
 					if (auto monitor = monitor_.lock())
-						monitor->SendPacket(desc_, rspbuf_, msglen);
+						monitor->SendPacket(desc_, rspbuf_, rsplen);
 
-					YMB_HEXDUMP(rspbuf_, msglen,
-						"Response message! len = %u: \n", msglen);
+					YMB_HEXDUMP(rspbuf_, rsplen,
+						"Response message! len = %u: \n", rsplen);
 				}
 			}
+
+			session->Discard(framelen); //request is done, next msg
 		}
 	}
 }
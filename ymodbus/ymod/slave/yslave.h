@@ -176,28 +176,42 @@ void TSlave<TProtocol, TListener, TPlayer>::Accept(void)
 
 	err_ = listener_.Accept(ses_);
 	for (auto &session : ses_) {
-		size_t msglen = session->Peek(&recvmsg);
-		int need = prot_.VerifyMasterMsg(recvmsg, msglen);
-		if (need < 0) { //bad msg
-			YMB_HEXDUMP(recvmsg, msglen,
-				"Bad master message! len = %u:", msglen);
-			session->Purge(); //error, clear port data
-			continue;
-		}
-
-		//msg has arrived
-		if (need == 0 && prot_.ParseMasterMsg(recvmsg, msglen, inf) == EOK) {
-			if (inf.id == id_ || id_ == kAnySlaveId) { //token or careless id
-				size_t roff = prot_.GetSlaveDataOffset(inf.fun);
-				int rsp = Request(inf, rspbuf_ + roff, bufsiz_ - roff);
-				if (rsp >= 0 && inf.id != kBroadcastId) {
-					inf.databuf = nullptr; //The Datas have filled into rspbuf.
-					msglen = prot_.MakeSlaveMsg(rspbuf_, bufsiz_, inf);
-					session->Purge();	//clear port before response
-					session->Write(rspbuf_, msglen);
-				} //exec ok
-			} //id tocken
-		} //request
+		//All msgs received, the tail of a msg is kept for the next bytes
+		size_t msglen;
+		while ((msglen = session->Peek(&recvmsg)) > 0) {
+			int len = prot_.GetMasterMsgLen(recvmsg, msglen);
+			bool whole = len > 0 && static_cast<size_t>(len) <= msglen;
+			size_t framelen = whole ? static_cast<size_t>(len) : msglen;
+
+			int need = len < 0 ? len
+				: prot_.VerifyMasterMsg(recvmsg, framelen, session->RecvCrc());
+			if (need > 0 && !whole)
+				break; //the rest of msg is coming
+
+			if (need != 0) { //bad msg
+				YMB_HEXDUMP(recvmsg, framelen,
+					"Bad master message! len = %u:", (unsigned)framelen);
+				if (whole)
+					session->Discard(framelen); //only this msg
+				else
+					session->Purge(); //error, clear port data
+				continue;
+			}
+
+			if (prot_.ParseMasterMsg(recvmsg, framelen, inf) == EOK) {
+				if (inf.id == id_ || id_ == kAnySlaveId) { //token or careless id
+					size_t roff = prot_.GetSlaveDataOffset(inf.fun);
+					int rsp = Request(inf, rspbuf_ + roff, bufsiz_ - roff);
+					if (rsp >= 0 && inf.id != kBroadcastId) {
+						inf.databuf = nullptr; //The Datas have filled into rspbuf.
+						size_t rsplen = prot_.MakeSlaveMsg(rspbuf_, bufsiz_, inf);
+						session->Write(rspbuf_, rsplen);
+					} //exec ok
+				} //id tocken
+			} //request
+
+			session->Discard(framelen); //request is done, next msg
+		} //while msgs
 	} //for ses_
 }
 
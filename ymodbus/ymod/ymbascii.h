@@ -8,11 +8,12 @@
 
 #include "ymod/ymbprot.h"
 #include "ymod/ymbdefs.h"
+#include "ymod/ymbhex.h"
 #include "ymblog.h"
 
 #include <memory>
 #include <algorithm>
-#include <numeric>
+#include <cstring>
 
 namespace YModbus {
 
@@ -36,32 +37,10 @@ public:
 	{
 		YMB_ASSERT(bufsiz >= kMaxAsciiMsgLen);
 
-		uint8_t *pbuf = buf;
 		uint8_t *prtu = buf + kRtuBufOff;
 		size_t msglen = Protocol::MakeMasterMsg(prtu, bufsiz-kRtuBufOff, inf);
-		uint8_t lrc = (uint8_t)(~std::accumulate(prtu, prtu + msglen, 0) + 1);
-
-		*pbuf++ = ':'; //start char
-		std::for_each(prtu, prtu + msglen, [&pbuf](uint8_t d) {
-			*pbuf = static_cast<uint8_t>(d >> 4);
-			*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-			pbuf++;
-			*pbuf = static_cast<uint8_t>(d & 0xf);
-			*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-			pbuf++;
-		});
-
-		*pbuf = static_cast<uint8_t>(lrc >> 4);
-		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-		pbuf++;
-		*pbuf = static_cast<uint8_t>(lrc & 0xf);
-		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-		pbuf++;
-
-		*pbuf++ = '\r';
-		*pbuf++ = '\n';
 
-		msglen = static_cast<size_t>(pbuf - buf);
+		msglen = Encode(buf, prtu, msglen);
 		YMB_ASSERT(bufsiz >= msglen);
 
 		return msglen;
@@ -71,32 +50,10 @@ public:
 	{
 		YMB_ASSERT(bufsiz >= kMaxAsciiMsgLen);
 
-		uint8_t *pbuf = buf;
 		uint8_t *prtu = buf + kRtuBufOff;
 		size_t msglen = Protocol::MakeSlaveMsg(prtu, bufsiz - kRtuBufOff, inf);
-		uint8_t lrc = (uint8_t)(~std::accumulate(prtu, prtu + msglen, 0) + 1);
 
-		*pbuf++ = ':'; //start char
-		std::for_each(prtu, prtu + msglen, [&pbuf](uint8_t d) {
-			*pbuf = static_cast<uint8_t>(d >> 4);
-			*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-			pbuf++;
-			*pbuf = static_cast<uint8_t>(d & 0xf);
-			*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-			pbuf++;
-		});
-
-		*pbuf = static_cast<uint8_t>(lrc >> 4);
-		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-		pbuf++;
-		*pbuf = static_cast<uint8_t>(lrc & 0xf);
-		*pbuf += *pbuf <= 9 ? '0' : 'A' - 0xA;
-		pbuf++;
-
-		*pbuf++ = '\r';
-		*pbuf++ = '\n';
-
-		msglen = static_cast<size_t>(pbuf - buf);
+		msglen = Encode(buf, prtu, msglen);
 		YMB_ASSERT(bufsiz >= msglen);
 
 		return msglen;
@@ -114,6 +71,9 @@ public:
 		if (msglen > kMaxAsciiMsgLen)
 			return -EBADMSG;
 
+		if (msg[msglen - 1] == '\r')
+			return 1;	//expect '\n'
+
 		if (msg[msglen - 2] != '\r')
 			return 2;	//expect '\r\n'
 
@@ -123,6 +83,11 @@ public:
 		return EOK;
 	}
 
+	int VerifyMasterMsg(uint8_t *msg, size_t msglen, Crc16Context & /*crc*/)
+	{
+		return VerifyMasterMsg(msg, msglen); //lrc is checked in parse
+	}
+
 	int VerifySlaveMsg(uint8_t *msg, size_t msglen)
 	{
 		if (msglen < kMinAsciiMsgLen) //:-id-fun-err-lrc-\r\n
@@ -134,6 +99,9 @@ public:
 		if (msglen > kMaxAsciiMsgLen)
 			return -EBADMSG;
 
+		if (msg[msglen - 1] == '\r')
+			return 1;	//expect '\n'
+
 		if (msg[msglen - 2] != '\r')
 			return 2;	//expect '\r\n'
 
@@ -143,61 +111,99 @@ public:
 		return EOK;
 	}
 
+	int VerifySlaveMsg(uint8_t *msg, size_t msglen, Crc16Context & /*crc*/)
+	{
+		return VerifySlaveMsg(msg, msglen); //lrc is checked in parse
+	}
+
 	//Used by slave
 	int ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 	{
-		//Transform to base format msg
-		uint8_t *prtu = msg;
-		size_t i;
-
-		for (i = 1; i < msglen - 4; i += 2) {
-			*prtu = msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA;
-			*prtu <<= 4;
-			*prtu |= msg[i+1] <= '9' ? msg[i+1] - '0' : msg[i+1] - 'A' + 0xA;
-			++prtu;
-		}
-
-		//msg has transformed base format
-		size_t rtulen = static_cast<size_t>(prtu - msg);
-		uint8_t lrc = (uint8_t)(~std::accumulate(msg, msg + rtulen, 0) + 1);
+		size_t rtulen;
 
-		lrc -= (msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA) << 4;
-		lrc -= msg[i + 1] <= '9' ? msg[i + 1] - '0' : msg[i + 1] - 'A' + 0xA;
-
-		if (lrc == 0 && Protocol::VerifyMasterMsg(msg, rtulen) == EOK)
+		if (Decode(msg, msglen, rtulen) == EOK
+			&& Protocol::VerifyMasterMsg(msg, rtulen) == EOK)
 			return Protocol::ParseMasterMsg(msg, rtulen, inf);
 
 		return -EBADMSG;
 	}
 
-	//Used by master
-	int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
+	//Used by slave
+	//Msg is ended by '\n'
+	int GetMasterMsgLen(uint8_t *msg, size_t msglen)
 	{
-		//Transform to base format msg
-		uint8_t *prtu = msg;
-		size_t i;
+		if (msglen == 0)
+			return 0;
+
+		if (msg[0] != ':')
+			return -EBADMSG;
 
-		for (i = 1; i < msglen - 4; i += 2) {
-			*prtu = msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA;
-			*prtu <<= 4;
-			*prtu |= msg[i+1] <= '9' ? msg[i+1] - '0' : msg[i+1] - 'A' + 0xA;
-			++prtu;
-		}
+		size_t len = std::min(msglen, kMaxAsciiMsgLen);
+		const void *end = memchr(msg, '\n', len);
+		if (end != nullptr)
+			return static_cast<int>(static_cast<const uint8_t*>(end) - msg + 1);
 
-		//msg has transformed base format
-		size_t rtulen = static_cast<size_t>(prtu - msg);
-		uint8_t lrc = (uint8_t)(~std::accumulate(msg, msg + rtulen, 0) + 1);
+		return len < kMaxAsciiMsgLen ? 0 : -EBADMSG;
+	}
 
-		lrc -= (msg[i] <= '9' ? msg[i] - '0' : msg[i] - 'A' + 0xA) << 4;
-		lrc -= msg[i + 1] <= '9' ? msg[i + 1] - '0' : msg[i + 1] - 'A' + 0xA;
+	//Used by master
+	int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
+	{
+		size_t rtulen;
 
-		if (lrc == 0 && Protocol::VerifySlaveMsg(msg, rtulen) == EOK)
+		if (Decode(msg, msglen, rtulen) == EOK
+			&& Protocol::VerifySlaveMsg(msg, rtulen) == EOK)
 			return Protocol::ParseSlaveMsg(msg, rtulen, inf);
 
 		return -EBADMSG;
 	}
 
+	//Used by master pipeline
+	int GetTransactionId(const uint8_t * /*msg*/, size_t /*msglen*/)
+	{
+		return -1; //No transaction id in ascii msg
+	}
+
+	//Used by master
+	int ExpectSlaveMsgLen(const MsgInf & /*inf*/)
+	{
+		return 0; //Frame is ended by CR LF
+	}
+
 private:
+	//:-hex of rtu msg-lrc-\r\n, prtu is behind buf by kRtuBufOff
+	static size_t Encode(uint8_t *buf, const uint8_t *prtu, size_t rtulen)
+	{
+		uint8_t *pbuf = buf;
+
+		*pbuf++ = ':'; //start char
+		uint8_t lrc = static_cast<uint8_t>(-HexEncode(prtu, rtulen, pbuf));
+		pbuf += rtulen * 2;
+
+		HexEncode(&lrc, 1, pbuf);
+		pbuf += 2;
+
+		*pbuf++ = '\r';
+		*pbuf++ = '\n';
+
+		return static_cast<size_t>(pbuf - buf);
+	}
+
+	//Transform msg to base format in place, the lrc is checked
+	int Decode(uint8_t *msg, size_t msglen, size_t &rtulen)
+	{
+		uint8_t sum;
+
+		if (msglen < kMinAsciiMsgLen || (msglen - 5) % 2 != 0) //odd hex characters
+			return -EBADMSG;
+
+		rtulen = (msglen - 5) / 2;
+		if (HexDecode(msg + 1, rtulen + 1, msg, sum) != EOK)
+			return -EBADMSG; //not hex
+
+		return sum == 0 ? EOK : -EBADMSG; //lrc is included
+	}
+
 	const size_t kMinAsciiMsgLen = 8;
 	const size_t kMaxAsciiMsgLen = 513;
 	const size_t kMaxRtuMsgLen = 254;
@@ -0,0 +1,195 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBCOMPL_H__
+#define __YMODBUS_YMBCOMPL_H__
+
+#include "ymblog.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <new>
+
+namespace YModbus {
+
+template<typename TMasterT> class MasterPool;
+template<typename TMasterT> class BusGroup;
+
+//Completion of asynchronous api, called in master task thread.
+//Don't call synchronous api of the same master in it.
+//ret: >= 0, bytes of data to return(read), or EOK(write);
+//ret: < 0, errorcode of exception
+//buf: data value, net order, only valid in the callback
+//Callables up to kInlineSize bytes are held in the completion, so a
+//request doesn't allocate memory; larger ones are allocated.
+class Completion
+{
+public:
+	static const size_t kInlineSize = 8 * sizeof(void*);
+
+	Completion() : ops_(nullptr), hook_(nullptr), ctx_(nullptr) {}
+	Completion(std::nullptr_t) : Completion() {}
+
+	//f: void(int ret, const uint8_t *buf)
+	template<typename F, typename = typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type, Completion>::value>::type>
+	Completion(F f)
+		: Completion()
+	{
+		typedef typename std::conditional<Fits<F>::value,
+			Inline<F>, Allocated<F>>::type Holder;
+
+		Holder::Create(&buf_, std::move(f));
+		ops_ = &Holder::ops;
+	}
+
+	Completion(const Completion &other)
+		: ops_(other.ops_), hook_(other.hook_), ctx_(other.ctx_)
+	{
+		if (ops_ != nullptr)
+			ops_->copy(&buf_, &other.buf_);
+	}
+
+	Completion(Completion &&other)
+		: Completion()
+	{
+		Take(other);
+	}
+
+	~Completion() { Reset(); }
+
+	Completion &operator = (Completion other)
+	{
+		Reset();
+		Take(other);
+		return *this;
+	}
+
+	Completion &operator = (std::nullptr_t)
+	{
+		Reset();
+		return *this;
+	}
+
+	explicit operator bool() const { return ops_ != nullptr || hook_ != nullptr; }
+
+	void operator () (int ret, const uint8_t *buf) const
+	{
+		if (ops_ != nullptr)
+			ops_->call(&buf_, ret, buf);
+		if (hook_ != nullptr)
+			hook_(ctx_);
+	}
+
+private:
+	template<typename TMasterT> friend class MasterPool;
+	template<typename TMasterT> friend class BusGroup;
+
+	//Call hook(ctx) after the callable, for the wrappers of the api to
+	//count requests in flight without wrapping the callable, one at most
+	void Then(void (*hook)(void *ctx), void *ctx)
+	{
+		YMB_ASSERT(hook_ == nullptr);
+		hook_ = hook;
+		ctx_ = ctx;
+	}
+
+	typedef typename std::aligned_storage<kInlineSize>::type Buffer;
+
+	struct Ops
+	{
+		void (*call)(void *buf, int ret, const uint8_t *data);
+		void (*copy)(void *dst, const void *src);
+		void (*move)(void *dst, void *src); //src is destroyed
+		void (*destroy)(void *buf);
+	};
+
+	template<typename F>
+	struct Fits : std::integral_constant<bool, sizeof(F) <= sizeof(Buffer)
+		&& std::alignment_of<Buffer>::value % std::alignment_of<F>::value == 0
+		&& std::is_nothrow_move_constructible<F>::value>
+	{
+	};
+
+	template<typename F>
+	struct Inline
+	{
+		static void Create(void *buf, F &&f) { new (buf) F(std::move(f)); }
+		static F &Get(void *buf) { return *static_cast<F*>(buf); }
+
+		static void Call(void *buf, int ret, const uint8_t *data) { Get(buf)(ret, data); }
+		static void Copy(void *dst, const void *src) { new (dst) F(*static_cast<const F*>(src)); }
+		static void Move(void *dst, void *src)
+		{
+			new (dst) F(std::move(Get(src)));
+			Get(src).~F();
+		}
+		static void Destroy(void *buf) { Get(buf).~F(); }
+
+		static const Ops ops;
+	};
+
+	template<typename F>
+	struct Allocated
+	{
+		static void Create(void *buf, F &&f) { Get(buf) = new F(std::move(f)); }
+		static F *&Get(void *buf) { return *static_cast<F**>(buf); }
+
+		static void Call(void *buf, int ret, const uint8_t *data) { (*Get(buf))(ret, data); }
+		static void Copy(void *dst, const void *src)
+		{
+			Get(dst) = new F(**static_cast<F* const*>(src));
+		}
+		static void Move(void *dst, void *src) { Get(dst) = Get(src); }
+		static void Destroy(void *buf) { delete Get(buf); }
+
+		static const Ops ops;
+	};
+
+	//this is empty
+	void Take(Completion &other)
+	{
+		ops_ = other.ops_;
+		hook_ = other.hook_;
+		ctx_ = other.ctx_;
+		if (ops_ != nullptr)
+			ops_->move(&buf_, &other.buf_);
+		other.ops_ = nullptr;
+		other.hook_ = nullptr;
+		other.ctx_ = nullptr;
+	}
+
+	void Reset(void)
+	{
+		if (ops_ != nullptr)
+			ops_->destroy(&buf_);
+		ops_ = nullptr;
+		hook_ = nullptr;
+		ctx_ = nullptr;
+	}
+
+	mutable Buffer buf_; //callable, or pointer to it if allocated
+	const Ops *ops_;	//of the callable, or null
+	void (*hook_)(void *ctx);
+	void *ctx_;
+};
+
+template<typename F>
+const Completion::Ops Completion::Inline<F>::ops = {
+	&Completion::Inline<F>::Call, &Completion::Inline<F>::Copy,
+	&Completion::Inline<F>::Move, &Completion::Inline<F>::Destroy
+};
+
+template<typename F>
+const Completion::Ops Completion::Allocated<F>::ops = {
+	&Completion::Allocated<F>::Call, &Completion::Allocated<F>::Copy,
+	&Completion::Allocated<F>::Move, &Completion::Allocated<F>::Destroy
+};
+
+} //namespace YModbus
+
+#endif //__YMODBUS_YMBCOMPL_H__
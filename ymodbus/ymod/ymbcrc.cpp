@@ -5,6 +5,19 @@
 */
 #include "ymod/ymbcrc.h"
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#	define YMB_CRC_CLMUL
+#	include <wmmintrin.h>
+#	include <emmintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#		define YMB_TARGET_CLMUL
+#	else
+#		include <cpuid.h>
+#		define YMB_TARGET_CLMUL __attribute__((target("pclmul,sse2")))
+#	endif
+#endif
+
 namespace YModbus {
 
 namespace {
@@ -59,12 +72,30 @@ const uint8_t auclo[] = {
 	0x41, 0x81, 0x80, 0x40
 };
 
-} //namespace {
+//Reflected, register = (register >> 8) ^ table[(register ^ byte) & 0xff]
+//t[k][i]: byte i followed by k zero bytes, t[0] is auclo:auchi
+struct Tables
+{
+	Tables()
+	{
+		for (int i = 0; i < 256; i++)
+			t[0][i] = static_cast<uint16_t>(auclo[i] << 8 | auchi[i]);
+
+		for (int k = 1; k < 16; k++) {
+			for (int i = 0; i < 256; i++)
+				t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+		}
+	}
 
-uint16_t Crc16(uint8_t *msg, uint16_t len)
+	uint16_t t[16][256];
+};
+
+const Tables tables;
+
+uint16_t CrcByte(uint16_t crc, const uint8_t *msg, size_t len)
 {
-	uint8_t hi = 0xFF;
-	uint8_t lo = 0xFF;
+	uint8_t hi = static_cast<uint8_t>(crc >> 8);
+	uint8_t lo = static_cast<uint8_t>(crc);
 	int i;
 
 	while (len--) {
@@ -76,4 +107,180 @@ uint16_t Crc16(uint8_t *msg, uint16_t len)
 	return (uint16_t)(hi << 8 | lo);
 }
 
+uint16_t CrcSlice8(uint16_t crc, const uint8_t *msg, size_t len)
+{
+	const uint16_t (*t)[256] = tables.t;
+
+	for (; len >= 8; msg += 8, len -= 8) {
+		crc ^= msg[0] | msg[1] << 8;
+		crc = t[7][crc & 0xff] ^ t[6][crc >> 8]
+			^ t[5][msg[2]] ^ t[4][msg[3]] ^ t[3][msg[4]]
+			^ t[2][msg[5]] ^ t[1][msg[6]] ^ t[0][msg[7]];
+	}
+
+	return CrcByte(crc, msg, len);
+}
+
+uint16_t CrcSlice16(uint16_t crc, const uint8_t *msg, size_t len)
+{
+	const uint16_t (*t)[256] = tables.t;
+
+	for (; len >= 16; msg += 16, len -= 16) {
+		crc ^= msg[0] | msg[1] << 8;
+		crc = t[15][crc & 0xff] ^ t[14][crc >> 8]
+			^ t[13][msg[2]] ^ t[12][msg[3]] ^ t[11][msg[4]]
+			^ t[10][msg[5]] ^ t[9][msg[6]] ^ t[8][msg[7]]
+			^ t[7][msg[8]] ^ t[6][msg[9]] ^ t[5][msg[10]]
+			^ t[4][msg[11]] ^ t[3][msg[12]] ^ t[2][msg[13]]
+			^ t[1][msg[14]] ^ t[0][msg[15]];
+	}
+
+	return CrcSlice8(crc, msg, len);
+}
+
+#if defined(YMB_CRC_CLMUL)
+
+//x^n mod P, P = x^16 + x^15 + x^2 + 1, bit-reflected into 64 bits
+//(bit j is x^(63-j)), as the 16 bytes loaded from msg
+uint64_t XnModP(unsigned n)
+{
+	uint32_t r = 1; //x^0
+
+	while (n--) {
+		r <<= 1;
+		if (r & 0x10000)
+			r ^= 0x18005;
+	}
+
+	uint64_t k = 0;
+	for (int d = 0; d < 16; d++) {
+		if (r & (1u << d))
+			k |= 1ull << (63 - d);
+	}
+
+	return k;
+}
+
+bool ClmulSupported(void)
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 1)) != 0; //PCLMULQDQ
+#else
+	unsigned a, b, c, d;
+	return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_PCLMUL) != 0;
+#endif
+}
+
+//16 bytes are folded into the next 16 bytes by carry-less multiply,
+//the CRC of the message is kept. The product of reflected operands is
+//a bit short of 128 bits, so the constants are of x^(n - 1).
+//The last 16 bytes and the tail are left to the table.
+YMB_TARGET_CLMUL
+uint16_t CrcClmul(uint16_t crc, const uint8_t *msg, size_t len)
+{
+	static const uint64_t k128 = XnModP(128 - 1);
+	static const uint64_t k192 = XnModP(128 + 64 - 1);
+
+	if (len < 32)
+		return CrcSlice16(crc, msg, len);
+
+	const __m128i k = _mm_set_epi64x(static_cast<long long>(k128),
+		static_cast<long long>(k192));
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(msg));
+
+	v = _mm_xor_si128(v, _mm_cvtsi32_si128(crc)); //initial value
+	for (msg += 16, len -= 16; len >= 16; msg += 16, len -= 16) {
+		__m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(msg));
+		v = _mm_xor_si128(next, _mm_xor_si128(
+			_mm_clmulepi64_si128(v, k, 0x00), _mm_clmulepi64_si128(v, k, 0x11)));
+	}
+
+	uint8_t last[16];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(last), v);
+
+	return CrcSlice16(CrcSlice16(0, last, sizeof(last)), msg, len);
+}
+
+#endif //YMB_CRC_CLMUL
+
+typedef uint16_t (*Kernel)(uint16_t crc, const uint8_t *msg, size_t len);
+
+const size_t kMinSliceLen = 8; //below it the tables are only in the way
+const size_t kMinClmulLen = 64; //below it slicing is as fast
+
+uint16_t CrcAuto(uint16_t crc, const uint8_t *msg, size_t len)
+{
+	if (len < kMinSliceLen)
+		return CrcByte(crc, msg, len);
+
+#if defined(YMB_CRC_CLMUL)
+	if (len >= kMinClmulLen && Crc16Supported(CRC_CLMUL))
+		return CrcClmul(crc, msg, len);
+#endif
+
+	return CrcSlice16(crc, msg, len);
+}
+
+Kernel GetKernel(eCrcKernel kernel)
+{
+	switch (kernel) {
+	case CRC_BYTE:
+		return CrcByte;
+	case CRC_SLICE8:
+		return CrcSlice8;
+	case CRC_SLICE16:
+		return CrcSlice16;
+#if defined(YMB_CRC_CLMUL)
+	case CRC_CLMUL:
+		return Crc16Supported(CRC_CLMUL) ? CrcClmul : CrcAuto;
+#endif
+	default:
+		return CrcAuto;
+	}
+}
+
+} //namespace {
+
+uint16_t Crc16(const uint8_t *msg, size_t len)
+{
+	return CrcAuto(0xFFFF, msg, len);
+}
+
+uint16_t Crc16(const uint8_t *msg, size_t len, eCrcKernel kernel)
+{
+	return GetKernel(kernel)(0xFFFF, msg, len);
+}
+
+uint16_t Crc16Context::Update(const uint8_t *msg, size_t len)
+{
+	if (len < len_) //not the message added, start over
+		Reset();
+
+	crc_ = CrcAuto(crc_, msg + len_, len - len_);
+	len_ = len;
+
+	return crc_;
+}
+
+bool Crc16Supported(eCrcKernel kernel)
+{
+	switch (kernel) {
+	case CRC_AUTO:
+	case CRC_BYTE:
+	case CRC_SLICE8:
+	case CRC_SLICE16:
+		return true;
+#if defined(YMB_CRC_CLMUL)
+	case CRC_CLMUL: {
+		static const bool clmul = ClmulSupported();
+		return clmul;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
 } //namespace YModbus
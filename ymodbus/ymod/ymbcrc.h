@@ -7,10 +7,45 @@
 #define __YMODBUS_YMBCRC_H__
 
 #include <cstdint>
+#include <cstddef>
 
 namespace YModbus {
-	
-uint16_t Crc16(uint8_t *msg, uint16_t len);
+
+typedef enum {
+	CRC_AUTO,		//the fastest supported, by the length and the cpu
+	CRC_BYTE,		//a byte per step, portable
+	CRC_SLICE8,		//8 bytes per step, 8 tables
+	CRC_SLICE16,	//16 bytes per step, 16 tables
+	CRC_CLMUL,		//folding with carry-less multiply(PCLMULQDQ), x86
+} eCrcKernel;
+
+//CRC-16/MODBUS of msg, low byte is sent first
+uint16_t Crc16(const uint8_t *msg, size_t len);
+//kernel: not supported is CRC_AUTO, for tests and benchs
+uint16_t Crc16(const uint8_t *msg, size_t len, eCrcKernel kernel);
+bool Crc16Supported(eCrcKernel kernel);
+
+//Crc16 of a message arriving in pieces, only the bytes not added yet are
+//processed. Reset it when the buffer of the message is refilled.
+class Crc16Context
+{
+public:
+	void Reset(void)
+	{
+		crc_ = 0xFFFF;
+		len_ = 0;
+	}
+
+	//msg: the message so far, msg[Length(), len) are added
+	//return: crc of msg[0, len)
+	uint16_t Update(const uint8_t *msg, size_t len);
+
+	size_t Length(void) const { return len_; }
+
+private:
+	uint16_t crc_ = 0xFFFF;
+	size_t len_ = 0; //bytes added
+};
 
 } //namespace YModbus
 
@@ -18,6 +18,9 @@
 #define kSerStopbits2		20 // TWOSTOPBITS         
 
 #define kMaxRegNum			125
+#define kMaxWriteRegNum		123
+#define kMaxWriteBitNum		1968
+#define kMaxBitNum			2000
 #define kAnySlaveId			0
 #define kBroadcastId		0
 
@@ -78,6 +81,15 @@ typedef enum {
 	SM_XchangedByteStream
 } eStringMode;
 
+//Priority class of master requests
+typedef enum {
+	PRIO_ALARM = 0,	//always executed first
+	PRIO_HIGH,
+	PRIO_NORMAL,	//requests out of RequestScope
+	PRIO_BULK,		//shared with Pull* querys
+	PRIO_NUM,
+} ePriority;
+
 const uint8_t kFunReadCoils				= 0x01;
 const uint8_t kFunReadDiscreteInputs	= 0x02;
 const uint8_t kFunReadHoldingRegisters	= 0x03;
@@ -93,6 +105,51 @@ const uint8_t kFunWriteAndReadRegisters = 0x17;
 #define INVALID_REG 0xffff
 #define INVALID_NUM 0xffff
 
+//One block of ReadBatch
+struct ReadSpec
+{
+	uint8_t sid;
+	uint8_t fun;	//kFunReadCoils ~ kFunReadInputRegisters
+	uint16_t reg;
+	uint16_t num;
+	uint8_t *buf;	//datas read, net order
+	size_t bufsiz;
+};
+
+//Priority and deadline of the master requests submitted by this thread
+//while the scope is alive, nested scopes are restored on destruction.
+//deadline: ms, request not sent in it after submission is completed
+//with -ETIMEDOUT, 0: no deadline
+class RequestScope
+{
+public:
+	struct Options
+	{
+		ePriority prio;
+		long deadline;
+	};
+
+	explicit RequestScope(ePriority prio, long deadline = 0)
+		: saved_(Current())
+	{
+		Current() = { prio, deadline };
+	}
+
+	~RequestScope() { Current() = saved_; }
+
+	RequestScope(const RequestScope&) = delete;
+	RequestScope &operator = (const RequestScope&) = delete;
+
+	static Options &Current(void)
+	{
+		static thread_local Options opts = { PRIO_NORMAL, 0 };
+		return opts;
+	}
+
+private:
+	Options saved_;
+};
+
 } //namespace YModbus
 
 #endif //__YMODBUS_YMBDEFS_H__
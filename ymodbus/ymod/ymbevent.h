@@ -0,0 +1,82 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBEVENT_H__
+#define __YMODBUS_YMBEVENT_H__
+
+#include <atomic>
+
+#ifdef WIN32
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace YModbus {
+
+//Wakeup of one waiting thread, eventfd on linux.
+//Notify only enters the kernel while the waiter is sleeping.
+class Event
+{
+public:
+	Event();
+	~Event();
+
+	Event(const Event&) = delete;
+	Event &operator = (const Event&) = delete;
+
+	//Any thread, after publishing the work
+	void Notify(void)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting_.load(std::memory_order_relaxed) && waiting_.exchange(false))
+			Signal();
+	}
+
+	//Waiter thread, sleep until notified or timeout, unless ready
+	//ms: timeout
+	//ready: bool(void), checked after the waiter is armed
+	template<typename F>
+	void WaitFor(long ms, F ready)
+	{
+		waiting_.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!ready())
+			Wait(ms);
+
+		waiting_.store(false);
+	}
+
+	//Waiter thread, sleep in a poller of Handle instead of WaitFor
+	//Arm before checking ready, Disarm after the poller returned
+	void Arm(void)
+	{
+		waiting_.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	void Disarm(void);
+
+	//Descriptor to poll for readable, -1 if not surpported
+	int Handle(void) const;
+
+private:
+	void Signal(void);
+	void Wait(long ms);
+
+	std::atomic<bool> waiting_;
+
+#ifdef WIN32
+	bool signaled_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+#else
+	int fd_;
+#endif
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBEVENT_H__
@@ -0,0 +1,182 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#include "ymod/ymbhex.h"
+#include "ymod/ymbdefs.h"
+
+#include <cerrno>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define YMB_HEX_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace YModbus {
+
+namespace {
+
+const uint8_t kBadHex = 0xFF;
+
+//Value of each character, kBadHex if not a hex digit
+struct HexTable
+{
+	HexTable()
+	{
+		for (int c = 0; c < 256; c++)
+			val[c] = kBadHex;
+
+		for (int i = 0; i < 10; i++)
+			val['0' + i] = static_cast<uint8_t>(i);
+
+		for (int i = 0; i < 6; i++) {
+			val['A' + i] = static_cast<uint8_t>(0xA + i);
+			val['a' + i] = static_cast<uint8_t>(0xA + i);
+		}
+	}
+
+	uint8_t val[256];
+};
+
+const HexTable table;
+
+inline uint8_t HexChar(uint8_t nibble)
+{
+	return static_cast<uint8_t>(nibble + (nibble <= 9 ? '0' : 'A' - 0xA));
+}
+
+#if defined(YMB_HEX_SSE2)
+
+//16 bytes to 32 characters
+//sum: sums of the bytes in 2 64-bit lanes
+inline void EncodeBlock(const uint8_t *data, uint8_t *hex, __m128i &sum)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i alpha = _mm_set1_epi8('A' - 0xA - '0');
+
+	__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(d, 4), mask);
+	__m128i lo = _mm_and_si128(d, mask);
+
+	sum = _mm_add_epi64(sum, _mm_sad_epu8(d, _mm_setzero_si128()));
+
+	//high nibble first
+	__m128i n0 = _mm_unpacklo_epi8(hi, lo);
+	__m128i n1 = _mm_unpackhi_epi8(hi, lo);
+
+	n0 = _mm_add_epi8(_mm_add_epi8(n0, zero),
+		_mm_and_si128(_mm_cmpgt_epi8(n0, nine), alpha));
+	n1 = _mm_add_epi8(_mm_add_epi8(n1, zero),
+		_mm_and_si128(_mm_cmpgt_epi8(n1, nine), alpha));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(hex), n0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 16), n1);
+}
+
+//Nibbles of 16 characters
+//bad: bytes of not hex characters are set
+inline __m128i DecodeNibbles(const uint8_t *hex, __m128i &bad)
+{
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i five = _mm_set1_epi8(5);
+	const __m128i lower = _mm_set1_epi8(0x20);
+
+	__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex));
+	__m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i alpha = _mm_sub_epi8(_mm_or_si128(c, lower), _mm_set1_epi8('a'));
+
+	//unsigned x <= n, as x == min(x, n)
+	__m128i numeral = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+	__m128i letter = _mm_cmpeq_epi8(_mm_min_epu8(alpha, five), alpha);
+
+	bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(numeral, letter),
+		_mm_set1_epi8(-1)));
+
+	return _mm_or_si128(_mm_and_si128(numeral, digit),
+		_mm_and_si128(letter, _mm_add_epi8(alpha, _mm_set1_epi8(0xA))));
+}
+
+//32 characters to 16 bytes
+inline void DecodeBlock(const uint8_t *hex, uint8_t *data, __m128i &sum, __m128i &bad)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+
+	//high nibble in the low byte of each 16-bit lane
+	__m128i n0 = DecodeNibbles(hex, bad);
+	__m128i n1 = DecodeNibbles(hex + 16, bad);
+
+	n0 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n0, mask), 4), _mm_srli_epi16(n0, 8));
+	n1 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n1, mask), 4), _mm_srli_epi16(n1, 8));
+
+	__m128i d = _mm_packus_epi16(n0, n1);
+
+	sum = _mm_add_epi64(sum, _mm_sad_epu8(d, _mm_setzero_si128()));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(data), d);
+}
+
+inline uint8_t SumOf(__m128i sum)
+{
+	return static_cast<uint8_t>(_mm_cvtsi128_si32(sum)
+		+ _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+
+#endif //YMB_HEX_SSE2
+
+} //namespace {
+
+uint8_t HexEncode(const uint8_t *data, size_t len, uint8_t *hex)
+{
+	uint8_t sum = 0;
+
+#if defined(YMB_HEX_SSE2)
+	__m128i sums = _mm_setzero_si128();
+
+	for (; len >= 16; data += 16, hex += 32, len -= 16)
+		EncodeBlock(data, hex, sums);
+
+	sum = SumOf(sums);
+#endif
+
+	for (; len > 0; data++, len--) {
+		uint8_t d = *data; //hex may be over it
+		sum = static_cast<uint8_t>(sum + d);
+		*hex++ = HexChar(static_cast<uint8_t>(d >> 4));
+		*hex++ = HexChar(static_cast<uint8_t>(d & 0x0F));
+	}
+
+	return sum;
+}
+
+int HexDecode(const uint8_t *hex, size_t len, uint8_t *data, uint8_t &sum)
+{
+	uint8_t bad = 0;
+
+	sum = 0;
+
+#if defined(YMB_HEX_SSE2)
+	__m128i sums = _mm_setzero_si128();
+	__m128i bads = _mm_setzero_si128();
+
+	for (; len >= 16; hex += 32, data += 16, len -= 16)
+		DecodeBlock(hex, data, sums, bads);
+
+	sum = SumOf(sums);
+	bad = _mm_movemask_epi8(bads) != 0 ? kBadHex : 0;
+#endif
+
+	for (; len > 0; hex += 2, len--) {
+		uint8_t hi = table.val[hex[0]];
+		uint8_t lo = table.val[hex[1]];
+
+		bad |= hi | lo; //kBadHex has the bits above a nibble
+		*data = static_cast<uint8_t>(hi << 4 | (lo & 0x0F));
+		sum = static_cast<uint8_t>(sum + *data++);
+	}
+
+	return (bad & 0xF0) == 0 ? EOK : -EBADMSG;
+}
+
+} //namespace YModbus
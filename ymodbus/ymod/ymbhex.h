@@ -0,0 +1,28 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBHEX_H__
+#define __YMODBUS_YMBHEX_H__
+
+#include <cstdint>
+#include <cstddef>
+
+namespace YModbus {
+
+//Hex characters of data for ascii msg, 2 per byte in upper case
+//hex: 2 * len bytes, data may be behind it in the same buffer, at least
+//len bytes after hex
+//return: sum of data, the lrc is its two's complement
+uint8_t HexEncode(const uint8_t *data, size_t len, uint8_t *hex);
+
+//Data of 2 * len hex characters, upper or lower case
+//data: len bytes, may be hex or before it(decoded in place)
+//sum: sum of data
+//return: EOK; -EBADMSG, not a hex character
+int HexDecode(const uint8_t *hex, size_t len, uint8_t *data, uint8_t &sum);
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBHEX_H__
@@ -8,6 +8,7 @@
 
 #include "ymod/ymbdefs.h"
 #include "ymod/ymbprot.h"
+#include "ymbopts.h"
 #include "ymblog.h"
 
 #include <memory>
@@ -32,11 +33,11 @@ public:
 
 	size_t MakeMasterMsg(uint8_t *buf, size_t bufsiz, MsgInf &inf)
 	{
-		tid_++;
+		inf.tid = ++tid_;
 
 		//tid
-		buf[0] = static_cast<uint8_t>(tid_ >> 8);
-		buf[1] = static_cast<uint8_t>(tid_ & 0xff);
+		buf[0] = static_cast<uint8_t>(inf.tid >> 8);
+		buf[1] = static_cast<uint8_t>(inf.tid & 0xff);
 
 		//protocol type
 		buf[2] = buf[3] = 0;
@@ -54,8 +55,8 @@ public:
 	size_t MakeSlaveMsg(uint8_t *buf, size_t bufsiz, MsgInf &inf)
 	{
 		//tid
-		buf[0] = static_cast<uint8_t>(tid_ >> 8);
-		buf[1] = static_cast<uint8_t>(tid_ & 0xff);
+		buf[0] = static_cast<uint8_t>(inf.tid >> 8);
+		buf[1] = static_cast<uint8_t>(inf.tid & 0xff);
 
 		//protocol type
 		buf[2] = buf[3] = 0;
@@ -78,6 +79,11 @@ public:
 		return static_cast<int>(kHdrSiz - msglen);
 	}
 
+	int VerifyMasterMsg(uint8_t *msg, size_t msglen, Crc16Context & /*crc*/)
+	{
+		return VerifyMasterMsg(msg, msglen); //No crc
+	}
+
 	int VerifySlaveMsg(uint8_t *msg, size_t msglen)
 	{
 		if (msglen >= kHdrSiz)
@@ -86,29 +92,64 @@ public:
 		return static_cast<int>(kHdrSiz - msglen);
 	}
 
+	int VerifySlaveMsg(uint8_t *msg, size_t msglen, Crc16Context & /*crc*/)
+	{
+		return VerifySlaveMsg(msg, msglen); //No crc
+	}
+
 	//Used by slave
 	int ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 	{
 		//Buffer the tid for rsp msg
-		tid_ = (msg[0] << 8) | msg[1];
+		inf.tid = static_cast<uint16_t>((msg[0] << 8) | msg[1]);
 
 		return Protocol::ParseMasterMsg(msg + kHdrSiz, msglen - kHdrSiz, inf);
 	}
 
+	//Used by slave
+	//The length field of mbap header
+	int GetMasterMsgLen(uint8_t *msg, size_t msglen)
+	{
+		if (msglen < kHdrSiz)
+			return 0;
+
+		size_t len = (msg[4] << 8) | msg[5];
+		if (msg[2] != 0 || msg[3] != 0 || len < 2 || len > kMaxMsgLen - kHdrSiz)
+			return -EBADMSG; //not modbus, or never fits in buffer
+
+		return static_cast<int>(len + kHdrSiz);
+	}
+
 	//Used by master
 	int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 	{
 		uint16_t tid = (msg[0] << 8) | msg[1];
 
-		if (tid_ == tid) 
+		//tid of the request is in inf
+		if (inf.tid == tid) 
 			return Protocol::ParseSlaveMsg(msg + kHdrSiz, msglen - kHdrSiz, inf);
 		
 		return -EBADMSG;
 	}
 
+	//Used by master pipeline
+	int GetTransactionId(const uint8_t *msg, size_t msglen)
+	{
+		if (msglen < 2)
+			return -1;
+
+		return (msg[0] << 8) | msg[1];
+	}
+
+	//Used by master
+	int ExpectSlaveMsgLen(const MsgInf & /*inf*/)
+	{
+		return 0; //A late response may be followed by the next one
+	}
+
 private:
 	const uint8_t kHdrSiz = 6;
-	uint16_t tid_;
+	uint16_t tid_ = 0; //last tid of master
 };
 
 template<typename TBase>
@@ -12,191 +12,89 @@
 
 namespace YModbus {
 
+namespace {
+
+uint8_t *PutWord(uint8_t *pbuf, uint16_t val)
+{
+	*pbuf++ = static_cast<uint8_t>(val >> 8);
+	*pbuf++ = static_cast<uint8_t>(val & 0xff);
+	return pbuf;
+}
+
+uint16_t GetWord(uint8_t *&pbuf)
+{
+	uint16_t val = static_cast<uint16_t>(pbuf[0] << 8 | pbuf[1]);
+	pbuf += 2;
+	return val;
+}
+
+} //namespace {
+
 uint8_t GetMasterMsgMinLen(uint8_t *msg)
 {
-	switch (msg[1]) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		return 6;
-	case kFunWriteAndReadRegisters:
-		return 10 + 1;
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6 + 1;
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-		return 6;
-	case kFunMaskWriteRegister:
-		return 8;
-	default:
-		return 2;
-	}
+	return GetFunDesc(msg[1]).reqmin;
 }
 
 uint8_t GetSlaveMsgMinLen(uint8_t *msg)
 {
-	switch (msg[1]) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		return 3;
-	case kFunWriteAndReadRegisters:
-		return 3;
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6;
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-		return 6;
-	case kFunMaskWriteRegister:
-		return 8;
-	default:
-		return 2;
-	}
+	return GetFunDesc(msg[1]).rspmin;
 }
 
+//msg has the bytes of min length
 uint8_t GetMasterMsgMaxLen(uint8_t *msg)
 {
-	switch (msg[1]) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		return 6;
-	case kFunWriteAndReadRegisters:
-		return 10 + 1 + msg[10];//id-fun-rn-ru-wa-wn-wb
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6 + 1 + msg[6];//id-fun-wa-wn-wb
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-		return 6;
-	case kFunMaskWriteRegister:
-		return 8;
-	default:
-		return 255;
-	}
+	const FunDesc &desc = GetFunDesc(msg[1]);
+
+	if (desc.req & kFieldBytes) //id-fun-...-bytes-data
+		return static_cast<uint8_t>(desc.reqoff + msg[desc.reqoff - 1]);
+
+	return desc.supported ? desc.reqmin : 255;
 }
 
 uint8_t GetSlaveMsgMaxLen(uint8_t *msg)
 {
-	switch (msg[1]) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		return 3 + msg[2];
-	case kFunWriteAndReadRegisters:
-		return 3 + msg[2];
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6;
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-		return 6;
-	case kFunMaskWriteRegister:
-		return 8;
-	default:
-		return 255;
-	}
+	const FunDesc &desc = GetFunDesc(msg[1]);
+
+	if (desc.rsp & kFieldBytes) //id-fun-...-bytes-data
+		return static_cast<uint8_t>(desc.rspoff + msg[desc.rspoff - 1]);
+
+	return desc.supported ? desc.rspmin : 255;
 }
 
 //direct: 1: in, /master/request, 0: out, slave/response
 //return: offset from first byte of local format msg based 0
 int Protocol::GetMasterDataOffset(uint8_t fun)
 {
-	switch (fun) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		return 6;//id-fun-rreg-rnum
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6 + 1;//id-fun-rreg-rnum-bytes
-	case kFunWriteAndReadRegisters:
-		return 10 + 1;//id-fun-rreg-rnum-wreg-wnum-bytes
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-	case kFunMaskWriteRegister:
-		return 4;//id-fun-reg
-	default:
-		return 2;
-	}
+	return GetFunDesc(fun).reqoff;
 }
 
 //direct: 1: in, /master/request, 0: out, slave/response
 //return: offset from first byte of local format msg based 0
 int Protocol::GetSlaveDataOffset(uint8_t fun)
 {
-	switch (fun) {
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-	case kFunWriteAndReadRegisters:
-		return 3;//id-fun-bytes
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		return 6;//id-fun-reg-num
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-	case kFunMaskWriteRegister:
-		return 4; //id-fun-reg
-	default:
-		return 2;
-	}
+	return GetFunDesc(fun).rspoff;
 }
 
 size_t Protocol::MakeMasterMsg(uint8_t *buf, size_t bufsiz, MsgInf &inf)
 {
+	const FunDesc &desc = GetFunDesc(inf.fun);
 	uint8_t *pbuf = buf;
 	
+	YMB_ASSERT(desc.supported && "Function is not surpported");
+
 	*pbuf++ = inf.id;
 	*pbuf++ = inf.fun;
-	
-	switch (inf.fun) {
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-	case kFunMaskWriteRegister:
-		*pbuf++ = static_cast<uint8_t>(inf.wreg >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.wreg & 0xff);
-		break;
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
-		*pbuf++ = static_cast<uint8_t>(inf.wreg >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.wreg & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.wnum >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.wnum & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.datalen);
-		break;
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
-		*pbuf++ = static_cast<uint8_t>(inf.rreg >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.rreg & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.rnum >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.rnum & 0xff);
-		break;
-	case kFunWriteAndReadRegisters:
-		*pbuf++ = static_cast<uint8_t>(inf.rreg >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.rreg & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.rnum >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.rnum & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.wreg >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.wreg & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.wnum >> 8);
-		*pbuf++ = static_cast<uint8_t>(inf.wnum & 0xff);
-		*pbuf++ = static_cast<uint8_t>(inf.datalen);
-		break;
-	default:
-		YMB_ASSERT(false && "Function is not surpported");
-		break;
+
+	if (desc.req & kFieldRead) {
+		pbuf = PutWord(pbuf, inf.rreg);
+		pbuf = PutWord(pbuf, inf.rnum);
 	}
+	if (desc.req & kFieldWReg)
+		pbuf = PutWord(pbuf, inf.wreg);
+	if (desc.req & kFieldWNum)
+		pbuf = PutWord(pbuf, inf.wnum);
+	if (desc.req & kFieldBytes)
+		*pbuf++ = static_cast<uint8_t>(inf.datalen);
 
 	//data maybe has been copied, in this case, databuf is null.
 	if (inf.databuf != nullptr) { //write or read data
@@ -217,32 +115,17 @@ size_t Protocol::MakeSlaveMsg(uint8_t *buf, size_t bufsiz, MsgInf &inf)
 	*pbuf++ = inf.id;
 
 	if (inf.err == 0) {
+		const FunDesc &desc = GetFunDesc(inf.fun);
+
+		YMB_ASSERT(desc.supported);
+
 		*pbuf++ = inf.fun;
-		switch (inf.fun) {
-		case kFunWriteSingleCoil:
-		case kFunWriteSingleRegister:
-		case kFunMaskWriteRegister:
-			*pbuf++ = static_cast<uint8_t>(inf.wreg >> 8);
-			*pbuf++ = static_cast<uint8_t>(inf.wreg & 0xff);
-			break;
-		case kFunWriteMultiCoils:
-		case kFunWriteMultiRegisters:
-			*pbuf++ = static_cast<uint8_t>(inf.wreg >> 8);
-			*pbuf++ = static_cast<uint8_t>(inf.wreg & 0xff);
-			*pbuf++ = static_cast<uint8_t>(inf.wnum >> 8);
-			*pbuf++ = static_cast<uint8_t>(inf.wnum & 0xff);
-			break;
-		case kFunReadCoils:
-		case kFunReadDiscreteInputs:
-		case kFunReadHoldingRegisters:
-		case kFunReadInputRegisters:
-		case kFunWriteAndReadRegisters:
+		if (desc.rsp & kFieldWReg)
+			pbuf = PutWord(pbuf, inf.wreg);
+		if (desc.rsp & kFieldWNum)
+			pbuf = PutWord(pbuf, inf.wnum);
+		if (desc.rsp & kFieldBytes)
 			*pbuf++ = static_cast<uint8_t>(inf.datalen);
-			break;
-		default:
-			YMB_ASSERT(false);
-			break;
-		}
 	}
 	else {
 		*pbuf++ = inf.fun | 0x80;
@@ -302,6 +185,44 @@ int Protocol::VerifySlaveMsg(uint8_t *msg, size_t msglen)
 	return EOK; 
 }
 
+//Used by slave
+//The length is got from the header, msg may be followed by others
+int Protocol::GetMasterMsgLen(uint8_t *msg, size_t msglen)
+{
+	if (msglen < 2)
+		return 0;
+
+	if (msg[1] & 0x80)
+		return 3; //exception msg, id-fun-err
+
+	const FunDesc &desc = GetFunDesc(msg[1]);
+	if (!desc.supported)
+		return -EBADMSG; //the end of msg is unknown
+
+	if (msglen < desc.reqmin)
+		return 0;
+
+	return GetMasterMsgMaxLen(msg);
+}
+
+//Used by master
+//The exception response is shorter, 3 bytes(id-fun-err)
+int Protocol::ExpectSlaveMsgLen(const MsgInf &inf)
+{
+	const FunDesc &desc = GetFunDesc(inf.fun);
+
+	if (!desc.supported)
+		return 0;
+
+	if (desc.bits == 1) //id-fun-bytes-bits
+		return desc.rspoff + (inf.rnum + 7) / 8;
+
+	if (desc.bits == 16) //id-fun-bytes-regs
+		return desc.rspoff + inf.rnum * 2;
+
+	return desc.rspmin; //id-fun-wreg-wnum/value/and-or
+}
+
 //Used by slave
 int Protocol::ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 {
@@ -310,59 +231,33 @@ int Protocol::ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 	inf.id = *pbuf++;
 	inf.fun = *pbuf++;
 
-	switch (inf.fun) {
-	case kFunWriteSingleCoil:
-	case kFunWriteSingleRegister:
-	case kFunMaskWriteRegister:
-		inf.rreg = INVALID_REG;
-		inf.rnum = INVALID_NUM;
-		inf.wreg = *pbuf++ << 8;
-		inf.wreg |= *pbuf++;
-		inf.wnum = 1;
-		inf.datalen = 2;
-		inf.databuf = pbuf;
-		break;
-	case kFunWriteMultiCoils:
-	case kFunWriteMultiRegisters:
+	const FunDesc &desc = GetFunDesc(inf.fun);
+	if (!desc.supported) {
+		YMB_ERROR("Modbus function not surpport. fun = %u\n", inf.fun);
+		return -EBADMSG;
+	}
+
+	if (desc.req & kFieldRead) {
+		inf.rreg = GetWord(pbuf);
+		inf.rnum = GetWord(pbuf);
+	}
+	else {
 		inf.rreg = INVALID_REG;
 		inf.rnum = INVALID_NUM;
-		inf.wreg = *pbuf++ << 8;
-		inf.wreg |= *pbuf++;
-		inf.wnum = *pbuf++ << 8;
-		inf.wnum |= *pbuf++;
-		inf.datalen = *pbuf++;
-		inf.databuf = pbuf;
-		break;
-	case kFunReadCoils:
-	case kFunReadDiscreteInputs:
-	case kFunReadHoldingRegisters:
-	case kFunReadInputRegisters:
+	}
+
+	if (desc.req & kFieldWReg) {
+		inf.wreg = GetWord(pbuf);
+		inf.wnum = (desc.req & kFieldWNum) ? GetWord(pbuf) : 1;
+	}
+	else {
 		inf.wreg = INVALID_REG;
 		inf.wnum = INVALID_NUM;
-		inf.rreg = *pbuf++ << 8;
-		inf.rreg |= *pbuf++;
-		inf.rnum = *pbuf++ << 8;
-		inf.rnum |= *pbuf++;
-		inf.datalen = 0;
-		inf.databuf = nullptr;
-		break;
-	case kFunWriteAndReadRegisters:
-		inf.rreg = *pbuf++ << 8;
-		inf.rreg |= *pbuf++;
-		inf.rnum = *pbuf++ << 8;
-		inf.rnum |= *pbuf++;
-		inf.wreg = *pbuf++ << 8;
-		inf.wreg |= *pbuf++;
-		inf.wnum = *pbuf++ << 8;
-		inf.wnum |= *pbuf++;
-		inf.datalen = *pbuf++;
-		inf.databuf = pbuf;
-		break;
-	default:
-		YMB_ERROR("Modbus function not surpport. fun = %u\n", inf.fun);
-		return -EBADMSG;
 	}
 
+	inf.datalen = (desc.req & kFieldBytes) ? *pbuf++ : desc.reqdata;
+	inf.databuf = inf.datalen != 0 ? pbuf : nullptr;
+
 	YMB_HEXDUMP(msg, msglen, 
 		"Master message: id = 0x%02x, fun = 0x%02x: ", inf.id, inf.fun);
 
@@ -378,42 +273,21 @@ int Protocol::ParseSlaveMsg(uint8_t *msg, size_t /*msglen*/, MsgInf &inf)
 	inf.fun = *pbuf++;
 
 	if ((inf.fun & 0x80) == 0) {
-		switch (inf.fun) {
-		case kFunWriteSingleCoil:
-		case kFunWriteSingleRegister:
-		case kFunMaskWriteRegister:
-			inf.rreg = INVALID_REG;
-			inf.rnum = 0;
-			inf.wreg = *pbuf++ << 8;
-			inf.wreg |= *pbuf++;
-			inf.wnum = 1;
-			inf.datalen = 0;
-			inf.databuf = nullptr;
-			break;
-		case kFunWriteMultiCoils:
-		case kFunWriteMultiRegisters:
+		const FunDesc &desc = GetFunDesc(inf.fun);
+		if (!desc.supported)
+			return -EBADMSG;
+
+		if (desc.rsp & kFieldBytes) { //read data
+			inf.datalen = *pbuf++;
+			inf.databuf = pbuf;
+		}
+		else { //write echoed
 			inf.rreg = INVALID_REG;
 			inf.rnum = 0;
-			inf.wreg = *pbuf++ << 8;
-			inf.wreg |= *pbuf++;
-			inf.wnum = *pbuf++ << 8;
-			inf.wnum |= *pbuf++;
+			inf.wreg = GetWord(pbuf);
+			inf.wnum = (desc.rsp & kFieldWNum) ? GetWord(pbuf) : 1;
 			inf.datalen = 0;
 			inf.databuf = nullptr;
-			break;
-		case kFunReadCoils:
-		case kFunReadDiscreteInputs:
-		case kFunReadHoldingRegisters:
-		case kFunReadInputRegisters:
-			inf.datalen = *pbuf++;
-			inf.databuf = pbuf;
-			break;
-		case kFunWriteAndReadRegisters:
-			inf.datalen = *pbuf++;
-			inf.databuf = pbuf;
-			break;
-		default:
-			return -EBADMSG;
 		}
 	}
 	else { //exception
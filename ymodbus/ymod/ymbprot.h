@@ -12,6 +12,8 @@
 
 namespace YModbus {
 
+class Crc16Context;
+
 struct MsgInf {
 	MsgInf()
 	{ 
@@ -32,6 +34,7 @@ struct MsgInf {
 		, pbuf(nullptr)
 		, bufsiz(0)
 		, err(0)
+		, tid(0)
 	{
 	}
 
@@ -52,6 +55,7 @@ struct MsgInf {
 		, pbuf(nullptr)
 		, bufsiz(0)
 		, err(0)
+		, tid(0)
 	{
 	}
 
@@ -74,6 +78,7 @@ struct MsgInf {
 		, pbuf(nullptr)
 		, bufsiz(0)
 		, err(0)
+		, tid(0)
 	{
 	}
 
@@ -88,6 +93,7 @@ struct MsgInf {
 	uint8_t *pbuf;
 	size_t bufsiz;
 	uint8_t err;
+	uint16_t tid; //transaction id, only for net
 };
 
 class IProtocol
@@ -103,10 +109,17 @@ public:
 	//Used by slave
 	//If msg OK, return 0, else return bytes of data expected
 	virtual int VerifyMasterMsg(uint8_t *msg, size_t msglen) = 0;
+	//As above, msg is growing, crc of it is resumed from crc(Rtu)
+	virtual int VerifyMasterMsg(uint8_t *msg, size_t msglen, Crc16Context &crc) = 0;
 
 	//Used by slave
 	virtual int ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf) = 0;
 
+	//Used by slave, to take the msgs one by one from the bytes received
+	//return: > 0, length of the first msg, it's longer than msglen until
+	//all of the msg arrived; = 0, unknown yet; < 0, bad msg, no frame
+	virtual int GetMasterMsgLen(uint8_t *msg, size_t msglen) = 0;
+
 	//Slave------------------------------------------------------------------
 	//direct: 1: in, request, 0: out, response
 	virtual int GetSlaveDataOffset(uint8_t fun) = 0;
@@ -118,13 +131,102 @@ public:
 	//If msg OK, return 0, else return bytes of data expected
 	//tid_ will be checked...
 	virtual int VerifySlaveMsg(uint8_t *msg, size_t msglen) = 0;
+	//As above, msg is growing, crc of it is resumed from crc(Rtu)
+	virtual int VerifySlaveMsg(uint8_t *msg, size_t msglen, Crc16Context &crc) = 0;
 
 	//Used by master
 	virtual int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf) = 0;
 
+	//Used by master pipeline
+	//return: >= 0, transaction id of msg; < 0, protocol has no transaction id
+	virtual int GetTransactionId(const uint8_t *msg, size_t msglen) = 0;
+
+	//Used by master
+	//return: > 0, length of the normal response to request inf, it may
+	//be received in one read; = 0, receive as VerifySlaveMsg expects
+	virtual int ExpectSlaveMsgLen(const MsgInf &inf) = 0;
+
 	~IProtocol() {}
 };
 
+//Fields of header after id-fun, a msg has them in this order
+const uint8_t kFieldRead	= 0x01; //rreg-rnum
+const uint8_t kFieldWReg	= 0x02; //wreg
+const uint8_t kFieldWNum	= 0x04; //wnum
+const uint8_t kFieldBytes	= 0x08; //bytes of data followed
+
+//Layout of the msgs of a function, all of framing and lengths are got
+//from it. A function is added to kFunDescs only.
+struct FunDesc
+{
+	constexpr FunDesc()
+		: FunDesc(false, 0, 0, 0, 0, 0)
+	{
+	}
+
+	//reqdata, rspdata: data of fixed length in msg, without kFieldBytes
+	//bits: of each item read, 1: coils, 16: registers, 0: no read
+	constexpr FunDesc(bool supported, uint8_t req, uint8_t rsp,
+		uint8_t reqdata, uint8_t rspdata, uint8_t bits)
+		: supported(supported)
+		, req(req)
+		, rsp(rsp)
+		, reqoff(Offset(req))
+		, rspoff(Offset(rsp))
+		, reqmin(static_cast<uint8_t>(Offset(req) + reqdata))
+		, rspmin(static_cast<uint8_t>(Offset(rsp) + rspdata))
+		, reqdata(reqdata)
+		, bits(bits)
+	{
+	}
+
+	//offset of data from id, by the fields of header
+	static constexpr uint8_t Offset(uint8_t fields)
+	{
+		return static_cast<uint8_t>(2 + ((fields & kFieldRead) ? 4 : 0)
+			+ ((fields & kFieldWReg) ? 2 : 0) + ((fields & kFieldWNum) ? 2 : 0)
+			+ ((fields & kFieldBytes) ? 1 : 0));
+	}
+
+	bool supported;
+	uint8_t req;		//fields of master msg
+	uint8_t rsp;		//fields of slave msg
+	uint8_t reqoff;		//offset of data in master msg
+	uint8_t rspoff;		//offset of data in slave msg
+	uint8_t reqmin;		//min length of master msg, all if no kFieldBytes
+	uint8_t rspmin;		//min length of slave msg, all if no kFieldBytes
+	uint8_t reqdata;
+	uint8_t bits;
+};
+
+//Indexed by function code
+constexpr FunDesc kFunDescs[] = {
+	{},
+	{ true, kFieldRead, kFieldBytes, 0, 0, 1 },	//0x01 read coils
+	{ true, kFieldRead, kFieldBytes, 0, 0, 1 },	//0x02 read discrete inputs
+	{ true, kFieldRead, kFieldBytes, 0, 0, 16 },	//0x03 read holding registers
+	{ true, kFieldRead, kFieldBytes, 0, 0, 16 },	//0x04 read input registers
+	{ true, kFieldWReg, kFieldWReg, 2, 2, 0 },		//0x05 write single coil, value
+	{ true, kFieldWReg, kFieldWReg, 2, 2, 0 },		//0x06 write single register, value
+	{}, {}, {}, {}, {}, {}, {}, {},					//0x07 ~ 0x0E
+	{ true, kFieldWReg | kFieldWNum | kFieldBytes,
+		kFieldWReg | kFieldWNum, 0, 0, 0 },			//0x0F write multiple coils
+	{ true, kFieldWReg | kFieldWNum | kFieldBytes,
+		kFieldWReg | kFieldWNum, 0, 0, 0 },			//0x10 write multiple registers
+	{}, {}, {}, {}, {},								//0x11 ~ 0x15
+	{ true, kFieldWReg, kFieldWReg, 4, 4, 0 },		//0x16 mask write register, and-or
+	{ true, kFieldRead | kFieldWReg | kFieldWNum | kFieldBytes,
+		kFieldBytes, 0, 0, 16 },					//0x17 write and read registers
+};
+
+const uint8_t kFunDescNum = sizeof(kFunDescs) / sizeof(kFunDescs[0]);
+
+//Not supported functions and exceptions are kFunDescs[0]
+constexpr const FunDesc &GetFunDesc(uint8_t fun)
+{
+	return fun < kFunDescNum ? kFunDescs[fun] : kFunDescs[0];
+}
+
 class Protocol
 {
 public:
@@ -141,6 +243,10 @@ public:
 	
 	//Used by slave
 	static int ParseMasterMsg(uint8_t *msg, size_t msglen, MsgInf &inf);
+
+	//Used by slave
+	//return: > 0, length of the first msg; = 0, unknown yet; < 0, bad msg
+	static int GetMasterMsgLen(uint8_t *msg, size_t msglen);
 	
 	//Slave------------------------------------------------------------------
 	//direct: 1: in, request, 0: out, response
@@ -156,8 +262,31 @@ public:
 
 	//Used by master
 	static int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf);
+
+	//Used by master
+	//return: > 0, length of the normal response to request inf; = 0, unknown
+	static int ExpectSlaveMsgLen(const MsgInf &inf);
 };
 
+//Used by master
+//Length of the first slave msg in buffer, got by feeding VerifySlaveMsg
+//the bytes it expects. Only for protocols of exact length, Net and Rtu.
+//return: > 0, length of msg; = 0, more data expected; < 0, bad msg
+template<typename TProtocol>
+int GetSlaveMsgLen(TProtocol &prot, uint8_t *msg, size_t msglen)
+{
+	size_t len = 0;
+	int need;
+
+	while ((need = prot.VerifySlaveMsg(msg, len)) > 0) {
+		len += static_cast<size_t>(need);
+		if (len > msglen)
+			return 0;
+	}
+
+	return need == 0 ? static_cast<int>(len) : need;
+}
+
 } //namespace YModbus
 
 #endif // ! __YMODBUS_YPROTOCOL_H__
@@ -0,0 +1,111 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBQUEUE_H__
+#define __YMODBUS_YMBQUEUE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace YModbus {
+
+//Bounded lock-free queue, multi-producer single-consumer.
+//Every cell carries a sequence number(D. Vyukov's bounded queue),
+//producers claim cells with one CAS of tail, the consumer owns head.
+//N: capacity, must be power of 2
+template<typename T, size_t N>
+class MpscQueue
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be power of 2");
+
+public:
+	MpscQueue()
+		: tail_(0)
+		, head_(0)
+	{
+		for (size_t i = 0; i < N; i++)
+			cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue &operator = (const MpscQueue&) = delete;
+
+	//Any thread
+	//return: false, queue is full
+	bool Push(const T &val)
+	{
+		Cell *cell;
+		size_t pos = tail_.load(std::memory_order_relaxed);
+
+		for (;;) {
+			cell = &cells_[pos & (N - 1)];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (dif == 0) { //free cell, claim it
+				if (tail_.compare_exchange_weak(pos, pos + 1,
+					std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0) { //consumer is behind a full lap
+				return false;
+			}
+			else { //claimed by other producer
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->val = val;
+		cell->seq.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	//Consumer thread only
+	//return: false, queue is empty
+	bool Pop(T &val)
+	{
+		Cell &cell = cells_[head_ & (N - 1)];
+		if (cell.seq.load(std::memory_order_acquire) != head_ + 1)
+			return false;
+
+		val = cell.val;
+		cell.seq.store(head_ + N, std::memory_order_release);
+		head_++;
+
+		return true;
+	}
+
+	//Consumer thread only
+	bool Empty(void) const
+	{
+		const Cell &cell = cells_[head_ & (N - 1)];
+		return cell.seq.load(std::memory_order_acquire) != head_ + 1;
+	}
+
+	size_t Capacity(void) const { return N; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		T val;
+	};
+
+	//Padding keeps tail_ and head_ in their own cache lines, without
+	//over-alignment which new of C++14 doesn't guarantee
+	static const size_t kCacheLine = 64;
+
+	Cell cells_[N];
+	char pad0_[kCacheLine];
+	std::atomic<size_t> tail_; //producers
+	char pad1_[kCacheLine - sizeof(std::atomic<size_t>)];
+	size_t head_; //consumer
+	char pad2_[kCacheLine - sizeof(size_t)];
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBQUEUE_H__
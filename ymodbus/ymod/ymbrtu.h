@@ -34,7 +34,7 @@ public:
 		size_t msglen = Protocol::MakeMasterMsg(buf, bufsiz - 2, inf);
 		YMB_ASSERT(bufsiz >= static_cast<size_t>(msglen + 2));
 
-		uint16_t crc = Crc16(buf, static_cast<uint16_t>(msglen));
+		uint16_t crc = Crc16(buf, msglen);
 
 		buf[msglen + 0] = static_cast<uint8_t>(crc & 0xff);
 		buf[msglen + 1] = static_cast<uint8_t>(crc >> 8);
@@ -47,7 +47,7 @@ public:
 		size_t msglen = Protocol::MakeSlaveMsg(buf, bufsiz - 2, inf);
 		YMB_ASSERT(bufsiz >= msglen + 2);
 
-		uint16_t crc = Crc16(buf, static_cast<uint16_t>(msglen));
+		uint16_t crc = Crc16(buf, msglen);
 
 		buf[msglen + 0] = static_cast<uint8_t>(crc & 0xff);
 		buf[msglen + 1] = static_cast<uint8_t>(crc >> 8);
@@ -57,31 +57,36 @@ public:
 
 	//Exact message
 	int VerifyMasterMsg(uint8_t *msg, size_t msglen)
+	{
+		Crc16Context crc;
+		return VerifyMasterMsg(msg, msglen, crc);
+	}
+
+	//crc: of the bytes of msg verified before, msg is growing
+	int VerifyMasterMsg(uint8_t *msg, size_t msglen, Crc16Context &crc)
 	{
 		if (msglen < kMinRtuMsgLen)
 			return static_cast<int>(kMinRtuMsgLen - msglen);
 
 		int expect = Protocol::VerifyMasterMsg(msg, msglen - 2);
-		if (expect != 0)
-			return expect;
 
-		uint16_t crc = Crc16(msg, static_cast<uint16_t>(msglen - 2));
-
-		return crc == ((msg[msglen - 1] << 8) | msg[msglen - 2]) ? 0 : -EVAL;
+		return VerifyCrc(msg, msglen, expect, crc);
 	}
 
 	int VerifySlaveMsg(uint8_t *msg, size_t msglen)
+	{
+		Crc16Context crc;
+		return VerifySlaveMsg(msg, msglen, crc);
+	}
+
+	int VerifySlaveMsg(uint8_t *msg, size_t msglen, Crc16Context &crc)
 	{
 		if (msglen < kMinRtuMsgLen)
 			return static_cast<int>(kMinRtuMsgLen - msglen);
 
 		int expect = Protocol::VerifySlaveMsg(msg, msglen - 2);
-		if (expect != 0)
-			return expect;
-
-		uint16_t crc = Crc16(msg, static_cast<uint16_t>(msglen - 2));
 
-		return crc == ((msg[msglen - 1] << 8) | msg[msglen - 2]) ? 0 : -EVAL;
+		return VerifyCrc(msg, msglen, expect, crc);
 	}
 
 	//Used by slave
@@ -91,6 +96,13 @@ public:
 		return Protocol::ParseMasterMsg(msg, msglen - 2, inf);
 	}
 
+	//Used by slave
+	int GetMasterMsgLen(uint8_t *msg, size_t msglen)
+	{
+		int len = Protocol::GetMasterMsgLen(msg, msglen);
+		return len > 0 ? len + 2 : len; //crc
+	}
+
 	//Used by master
 	int ParseSlaveMsg(uint8_t *msg, size_t msglen, MsgInf &inf)
 	{
@@ -98,7 +110,37 @@ public:
 		return Protocol::ParseSlaveMsg(msg, msglen - 2, inf);
 	}
 
+	//Used by master pipeline
+	int GetTransactionId(const uint8_t * /*msg*/, size_t /*msglen*/)
+	{
+		return -1; //No transaction id in rtu msg
+	}
+
+	//Used by master
+	//The response is read at once, exception is ended by the silence
+	int ExpectSlaveMsgLen(const MsgInf &inf)
+	{
+		int len = Protocol::ExpectSlaveMsgLen(inf);
+		return len > 0 ? len + 2 : 0;
+	}
+
 private:
+	//expect: bytes expected by the data of msg
+	static int VerifyCrc(uint8_t *msg, size_t msglen, int expect, Crc16Context &crc)
+	{
+		if (expect < 0)
+			return expect;
+
+		if (expect > 0) { //the bytes before the crc field so far
+			crc.Update(msg, msglen - 2 + (expect < 2 ? expect : 2));
+			return expect;
+		}
+
+		uint16_t val = crc.Update(msg, msglen - 2);
+
+		return val == ((msg[msglen - 1] << 8) | msg[msglen - 2]) ? 0 : -EVAL;
+	}
+
 	const size_t kMinRtuMsgLen = 5;
 };
 
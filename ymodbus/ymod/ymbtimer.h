@@ -0,0 +1,133 @@
+﻿/**
+* ymodbus
+* Copyright © 2019-2019 liuyongqing<lyqdy1@163.com>
+* v1.0.1 2019.05.04
+*/
+#ifndef __YMODBUS_YMBTIMER_H__
+#define __YMODBUS_YMBTIMER_H__
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace YModbus {
+
+//Hashed timer wheel, only used in the thread of owner.
+//Arming or canceling a timer is O(1), the stale entries of a timer
+//re-armed or canceled are dropped when their slot is expired.
+//TOwner: passed back to the caller of Expire
+template<typename TOwner>
+class TimerWheel
+{
+public:
+	struct Timer
+	{
+		uint32_t gen = 0; //entries of other generation are stale
+		bool armed = false;
+	};
+
+	//tick: ms of each slot
+	//slots: timers beyond slots * tick wait for more rounds
+	TimerWheel(long tick, size_t slots)
+		: tick_(tick)
+		, slots_(slots)
+		, now_(0)
+		, armed_(0)
+		, base_(Clock::now())
+	{
+	}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel &operator = (const TimerWheel&) = delete;
+
+	long GetTick(void) const { return tick_; }
+	bool Empty(void) const { return armed_ == 0; }
+
+	//ms: expired after ms, rounded up to tick
+	void Arm(Timer &timer, TOwner *owner, long ms)
+	{
+		Cancel(timer);
+
+		uint64_t ticks = ms > 0 ? (ms + tick_ - 1) / tick_ : 1;
+		uint64_t expire = Elapsed() + ticks;
+
+		slots_[expire % slots_.size()].push_back({ &timer, owner, timer.gen, expire });
+		timer.armed = true;
+		armed_++;
+	}
+
+	void Cancel(Timer &timer)
+	{
+		if (timer.armed) {
+			timer.armed = false;
+			timer.gen++;
+			armed_--;
+		}
+	}
+
+	//Walk through the slots up to now
+	//f: void(TOwner *owner), called for each expired timer, and
+	//may arm the timers again
+	template<typename F>
+	void Expire(F f)
+	{
+		uint64_t target = Elapsed();
+
+		if (armed_ == 0) { //only stale entries, drop them later
+			now_ = target;
+			return;
+		}
+
+		while (now_ < target) {
+			now_++;
+
+			std::vector<Entry> &slot = slots_[now_ % slots_.size()];
+			for (size_t i = 0; i < slot.size(); ) {
+				Entry entry = slot[i];
+				bool stale = !entry.timer->armed || entry.gen != entry.timer->gen;
+
+				if (!stale && entry.expire > now_) { //next round
+					i++;
+					continue;
+				}
+
+				slot[i] = slot.back();
+				slot.pop_back();
+
+				if (!stale) {
+					Cancel(*entry.timer);
+					f(entry.owner);
+				}
+			}
+		}
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		Timer *timer;
+		TOwner *owner;
+		uint32_t gen;
+		uint64_t expire; //tick
+	};
+
+	uint64_t Elapsed(void) const
+	{
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			Clock::now() - base_).count();
+		return static_cast<uint64_t>(ms) / tick_;
+	}
+
+	long tick_;
+	std::vector<std::vector<Entry>> slots_;
+	uint64_t now_; //tick walked through
+	size_t armed_;
+	Clock::time_point base_;
+};
+
+} //namespace YModbus
+
+#endif // ! __YMODBUS_YMBTIMER_H__
@@ -10,6 +10,15 @@
 #include "ymblog.h"
 
 #include <algorithm>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#	define YMB_UTILS_SSSE3
+#	include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define YMB_UTILS_SSE2
+#	include <emmintrin.h>
+#endif
 
 namespace YModbus {
 
@@ -127,7 +136,11 @@ inline void YNetToHost(uint8_t *buf, int bufsiz, eByteOrder bor)
 		break;
 	case BOR_2143: { // Big-endian byte swap
 						//0x01020304=>{0x02,0x01,0x04,0x03}=>{0x04,0x03,0x02,0x01}
-		//TODO
+		YMB_ASSERT((bufsiz % 2) == 0);
+		for (int i = 0, j = bufsiz - 2; i < j; i += 2, j -= 2) {
+			::std::swap(buf[i], buf[j]);
+			::std::swap(buf[i+1], buf[j+1]);
+		}
 		break; }
 	default:
 		YMB_ASSERT(false);
@@ -135,6 +148,84 @@ inline void YNetToHost(uint8_t *buf, int bufsiz, eByteOrder bor)
 	} //switch (bor)
 }
 
+//Position in net order of byte i of a value of size bytes on little
+//endian host, the same conversion as YNetToHost(T &val, bor)
+inline size_t YNetBytePos(size_t i, size_t size, eByteOrder bor)
+{
+	switch (bor) {
+	case BOR_1234: //reversed
+		return size - 1 - i;
+	case BOR_3412: //bytes of each word swapped
+		return i ^ 1;
+	case BOR_2143: //words reversed
+		return size - 2 - (i & ~static_cast<size_t>(1)) + (i & 1);
+	default: //BOR_4321, the same
+		return i;
+	}
+}
+
+//Convert count values in place, like YNetToHost(T &val, bor) on each.
+//Values of 2, 4 or 8 bytes are converted 16 bytes at a time on little
+//endian host, by one shuffle with SSSE3, or with SSE2(all of x86-64)
+//by swapping the bytes of words and then the words of values.
+template<typename T>
+inline void YNetToHostArray(T *vals, size_t count, eByteOrder bor)
+{
+	size_t i = 0;
+
+	if (IsLittleEndian() && bor == BOR_4321) //the same as host
+		return;
+
+#if defined(YMB_UTILS_SSSE3)
+	const size_t size = sizeof(T);
+
+	if (IsLittleEndian() && (size == 2 || size == 4 || size == 8)) {
+		alignas(16) uint8_t perm[16];
+		for (size_t b = 0; b < sizeof(perm); b++)
+			perm[b] = static_cast<uint8_t>(b / size * size + YNetBytePos(b % size, size, bor));
+
+		const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(perm));
+		uint8_t *p = reinterpret_cast<uint8_t*>(vals);
+		const size_t step = 16 / size; //values of one shuffle
+
+		for (; i + step <= count; i += step) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * size));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p + i * size), _mm_shuffle_epi8(v, mask));
+		}
+	}
+#elif defined(YMB_UTILS_SSE2)
+	const size_t size = sizeof(T);
+
+	if (IsLittleEndian() && (size == 2 || size == 4 || size == 8)) {
+		//BOR_1234 is both of them, BOR_3412 bytes only, BOR_2143 words only
+		const bool bytes = bor == BOR_1234 || bor == BOR_3412;
+		const bool words = (bor == BOR_1234 || bor == BOR_2143) && size > 2;
+		uint8_t *p = reinterpret_cast<uint8_t*>(vals);
+		const size_t step = 16 / size; //values of one block
+
+		for (; i + step <= count; i += step) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * size));
+			if (bytes)
+				v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			if (words && size == 4) {
+				v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+				v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+			else if (words) { //size == 8
+				v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+				v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p + i * size), v);
+		}
+	}
+#endif
+
+	for (; i < count; i++) //the rest, or without simd
+		YNetToHost(vals[i], bor);
+}
+
+#define YHostToNetArray YNetToHostArray
+
 } //namesapce YModbus
 
 #if defined(__GNUC__) && __GNUC__ < 5 //for std::make_unique